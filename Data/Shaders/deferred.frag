@@ -0,0 +1,40 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+#include "lighting.glsl"
+
+// G-buffer written by the geometry subpass, read at the pixel being lit
+layout(input_attachment_index = 0, set = 1, binding = 0) uniform subpassInput gbufferAlbedo;
+layout(input_attachment_index = 1, set = 1, binding = 1) uniform subpassInput gbufferNormal;
+layout(input_attachment_index = 2, set = 1, binding = 2) uniform subpassInput gbufferDepth;
+
+layout(location = 0) in vec2 fragScreenPos;
+
+layout(location = 0) out vec4 outColor;
+
+void main()
+{
+    // nothing was drawn, or only the depth, the background color is kept
+    float   depth           = subpassLoad(gbufferDepth).r;
+    vec4    encodedNormal   = subpassLoad(gbufferNormal);
+    if (depth >= 1.0 || encodedNormal.a < 0.5)
+    {
+        discard;
+    }
+
+    vec4    albedo          = subpassLoad(gbufferAlbedo);
+    vec3    normal          = normalize(encodedNormal.xyz * 2.0 - vec3(1.0, 1.0, 1.0));
+
+    vec4    worldPos        = ubo.inverseViewProjection * vec4(fragScreenPos, depth, 1.0);
+            worldPos.xyz   /= worldPos.w;
+
+    // ambient lighting
+    vec3    ambientColor    = ubo.ambientLightColor * ubo.ambientLightIntensity;
+
+    // lighting, every light of the cluster is applied once per pixel whatever the overdraw
+    vec3    lightColor      = applyLights(normal, worldPos.xyz, albedo.a);
+
+    outColor.xyz            = (lightColor + ambientColor) * albedo.xyz;
+    outColor.a              = 1.0;
+}
@@ -0,0 +1,34 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    mat4 modelViewProjection;
+};
+
+// one transform per scene instance
+layout(std430, binding = 2) readonly buffer ObjectTransforms
+{
+    ObjectTransform objects[];
+};
+
+// scene instances that passed the culling, the draws start at their first instance
+layout(std430, binding = 3) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+};
+
+layout(location = 0) in vec3 inPosition;
+
+// computed like shader.vert, the forward pass tests its depth for equality
+out gl_PerVertex
+{
+    invariant vec4 gl_Position;
+};
+
+void main()
+{
+    gl_Position = objects[visibleInstances[gl_InstanceIndex]].modelViewProjection * vec4(inPosition, 1.0);
+}
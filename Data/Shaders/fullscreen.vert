@@ -0,0 +1,19 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// clip space position of the pixel, the inverse view projection brings it back to world space
+layout(location = 0) out vec2 fragScreenPos;
+
+out gl_PerVertex
+{
+    vec4 gl_Position;
+};
+
+// one triangle covering the screen, drawn without vertex buffer
+void main()
+{
+    vec2 position = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0;
+
+    fragScreenPos = position;
+    gl_Position = vec4(position, 0.0, 1.0);
+}
@@ -0,0 +1,54 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// specialization constant, see ShaderSpecialization in Renderer.h
+layout(constant_id = 1) const bool textured = true;
+
+layout(std140, binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 proj;
+    vec3 cameraPosition;
+    
+    float ambientLightIntensity;
+    vec3  ambientLightColor;
+    
+    float directionalLightIntensity;
+    vec3  directionalLightColor;
+    vec3  directionalLightDirection;
+
+    vec3  materialColor;
+    vec3  materialSpecularColor;
+    float materialRoughness;
+
+    int   directionalLightCount;
+    uvec4 clusterCount;
+    vec4  clusterScale;
+
+    mat4  inverseViewProjection;
+} ubo;
+
+layout(binding = 1) uniform sampler2D texSampler;
+
+layout(location = 0) in vec3 fragPos;
+layout(location = 1) in vec3 fragColor;
+layout(location = 2) in vec2 fragTexCoord;
+layout(location = 3) in vec3 fragNormal;
+
+// G-buffer attachments, the world position is rebuilt from the depth by deferred.frag
+layout(location = 0) out vec4 outAlbedo; // diffuse color and roughness
+layout(location = 1) out vec4 outNormal; // world normal encoded in [0, 1], the alpha marks a surface
+
+void main()
+{
+    vec4    diffuseColor    = vec4(ubo.materialColor, 1.0f);
+    if (textured)
+    {
+        diffuseColor       *= texture(texSampler, fragTexCoord);
+    }
+
+    vec3    normal          = normalize(fragNormal);
+
+    outAlbedo               = vec4(diffuseColor.xyz, ubo.materialRoughness);
+    outNormal               = vec4((normal + vec3(1.0, 1.0, 1.0)) * 0.5, 1.0);
+}
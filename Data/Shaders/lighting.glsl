@@ -0,0 +1,290 @@
+// Scene lights and the light functions shared by shader.frag and deferred.frag
+
+const int LightType_Directional = 0;
+const int LightType_Point = 1;
+const int LightType_Spot = 2;
+const int LightType_Area = 3;
+
+// specialization constants, see ShaderSpecialization in Renderer.h, constant_id 1 is declared by shader.frag and gbuffer.frag
+layout(constant_id = 0) const uint lightTypes = 0xF; // bit per light type in the scene
+layout(constant_id = 2) const uint maxClusterLights = 1024; // point, spot and area lights in the scene, bounds the cluster loop
+
+const uint LightTypeBit_Directional = 1u << LightType_Directional;
+const uint clusterLightTypes = lightTypes & ~LightTypeBit_Directional;
+
+// SHADOW_CASCADE_COUNT of Renderer.cpp
+const int ShadowCascadeCount = 4;
+
+struct Light
+{
+    vec3  position;
+    int   type;
+
+    vec3  direction;
+    float range;
+          
+    vec3  color;
+    float intensity;
+          
+    float innerAngle;
+    float outerAngle;
+    int   shadowIndex;
+};
+
+layout(std140, binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 proj;
+    vec3 cameraPosition;
+    
+    float ambientLightIntensity;
+    vec3  ambientLightColor;
+    
+    float directionalLightIntensity;
+    vec3  directionalLightColor;
+    vec3  directionalLightDirection;
+
+    vec3  materialColor;
+    vec3  materialSpecularColor;
+    float materialRoughness;
+
+    int   directionalLightCount;
+    uvec4 clusterCount;
+    vec4  clusterScale;
+
+    mat4  inverseViewProjection;
+} ubo;
+
+// scene lights, the directional ones first
+layout(std430, binding = 4) readonly buffer Lights
+{
+    Light lights[];
+};
+
+// offset and count of the lights of every cluster, followed by the light indices
+layout(std430, binding = 5) readonly buffer LightClusters
+{
+    uint lightClusters[];
+};
+
+// world to shadow map tile of every shadow view, the cascades of the sun first
+layout(std430, binding = 6) readonly buffer ShadowViews
+{
+    mat4 shadowViewProjections[];
+};
+
+layout(binding = 7) uniform sampler2DShadow cascadeShadowMap;
+layout(binding = 8) uniform sampler2DShadow atlasShadowMap;
+
+// a clustered light of the only type in the scene is not tested
+bool IsClusterLightType(Light light, int type)
+{
+    uint typeBit = 1u << uint(type);
+    return (clusterLightTypes & typeBit) != 0u && (clusterLightTypes == typeBit || light.type == type);
+}
+
+float CalcLightAttenuation(float lightDistance)
+{
+    float lightConstant     = 1.0;
+    float lightLinear       = 0.09;
+    float lightQuadratic    = 0.032;
+
+    float attenuation       = 1.0 / (lightConstant + (lightLinear * lightDistance) + (lightQuadratic * (lightDistance * lightDistance)));
+    return clamp(attenuation, 0.0, 1.0);
+}
+
+float CalcSpotAttenuation(vec3 pointToLight, vec3 spotDirection, float outerConeCos, float innerConeCos)
+{
+    float spotDifference    = clamp(dot(spotDirection, -pointToLight), 0.0, 1.0);
+    float attenuation       = (spotDifference - outerConeCos) / (innerConeCos - outerConeCos);
+    return smoothstep(0.0, 1.0, attenuation);  
+}
+
+// fraction of the sun reaching a surface, from the first cascade covering it, the cascades are laid out two by two
+float CalcSunShadow(vec3 worldPos)
+{
+    // a texel in from the edges, the filtering does not read the next cascade
+    float   border          = 2.0 / float(textureSize(cascadeShadowMap, 0).x);
+
+    for (int i = 0; i < ShadowCascadeCount; ++i)
+    {
+        vec3    shadowPos       = (shadowViewProjections[i] * vec4(worldPos, 1.0)).xyz;
+        if (all(greaterThanEqual(shadowPos, vec3(border, border, 0.0))) && all(lessThanEqual(shadowPos, vec3(1.0 - border, 1.0 - border, 1.0))))
+        {
+            vec2    uv              = (shadowPos.xy + vec2(i & 1, i >> 1)) * 0.5;
+            return texture(cascadeShadowMap, vec3(uv, shadowPos.z));
+        }
+    }
+
+    return 1.0;
+}
+
+// fraction of a point or spot light reaching a surface, a point light has a view per cube face
+float CalcLightShadow(Light light, vec3 worldPos)
+{
+    if (light.shadowIndex < 0)
+    {
+        return 1.0;
+    }
+
+    int     viewIndex       = light.shadowIndex;
+    if (light.type == LightType_Point)
+    {
+        // the faces are in +X -X +Y -Y +Z -Z order
+        vec3    lightToPixel    = worldPos - light.position;
+        vec3    axis            = abs(lightToPixel);
+        if (axis.x >= axis.y && axis.x >= axis.z)
+        {
+            viewIndex += (lightToPixel.x >= 0.0) ? 0 : 1;
+        }
+        else if (axis.y >= axis.z)
+        {
+            viewIndex += (lightToPixel.y >= 0.0) ? 2 : 3;
+        }
+        else
+        {
+            viewIndex += (lightToPixel.z >= 0.0) ? 4 : 5;
+        }
+    }
+
+    // the spot attenuation is zero wherever the view of a spot light does not reach
+    return textureProj(atlasShadowMap, shadowViewProjections[viewIndex] * vec4(worldPos, 1.0));
+}
+
+vec3 CalcBlinnPhongReflection(vec3 lightDir, vec3 lightColor, vec3 normal, vec3 worldPos, float roughness)
+{
+    float   shininess       = min(2048, max(0.001, (2.0 / pow(roughness, 2))));
+
+    vec3    viewPos         = ubo.cameraPosition;
+    vec3    viewDir         = normalize(viewPos - worldPos);
+    vec3    halfDir         = normalize(lightDir + viewDir);
+    float   specAngle       = max(0.0, dot(halfDir, normal));
+    float   specular        = pow(specAngle,  shininess);
+    vec3    specularColor   = lightColor * ubo.materialSpecularColor * specular;
+    return specularColor;
+}
+
+vec3 applyDirectionalLight(Light light, vec3 normal, vec3 worldPos, float roughness)
+{
+    float   lightDifference     = clamp(dot(normal, -light.direction), 0.0, 1.0);
+    
+    vec3    specularColor       = CalcBlinnPhongReflection(-light.direction, light.color, normal, worldPos, roughness);
+    return (light.color + specularColor) * lightDifference;
+}
+
+vec3 applyPointLight(Light light, vec3 normal, vec3 worldPos, float roughness)
+{
+    vec3    lightToPixel        = light.position - worldPos;
+    float   lightDistance       = length(lightToPixel);
+    vec3    lightRay            = normalize(lightToPixel);
+    
+    float   lightDifference     = clamp(dot(normal, lightRay), 0.0, 1.0);
+    float   lightAttenuation    = CalcLightAttenuation(lightDistance);
+
+    vec3    specularColor       = CalcBlinnPhongReflection(lightRay, light.color, normal, worldPos, roughness);
+    return (light.color + specularColor) * lightAttenuation * lightDifference;
+}
+
+vec3 applySpotLight(Light light, vec3 normal, vec3 worldPos, float roughness)
+{
+    vec3    lightToPixel        = light.position - worldPos;
+    float   lightDistance       = length(lightToPixel);
+    vec3    lightRay            = normalize(lightToPixel);
+    
+    float   lightDifference     = clamp(dot(normal, lightRay), 0.0, 1.0);
+    float   lightAttenuation    = CalcLightAttenuation(lightDistance);
+
+    float   spotAttenuation     = CalcSpotAttenuation(lightRay, light.direction, cos(light.outerAngle * 0.5), cos(light.innerAngle * 0.5));
+    
+    vec3    specularColor       = CalcBlinnPhongReflection(lightRay, light.color, normal, worldPos, roughness);
+    return (light.color + specularColor) * lightAttenuation * lightDifference * spotAttenuation;
+}
+
+vec3 applyAreaLight(Light light, vec3 normal, vec3 worldPos, float roughness)
+{
+    vec3    lightToPixel        = light.position - worldPos;
+
+    vec3    xVector             = normalize(cross(vec3(1.0, 0.0, 0.0) + light.direction, light.direction));
+    vec3    yVector             = normalize(cross(xVector, light.direction));
+
+    float   distanceToPlane     = dot(light.direction, -lightToPixel);
+    vec3    pointOnPlane        = worldPos - (distanceToPlane * light.direction);
+
+    vec3    lightToPoint        = pointOnPlane - light.position;
+    
+    vec2    area                = vec2(1.0, 1.0);
+    vec2    nearest2D           = vec2(dot(lightToPoint, xVector), dot(lightToPoint, yVector));
+            nearest2D           = vec2(clamp(nearest2D.x, -area.x, area.x), clamp(nearest2D.y, -area.y, area.y));
+    vec3    closestPointInRect  = light.position + (xVector * nearest2D.x) + (yVector * nearest2D.y);
+
+    vec3    pointToPixel        = closestPointInRect - worldPos;
+    float   lightDistance       = length(pointToPixel);
+    vec3    lightRay            = normalize(pointToPixel);
+    
+    float   lightDifference     = clamp(dot(normal, lightRay), 0.0, 1.0);
+    float   lightAttenuation    = CalcLightAttenuation(lightDistance);
+
+    float   spotAttenuation     = CalcSpotAttenuation(lightRay, light.direction, cos(light.outerAngle * 0.5), cos(light.innerAngle * 0.5));
+
+    vec3    specularColor       = CalcBlinnPhongReflection(lightRay, light.color, normal, worldPos, roughness);
+    return (light.color + specularColor) * lightAttenuation * lightDifference * spotAttenuation;
+}
+
+// sun, directional and clustered lights reaching a surface, the cluster is found from gl_FragCoord
+vec3 applyLights(vec3 normal, vec3 worldPos, float roughness)
+{
+    vec3    lightColor      = vec3(0.0, 0.0, 0.0);
+
+    // sun light
+    Light sun;
+    sun.type        = LightType_Directional;
+    sun.direction   = ubo.directionalLightDirection;
+    sun.color       = ubo.directionalLightColor * ubo.directionalLightIntensity;
+
+    lightColor += applyDirectionalLight(sun, normal, worldPos, roughness) * CalcSunShadow(worldPos);
+
+    // directional scene lights
+    if ((lightTypes & LightTypeBit_Directional) != 0u)
+    {
+        for (int i = 0; i < ubo.directionalLightCount; ++i)
+        {
+            lightColor += applyDirectionalLight(lights[i], normal, worldPos, roughness);
+        }
+    }
+
+    // the other lights are read from the cluster of the fragment
+    if (clusterLightTypes != 0u)
+    {
+        float   viewDepth       = -(ubo.view * vec4(worldPos, 1.0)).z;
+        uvec3   cluster         = uvec3(gl_FragCoord.xy * ubo.clusterScale.xy, max(log(viewDepth) * ubo.clusterScale.z + ubo.clusterScale.w, 0.0));
+                cluster         = min(cluster, ubo.clusterCount.xyz - 1u);
+        uint    clusterIndex    = cluster.x + ubo.clusterCount.x * (cluster.y + ubo.clusterCount.y * cluster.z);
+        uint    lightOffset     = ubo.clusterCount.w * 2u + lightClusters[clusterIndex * 2u];
+        uint    lightCount      = lightClusters[clusterIndex * 2u + 1u];
+
+        // the trip count is known when the pipeline is created, the loop is unrolled for the scenes with a few lights
+        for (uint i = 0u; i < maxClusterLights; ++i)
+        {
+            if (i >= lightCount)
+            {
+                break;
+            }
+
+            Light light = lights[lightClusters[lightOffset + i]];
+            if (IsClusterLightType(light, LightType_Point))
+            {
+                lightColor += applyPointLight(light, normal, worldPos, roughness) * CalcLightShadow(light, worldPos);
+            }
+            else if (IsClusterLightType(light, LightType_Spot))
+            {
+                lightColor += applySpotLight(light, normal, worldPos, roughness) * CalcLightShadow(light, worldPos);
+            }
+            else if (IsClusterLightType(light, LightType_Area))
+            {
+                lightColor += applyAreaLight(light, normal, worldPos, roughness);
+            }
+        }
+    }
+
+    return lightColor;
+}
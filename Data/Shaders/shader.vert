@@ -1,26 +1,6 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
-const int LightType_Directional = 0;
-const int LightType_Point = 1;
-const int LightType_Spot = 2;
-const int LightType_Area = 3;
-
-struct Light
-{
-    vec3  position;
-    int   type;
-
-    vec3  direction;
-    float range;
-          
-    vec3  color;
-    float intensity;
-          
-    float innerAngle;
-    float outerAngle;
-};
-
 layout(std140, binding = 0) uniform UniformBufferObject
 {
     mat4 view;
@@ -38,14 +18,31 @@ layout(std140, binding = 0) uniform UniformBufferObject
     vec3  materialSpecularColor;
     float materialRoughness;
 
-    int   lightCount;
-    Light lights[8];
+    int   directionalLightCount;
+    uvec4 clusterCount;
+    vec4  clusterScale;
+
+    mat4  inverseViewProjection;
 } ubo;
 
-layout(std140, push_constant) uniform UniformPushConstant 
+struct ObjectTransform
 {
     mat4 model;
-} upc;
+    mat3 normal;
+    mat4 modelViewProjection;
+};
+
+// one transform per scene instance
+layout(std430, binding = 2) readonly buffer ObjectTransforms
+{
+    ObjectTransform objects[];
+};
+
+// scene instances that passed the culling, the draws start at their first instance
+layout(std430, binding = 3) readonly buffer VisibleInstances
+{
+    uint visibleInstances[];
+};
 
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
@@ -57,17 +54,20 @@ layout(location = 1) out vec3 fragColor;
 layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out vec3 fragNormal;
 
+// invariant so the forward pass matches the depth of the pre-pass exactly
 out gl_PerVertex
 {
-    vec4 gl_Position;
+    invariant vec4 gl_Position;
 };
 
 void main()
 {
-    gl_Position = ubo.proj * ubo.view * upc.model * vec4(inPosition, 1.0);
+    ObjectTransform object = objects[visibleInstances[gl_InstanceIndex]];
+
+    gl_Position = object.modelViewProjection * vec4(inPosition, 1.0);
 
     fragColor = inColor;
     fragTexCoord = inTexCoord;
-    fragNormal = mat3(transpose(inverse(upc.model))) * inNormal;
-    fragPos = (upc.model * vec4(inPosition, 1.0)).xyz;
+    fragNormal = object.normal * inNormal;
+    fragPos = (object.model * vec4(inPosition, 1.0)).xyz;
 }
@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+struct ObjectTransform
+{
+    mat4 model;
+    mat3 normal;
+    mat4 modelViewProjection;
+};
+
+// one transform per scene instance
+layout(std430, binding = 2) readonly buffer ObjectTransforms
+{
+    ObjectTransform objects[];
+};
+
+// light view projection of the shadow map tile being rendered
+layout(push_constant) uniform ShadowView
+{
+    mat4 viewProjection;
+} shadowView;
+
+layout(location = 0) in vec3 inPosition;
+
+void main()
+{
+    // every instance casts, the draws start at their first instance and are not culled to the camera
+    gl_Position = shadowView.viewProjection * (objects[gl_InstanceIndex].model * vec4(inPosition, 1.0));
+}
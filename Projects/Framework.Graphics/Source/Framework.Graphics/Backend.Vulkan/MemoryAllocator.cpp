@@ -0,0 +1,319 @@
+#include "MemoryAllocator.h"
+#include "Vulkan.h"
+
+#include <Framework.Debug/Debug.h>
+
+#include <algorithm>
+
+namespace W
+{
+	struct VK::MemoryBlock
+	{
+		MemoryBlock(VkDeviceMemory deviceMemory, void* mappedData, VkDeviceSize size)
+			: DeviceMemory(deviceMemory)
+			, MappedData(mappedData)
+			, Allocator(size)
+		{
+		}
+
+		VkDeviceMemory DeviceMemory;
+		void* MappedData;
+		Memory::TlsfAllocator Allocator;
+	};
+
+	VK::MemoryAllocator::MemoryAllocator()
+		: mDevice(VK_NULL_HANDLE)
+		, mMemoryProperties()
+		, mBlockSize(DefaultBlockSize)
+		, mMaxDeviceMemoryCount(0)
+		, mDeviceMemoryCount(0)
+	{
+	}
+
+	VK::MemoryAllocator::~MemoryAllocator()
+	{
+		Debug_AssertMsg(mDeviceMemoryCount == 0, "memory allocator destroyed with live allocations");
+	}
+
+	void VK::MemoryAllocator::Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize)
+	{
+		mDevice = device;
+		mBlockSize = blockSize;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &mMemoryProperties);
+
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+		mMaxDeviceMemoryCount = deviceProperties.limits.maxMemoryAllocationCount;
+	}
+
+	void VK::MemoryAllocator::Shutdown()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		for (MemoryPool& pool : mPools)
+		{
+			Debug_AssertMsg(pool.DedicatedCount == 0, "dedicated allocations leaked");
+			for (std::unique_ptr<MemoryBlock>& block : pool.Blocks)
+			{
+				Debug_AssertMsg(block->Allocator.IsEmpty(), "sub-allocations leaked");
+				FreeDeviceMemory(block->DeviceMemory);
+			}
+			pool.Blocks.clear();
+		}
+	}
+
+	uint32_t VK::MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < mMemoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeFilter & (1 << i)) && (mMemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+			{
+				return i;
+			}
+		}
+
+		Debug_AssertMsg(false, "failed to find suitable memory type!");
+		return VK_MAX_MEMORY_TYPES;
+	}
+
+	VkResult VK::MemoryAllocator::Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceTiling tiling, MemoryAllocation& outAllocation)
+	{
+		const uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, properties);
+		if (memoryTypeIndex == VK_MAX_MEMORY_TYPES)
+			return VK_ERROR_FEATURE_NOT_PRESENT;
+
+		// Small heaps, such as the host visible part of device memory, get smaller blocks
+		const VkMemoryHeap& heap = mMemoryProperties.memoryHeaps[mMemoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+		const VkDeviceSize blockSize = std::min(mBlockSize, heap.size / 8);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		outAllocation = MemoryAllocation();
+		outAllocation.Size = requirements.size;
+		outAllocation.PoolIndex = GetPoolIndex(memoryTypeIndex, tiling);
+
+		MemoryPool& pool = mPools[outAllocation.PoolIndex];
+
+		if (requirements.size > blockSize / 2)
+		{
+			VkResult result = AllocateDeviceMemory(requirements.size, memoryTypeIndex, outAllocation.DeviceMemory, outAllocation.MappedData);
+			if (result == VK_SUCCESS)
+			{
+				++pool.DedicatedCount;
+				pool.DedicatedSize += requirements.size;
+			}
+			return result;
+		}
+
+		for (std::unique_ptr<MemoryBlock>& block : pool.Blocks)
+		{
+			if (block->Allocator.Allocate(requirements.size, requirements.alignment, outAllocation.Range))
+			{
+				outAllocation.Block = block.get();
+				break;
+			}
+		}
+
+		if (outAllocation.Block == nullptr)
+		{
+			VkDeviceMemory deviceMemory;
+			void* mappedData;
+			VkResult result = AllocateDeviceMemory(blockSize, memoryTypeIndex, deviceMemory, mappedData);
+			if (result != VK_SUCCESS)
+				return result;
+
+			pool.Blocks.push_back(std::make_unique<MemoryBlock>(deviceMemory, mappedData, blockSize));
+			outAllocation.Block = pool.Blocks.back().get();
+
+			const bool allocated = outAllocation.Block->Allocator.Allocate(requirements.size, requirements.alignment, outAllocation.Range);
+			Debug_AssertMsg(allocated, "a new block is always large enough");
+		}
+
+		outAllocation.DeviceMemory = outAllocation.Block->DeviceMemory;
+		outAllocation.Offset = outAllocation.Range.Offset;
+		if (outAllocation.Block->MappedData != nullptr)
+		{
+			outAllocation.MappedData = static_cast<uint8_t*>(outAllocation.Block->MappedData) + outAllocation.Offset;
+		}
+
+		return VK_SUCCESS;
+	}
+
+	void VK::MemoryAllocator::Free(MemoryAllocation& allocation)
+	{
+		if (allocation.DeviceMemory == VK_NULL_HANDLE)
+			return;
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		MemoryPool& pool = mPools[allocation.PoolIndex];
+
+		if (allocation.Block == nullptr)
+		{
+			--pool.DedicatedCount;
+			pool.DedicatedSize -= allocation.Size;
+			FreeDeviceMemory(allocation.DeviceMemory);
+			allocation = MemoryAllocation();
+			return;
+		}
+
+		MemoryBlock* block = allocation.Block;
+		block->Allocator.Free(allocation.Range);
+
+		// Keep one empty block per pool to avoid allocating device memory again right away
+		if (block->Allocator.IsEmpty())
+		{
+			const bool hasOtherEmptyBlock = std::any_of(pool.Blocks.begin(), pool.Blocks.end(), [block](const std::unique_ptr<MemoryBlock>& entry)
+			{
+				return entry.get() != block && entry->Allocator.IsEmpty();
+			});
+
+			if (hasOtherEmptyBlock)
+			{
+				FreeDeviceMemory(block->DeviceMemory);
+				pool.Blocks.erase(std::find_if(pool.Blocks.begin(), pool.Blocks.end(), [block](const std::unique_ptr<MemoryBlock>& entry) { return entry.get() == block; }));
+			}
+		}
+
+		allocation = MemoryAllocation();
+	}
+
+	VkResult VK::MemoryAllocator::AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryAllocation& outAllocation)
+	{
+		VkMemoryRequirements memRequirements;
+		vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
+
+		VkResult result = Allocate(memRequirements, properties, ResourceTiling::Linear, outAllocation);
+		if (result != VK_SUCCESS)
+			return result;
+
+		return vkBindBufferMemory(mDevice, buffer, outAllocation.DeviceMemory, outAllocation.Offset);
+	}
+
+	VkResult VK::MemoryAllocator::AllocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, MemoryAllocation& outAllocation)
+	{
+		VkMemoryRequirements memRequirements;
+		vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
+
+		VkResult result = Allocate(memRequirements, properties, (tiling == VK_IMAGE_TILING_LINEAR) ? ResourceTiling::Linear : ResourceTiling::Optimal, outAllocation);
+		if (result != VK_SUCCESS)
+			return result;
+
+		return vkBindImageMemory(mDevice, image, outAllocation.DeviceMemory, outAllocation.Offset);
+	}
+
+	void VK::MemoryAllocator::GetStatistics(std::vector<MemoryPoolStatistics>& outStatistics) const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		outStatistics.clear();
+		for (uint32_t memoryTypeIndex = 0; memoryTypeIndex < mMemoryProperties.memoryTypeCount; ++memoryTypeIndex)
+		{
+			for (uint32_t tiling = 0; tiling < static_cast<uint32_t>(ResourceTiling::Count); ++tiling)
+			{
+				const MemoryPool& pool = mPools[GetPoolIndex(memoryTypeIndex, static_cast<ResourceTiling>(tiling))];
+				if (pool.Blocks.empty() && pool.DedicatedCount == 0)
+					continue;
+
+				MemoryPoolStatistics poolStatistics;
+				poolStatistics.MemoryTypeIndex = memoryTypeIndex;
+				poolStatistics.Tiling = static_cast<ResourceTiling>(tiling);
+				poolStatistics.BlockCount = static_cast<uint32_t>(pool.Blocks.size());
+
+				Memory::AllocatorStatistics& statistics = poolStatistics.Statistics;
+				statistics.Size = pool.DedicatedSize;
+				statistics.UsedSize = pool.DedicatedSize;
+				statistics.AllocationCount = pool.DedicatedCount;
+				for (const std::unique_ptr<MemoryBlock>& block : pool.Blocks)
+				{
+					const Memory::AllocatorStatistics blockStatistics = block->Allocator.GetStatistics();
+					statistics.Size += blockStatistics.Size;
+					statistics.UsedSize += blockStatistics.UsedSize;
+					statistics.FreeSize += blockStatistics.FreeSize;
+					statistics.LargestFreeSize = std::max(statistics.LargestFreeSize, blockStatistics.LargestFreeSize);
+					statistics.AllocationCount += blockStatistics.AllocationCount;
+					statistics.FreeBlockCount += blockStatistics.FreeBlockCount;
+				}
+
+				outStatistics.push_back(poolStatistics);
+			}
+		}
+	}
+
+	uint32_t VK::MemoryAllocator::GetDeviceMemoryCount() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mDeviceMemoryCount;
+	}
+
+	VkResult VK::MemoryAllocator::AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory& outMemory, void*& outMappedData)
+	{
+		Debug_AssertMsg(mDeviceMemoryCount < mMaxDeviceMemoryCount, "out of device memory allocations (maxMemoryAllocationCount %u)", mMaxDeviceMemoryCount);
+
+		VkMemoryAllocateInfo allocInfo = {};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+		VkResult result = vkAllocateMemory(mDevice, &allocInfo, nullptr, &outMemory);
+		if (result != VK_SUCCESS)
+			return result;
+
+		++mDeviceMemoryCount;
+
+		outMappedData = nullptr;
+		if (mMemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		{
+			VK_CHECK(vkMapMemory(mDevice, outMemory, 0, VK_WHOLE_SIZE, 0, &outMappedData));
+		}
+
+		return VK_SUCCESS;
+	}
+
+	void VK::MemoryAllocator::FreeDeviceMemory(VkDeviceMemory memory)
+	{
+		// freeing mapped memory implicitly unmaps it
+		vkFreeMemory(mDevice, memory, nullptr);
+		--mDeviceMemoryCount;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//                              RingBuffer                              //
+	//////////////////////////////////////////////////////////////////////////
+	VkResult VK::RingBuffer::Initialize(VkDevice device, MemoryAllocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage)
+	{
+		VkBufferCreateInfo bufferInfo = {};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = size;
+		bufferInfo.usage = usage;
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkResult result = vkCreateBuffer(device, &bufferInfo, nullptr, &mBuffer);
+		if (result != VK_SUCCESS)
+			return result;
+
+		result = allocator.AllocateForBuffer(mBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mAllocation);
+		if (result != VK_SUCCESS)
+			return result;
+
+		mRing = std::make_unique<Memory::RingAllocator>(size);
+		return VK_SUCCESS;
+	}
+
+	void VK::RingBuffer::Shutdown(VkDevice device, MemoryAllocator& allocator)
+	{
+		vkDestroyBuffer(device, mBuffer, nullptr);
+		allocator.Free(mAllocation);
+
+		mBuffer = VK_NULL_HANDLE;
+		mRing.reset();
+	}
+
+	bool VK::RingBuffer::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, void*& outData)
+	{
+		uint64_t offset;
+		if (mRing->Allocate(size, alignment, offset) == false)
+			return false;
+
+		outOffset = offset;
+		outData = static_cast<uint8_t*>(mAllocation.MappedData) + offset;
+		return true;
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <Framework.Memory/RingAllocator.h>
+#include <Framework.Memory/TlsfAllocator.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace W
+{
+	namespace VK
+	{
+		struct MemoryBlock;
+
+		// Buffers and linear images never share a block with optimal images,
+		// so sub-allocations do not have to be padded to bufferImageGranularity
+		enum class ResourceTiling
+		{
+			Linear,
+			Optimal,
+			Count
+		};
+
+		// Range of a memory block, or a dedicated VkDeviceMemory when Block is null
+		struct MemoryAllocation
+		{
+			VkDeviceMemory DeviceMemory = VK_NULL_HANDLE;
+			VkDeviceSize Offset = 0;
+			VkDeviceSize Size = 0;
+			void* MappedData = nullptr; // host visible memory stays mapped
+
+			uint32_t PoolIndex = 0;
+			MemoryBlock* Block = nullptr;
+			Memory::TlsfAllocator::Allocation Range;
+		};
+
+		struct MemoryPoolStatistics
+		{
+			uint32_t MemoryTypeIndex = 0;
+			ResourceTiling Tiling = ResourceTiling::Linear;
+			uint32_t BlockCount = 0;
+			Memory::AllocatorStatistics Statistics;
+		};
+
+		// Reserves large blocks per memory type and sub-allocates resources from them with a TLSF allocator,
+		// resources larger than half a block get a dedicated allocation
+		class MemoryAllocator
+		{
+		public:
+			static const VkDeviceSize DefaultBlockSize = 64 * 1024 * 1024;
+
+			MemoryAllocator();
+			~MemoryAllocator();
+
+			MemoryAllocator(const MemoryAllocator&) = delete;
+			MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+			void Initialize(VkPhysicalDevice physicalDevice, VkDevice device, VkDeviceSize blockSize = DefaultBlockSize);
+			void Shutdown();
+
+			uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+
+			VkResult Allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, ResourceTiling tiling, MemoryAllocation& outAllocation);
+			void Free(MemoryAllocation& allocation);
+
+			// Allocate and bind the memory of the resource
+			VkResult AllocateForBuffer(VkBuffer buffer, VkMemoryPropertyFlags properties, MemoryAllocation& outAllocation);
+			VkResult AllocateForImage(VkImage image, VkImageTiling tiling, VkMemoryPropertyFlags properties, MemoryAllocation& outAllocation);
+
+			// One entry per pool in use, dedicated allocations are reported with zero blocks
+			void GetStatistics(std::vector<MemoryPoolStatistics>& outStatistics) const;
+			uint32_t GetDeviceMemoryCount() const;
+			uint32_t GetMaxDeviceMemoryCount() const { return mMaxDeviceMemoryCount; }
+
+		private:
+			struct MemoryPool
+			{
+				std::vector<std::unique_ptr<MemoryBlock>> Blocks;
+				uint32_t DedicatedCount = 0;
+				VkDeviceSize DedicatedSize = 0;
+			};
+
+			VkResult AllocateDeviceMemory(VkDeviceSize size, uint32_t memoryTypeIndex, VkDeviceMemory& outMemory, void*& outMappedData);
+			void FreeDeviceMemory(VkDeviceMemory memory);
+
+			static uint32_t GetPoolIndex(uint32_t memoryTypeIndex, ResourceTiling tiling) { return memoryTypeIndex * static_cast<uint32_t>(ResourceTiling::Count) + static_cast<uint32_t>(tiling); }
+
+			VkDevice mDevice;
+			VkPhysicalDeviceMemoryProperties mMemoryProperties;
+			VkDeviceSize mBlockSize;
+			uint32_t mMaxDeviceMemoryCount;
+			uint32_t mDeviceMemoryCount;
+
+			MemoryPool mPools[VK_MAX_MEMORY_TYPES * static_cast<uint32_t>(ResourceTiling::Count)];
+			mutable std::mutex mMutex;
+		};
+
+		// Host visible buffer for transient data, such as staging copies, allocated linearly and released in order
+		class RingBuffer
+		{
+		public:
+			RingBuffer() = default;
+
+			RingBuffer(const RingBuffer&) = delete;
+			RingBuffer& operator=(const RingBuffer&) = delete;
+
+			VkResult Initialize(VkDevice device, MemoryAllocator& allocator, VkDeviceSize size, VkBufferUsageFlags usage);
+			void Shutdown(VkDevice device, MemoryAllocator& allocator);
+
+			// Fails when the data does not fit until older allocations are released
+			bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset, void*& outData);
+
+			// Marker past every allocation made so far, release it once the GPU is done with them
+			uint64_t GetHead() const { return mRing->GetHead(); }
+			void Release(uint64_t head) { mRing->Release(head); }
+
+			VkBuffer GetBuffer() const { return mBuffer; }
+			VkDeviceSize GetSize() const { return mRing->GetSize(); }
+			VkDeviceSize GetUsedSize() const { return mRing->GetUsedSize(); }
+
+		private:
+			VkBuffer mBuffer = VK_NULL_HANDLE;
+			MemoryAllocation mAllocation;
+			std::unique_ptr<Memory::RingAllocator> mRing;
+		};
+	} // namespace VK
+} // namespace W
\ No newline at end of file
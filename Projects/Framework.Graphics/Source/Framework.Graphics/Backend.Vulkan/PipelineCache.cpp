@@ -0,0 +1,147 @@
+#include "PipelineCache.h"
+
+#include <Framework.Debug/Debug.h>
+#include <Framework/Hash.h>
+#include <Framework.IO/MappedFile.h>
+
+#include <fstream>
+#include <string.h>
+#include <vector>
+
+namespace W
+{
+	// The driver validates its own header, this one also rejects files from older drivers and partial writes
+	struct PipelineCacheFileHeader
+	{
+		uint32_t Magic;
+		uint32_t Version;
+		uint32_t VendorId;
+		uint32_t DeviceId;
+		uint32_t DriverVersion;
+		uint32_t DataChecksum; // CRC-32C of the cache data
+		uint64_t DataSize;
+		uint8_t PipelineCacheUUID[VK_UUID_SIZE];
+	};
+
+	static const uint32_t PIPELINE_CACHE_MAGIC = 'T' | ('B' << 8) | ('P' << 16) | ('C' << 24);
+	static const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+	VkResult VK::PipelineCache::Initialize(VkPhysicalDevice physicalDevice, VkDevice device, const char* filePath)
+	{
+		mDevice = device;
+		mFilePath = filePath;
+		mLoadedSize = 0;
+
+		vkGetPhysicalDeviceProperties(physicalDevice, &mDeviceProperties);
+
+		IO::MappedFile file;
+		const void* initialData = nullptr;
+		if (file.Open(filePath))
+		{
+			const PipelineCacheFileHeader* header = static_cast<const PipelineCacheFileHeader*>(file.Data());
+			const void* data = header + 1;
+
+			bool isValid = file.Size() >= sizeof(PipelineCacheFileHeader)
+				&& header->Magic == PIPELINE_CACHE_MAGIC
+				&& header->Version == PIPELINE_CACHE_VERSION
+				&& header->VendorId == mDeviceProperties.vendorID
+				&& header->DeviceId == mDeviceProperties.deviceID
+				&& header->DriverVersion == mDeviceProperties.driverVersion
+				&& memcmp(header->PipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0
+				&& header->DataSize == file.Size() - sizeof(PipelineCacheFileHeader);
+
+			isValid = isValid
+				&& IsCompatible(data, static_cast<size_t>(header->DataSize))
+				&& header->DataChecksum == Hash::Crc32C(data, static_cast<size_t>(header->DataSize));
+
+			if (isValid)
+			{
+				initialData = data;
+				mLoadedSize = static_cast<size_t>(header->DataSize);
+			}
+			else
+			{
+				Logger::PrintFormat("[PipelineCache] %s is stale or corrupted, starting empty\n", filePath);
+			}
+		}
+
+		VkPipelineCacheCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		createInfo.initialDataSize = mLoadedSize;
+		createInfo.pInitialData = initialData;
+
+		VkResult result = vkCreatePipelineCache(mDevice, &createInfo, nullptr, &mCache);
+		if (result != VK_SUCCESS && initialData != nullptr)
+		{
+			// the driver can still refuse the data, a cold cache is always valid
+			mLoadedSize = 0;
+			createInfo.initialDataSize = 0;
+			createInfo.pInitialData = nullptr;
+			result = vkCreatePipelineCache(mDevice, &createInfo, nullptr, &mCache);
+		}
+
+		return result;
+	}
+
+	void VK::PipelineCache::Shutdown()
+	{
+		if (mCache == VK_NULL_HANDLE)
+			return;
+
+		if (Save() == false)
+		{
+			Logger::PrintFormat("[PipelineCache] failed to write %s\n", mFilePath.c_str());
+		}
+
+		vkDestroyPipelineCache(mDevice, mCache, nullptr);
+		mCache = VK_NULL_HANDLE;
+	}
+
+	bool VK::PipelineCache::IsCompatible(const void* data, size_t size) const
+	{
+		// VkPipelineCacheHeaderVersionOne, read field by field since the data has no alignment guarantee
+		const size_t headerSize = 4 * sizeof(uint32_t) + VK_UUID_SIZE;
+		if (size < headerSize)
+			return false;
+
+		uint32_t fields[4];
+		memcpy(fields, data, sizeof(fields));
+		const uint8_t* uuid = static_cast<const uint8_t*>(data) + sizeof(fields);
+
+		return fields[0] >= headerSize
+			&& fields[1] == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+			&& fields[2] == mDeviceProperties.vendorID
+			&& fields[3] == mDeviceProperties.deviceID
+			&& memcmp(uuid, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+	}
+
+	bool VK::PipelineCache::Save() const
+	{
+		size_t dataSize = 0;
+		if (vkGetPipelineCacheData(mDevice, mCache, &dataSize, nullptr) != VK_SUCCESS)
+			return false;
+
+		std::vector<char> data(dataSize);
+		if (vkGetPipelineCacheData(mDevice, mCache, &dataSize, data.data()) != VK_SUCCESS)
+			return false;
+
+		PipelineCacheFileHeader header = {};
+		header.Magic = PIPELINE_CACHE_MAGIC;
+		header.Version = PIPELINE_CACHE_VERSION;
+		header.VendorId = mDeviceProperties.vendorID;
+		header.DeviceId = mDeviceProperties.deviceID;
+		header.DriverVersion = mDeviceProperties.driverVersion;
+		header.DataChecksum = Hash::Crc32C(data.data(), dataSize);
+		header.DataSize = dataSize;
+		memcpy(header.PipelineCacheUUID, mDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE);
+
+		std::ofstream file(mFilePath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+			return false;
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(PipelineCacheFileHeader));
+		file.write(data.data(), static_cast<std::streamsize>(dataSize));
+
+		return file.good();
+	}
+} // namespace W
\ No newline at end of file
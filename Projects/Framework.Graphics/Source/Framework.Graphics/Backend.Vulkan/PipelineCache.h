@@ -0,0 +1,40 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+namespace W
+{
+	namespace VK
+	{
+		// VkPipelineCache persisted in a file between runs
+		// The file is ignored when it was written for another device or driver, or when it is truncated or corrupted
+		class PipelineCache
+		{
+		public:
+			PipelineCache() = default;
+
+			PipelineCache(const PipelineCache&) = delete;
+			PipelineCache& operator=(const PipelineCache&) = delete;
+
+			VkResult Initialize(VkPhysicalDevice physicalDevice, VkDevice device, const char* filePath);
+			// Writes the cache back to its file and destroys it
+			void Shutdown();
+
+			VkPipelineCache GetHandle() const { return mCache; }
+
+			// Size of the data loaded from the file, 0 on a cold start
+			size_t GetLoadedSize() const { return mLoadedSize; }
+
+		private:
+			bool IsCompatible(const void* data, size_t size) const;
+			bool Save() const;
+
+			VkDevice mDevice = VK_NULL_HANDLE;
+			VkPipelineCache mCache = VK_NULL_HANDLE;
+			VkPhysicalDeviceProperties mDeviceProperties;
+			std::string mFilePath;
+			size_t mLoadedSize = 0;
+		};
+	} // namespace VK
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,365 @@
+#include "UploadQueue.h"
+#include "Vulkan.h"
+
+#include <Framework.Debug/Debug.h>
+
+#include <string.h>
+#include <utility>
+
+namespace W
+{
+	// Copies in a buffer and buffer to image copies of 4 byte texels need 4 byte aligned offsets
+	static const VkDeviceSize s_stagingAlignment = 16;
+
+	// Accesses made visible on the graphics queue when acquiring the resources
+	static const VkAccessFlags s_bufferAcquireAccess = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+	static const VkAccessFlags s_imageAcquireAccess = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	VkResult VK::UploadQueue::Initialize(VkDevice device, MemoryAllocator& allocator, VkQueue transferQueue, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex, VkDeviceSize stagingSize)
+	{
+		mDevice = device;
+		mAllocator = &allocator;
+		mQueue = transferQueue;
+		mTransferFamilyIndex = transferFamilyIndex;
+		mGraphicsFamilyIndex = graphicsFamilyIndex;
+
+		VkCommandPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = transferFamilyIndex;
+
+		VkResult result = vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mCommandPool);
+		if (result != VK_SUCCESS)
+			return result;
+
+		for (Batch& batch : mBatches)
+		{
+			VkCommandBufferAllocateInfo allocInfo = {};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = mCommandPool;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			result = vkAllocateCommandBuffers(mDevice, &allocInfo, &batch.CommandBuffer);
+			if (result != VK_SUCCESS)
+				return result;
+
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			result = vkCreateFence(mDevice, &fenceInfo, nullptr, &batch.Fence);
+			if (result != VK_SUCCESS)
+				return result;
+		}
+
+		return mStagingBuffer.Initialize(mDevice, allocator, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+	}
+
+	void VK::UploadQueue::Shutdown()
+	{
+		WaitIdle();
+
+		for (Batch& batch : mBatches)
+		{
+			vkFreeCommandBuffers(mDevice, mCommandPool, 1, &batch.CommandBuffer);
+			vkDestroyFence(mDevice, batch.Fence, nullptr);
+			batch = Batch();
+		}
+
+		vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+		mCommandPool = VK_NULL_HANDLE;
+
+		// the graphics queue is idle as well, the transfers that were never acquired are dropped
+		for (VkSemaphore semaphore : mSemaphores)
+		{
+			vkDestroySemaphore(mDevice, semaphore, nullptr);
+		}
+		mSemaphores.clear();
+		mFreeSemaphores.clear();
+		mCompletedTransfers.clear();
+
+		mStagingBuffer.Shutdown(mDevice, *mAllocator);
+	}
+
+	VkCommandBuffer VK::UploadQueue::GetCommandBuffer()
+	{
+		Batch& batch = mBatches[mRecordingBatch];
+		if (batch.IsRecording == false)
+		{
+			VkCommandBufferBeginInfo beginInfo = {};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+			VK_CHECK(vkBeginCommandBuffer(batch.CommandBuffer, &beginInfo));
+			batch.IsRecording = true;
+		}
+
+		return batch.CommandBuffer;
+	}
+
+	uint64_t VK::UploadQueue::UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size)
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceSize stagingOffset;
+		Stage(data, size, stagingBuffer, stagingOffset);
+
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = stagingOffset;
+		copyRegion.dstOffset = dstOffset;
+		copyRegion.size = size;
+		vkCmdCopyBuffer(GetCommandBuffer(), stagingBuffer, dstBuffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = IsDedicatedQueue() ? mTransferFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = IsDedicatedQueue() ? mGraphicsFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = dstBuffer;
+		barrier.offset = dstOffset;
+		barrier.size = size;
+		mBatches[mRecordingBatch].Transfer.BufferBarriers.push_back(barrier);
+
+		return mSubmitCount + 1;
+	}
+
+	uint64_t VK::UploadQueue::UploadImage(VkImage dstImage, uint32_t width, uint32_t height, uint32_t mipLevels, const void* data, VkDeviceSize size)
+	{
+		VkBuffer stagingBuffer;
+		VkDeviceSize stagingOffset;
+		Stage(data, size, stagingBuffer, stagingOffset);
+
+		VkCommandBuffer commandBuffer = GetCommandBuffer();
+
+		VkImageMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = dstImage;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		VkBufferImageCopy region = {};
+		region.bufferOffset = stagingOffset;
+		region.bufferRowLength = 0;
+		region.bufferImageHeight = 0;
+		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		region.imageSubresource.mipLevel = 0;
+		region.imageSubresource.baseArrayLayer = 0;
+		region.imageSubresource.layerCount = 1;
+		region.imageOffset = { 0, 0, 0 };
+		region.imageExtent = { width, height, 1 };
+		vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, dstImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+		// keeps the layout, the mip levels are generated after the graphics queue acquires the image
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcQueueFamilyIndex = IsDedicatedQueue() ? mTransferFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = IsDedicatedQueue() ? mGraphicsFamilyIndex : VK_QUEUE_FAMILY_IGNORED;
+		mBatches[mRecordingBatch].Transfer.ImageBarriers.push_back(barrier);
+
+		return mSubmitCount + 1;
+	}
+
+	void VK::UploadQueue::Submit()
+	{
+		Batch& batch = mBatches[mRecordingBatch];
+		if (batch.IsRecording == false)
+			return;
+
+		OwnershipTransfer& transfer = batch.Transfer;
+
+		// Release the resources to the graphics queue family, Acquire records the matching barriers
+		if (IsDedicatedQueue())
+		{
+			vkCmdPipelineBarrier(batch.CommandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+				0, nullptr,
+				static_cast<uint32_t>(transfer.BufferBarriers.size()), transfer.BufferBarriers.data(),
+				static_cast<uint32_t>(transfer.ImageBarriers.size()), transfer.ImageBarriers.data());
+		}
+
+		VK_CHECK(vkEndCommandBuffer(batch.CommandBuffer));
+
+		if (mFreeSemaphores.empty())
+		{
+			VkSemaphoreCreateInfo semaphoreInfo = {};
+			semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+			VkSemaphore semaphore;
+			VK_CHECK(vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &semaphore));
+			mSemaphores.push_back(semaphore);
+			mFreeSemaphores.push_back(semaphore);
+		}
+
+		transfer.Semaphore = mFreeSemaphores.back();
+		mFreeSemaphores.pop_back();
+		transfer.Serial = ++mSubmitCount;
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &batch.CommandBuffer;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &transfer.Semaphore;
+		VK_CHECK(vkQueueSubmit(mQueue, 1, &submitInfo, batch.Fence));
+
+		batch.StagingHead = mStagingBuffer.GetHead();
+		batch.IsRecording = false;
+		batch.IsPending = true;
+
+		// Every batch in flight, wait for the oldest one
+		mRecordingBatch = (mRecordingBatch + 1) % BatchCount;
+		if (mBatches[mRecordingBatch].IsPending)
+		{
+			Retire(mBatches[mRecordingBatch]);
+		}
+	}
+
+	void VK::UploadQueue::Update()
+	{
+		for (uint32_t i = 1; i < BatchCount; ++i)
+		{
+			Batch& batch = mBatches[(mRecordingBatch + i) % BatchCount];
+			if (batch.IsPending == false)
+				continue;
+
+			if (vkGetFenceStatus(mDevice, batch.Fence) != VK_SUCCESS)
+				break;
+
+			Retire(batch);
+		}
+	}
+
+	void VK::UploadQueue::WaitIdle()
+	{
+		Submit();
+
+		for (uint32_t i = 1; i < BatchCount; ++i)
+		{
+			Batch& batch = mBatches[(mRecordingBatch + i) % BatchCount];
+			if (batch.IsPending)
+			{
+				Retire(batch);
+			}
+		}
+	}
+
+	void VK::UploadQueue::Acquire(VkCommandBuffer commandBuffer, std::vector<VkSemaphore>& outWaitSemaphores)
+	{
+		if (mCompletedTransfers.empty())
+			return;
+
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+
+		for (OwnershipTransfer& transfer : mCompletedTransfers)
+		{
+			// the source access is ignored by an ownership transfer, it is the copies otherwise
+			for (VkBufferMemoryBarrier& barrier : transfer.BufferBarriers)
+			{
+				barrier.dstAccessMask = s_bufferAcquireAccess;
+				bufferBarriers.push_back(barrier);
+			}
+
+			for (VkImageMemoryBarrier& barrier : transfer.ImageBarriers)
+			{
+				barrier.dstAccessMask = s_imageAcquireAccess;
+				imageBarriers.push_back(barrier);
+			}
+
+			outWaitSemaphores.push_back(transfer.Semaphore);
+			mAcquiredSerial = transfer.Serial;
+		}
+		mCompletedTransfers.clear();
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0,
+			0, nullptr,
+			static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+	}
+
+	void VK::UploadQueue::ReleaseSemaphores(std::vector<VkSemaphore>& semaphores)
+	{
+		mFreeSemaphores.insert(mFreeSemaphores.end(), semaphores.begin(), semaphores.end());
+		semaphores.clear();
+	}
+
+	void VK::UploadQueue::Stage(const void* data, VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset)
+	{
+		void* stagingData = nullptr;
+		if (size <= mStagingBuffer.GetSize())
+		{
+			// The ring is full of data in flight, submit what was recorded and wait for the oldest batch
+			while (mStagingBuffer.Allocate(size, s_stagingAlignment, outOffset, stagingData) == false)
+			{
+				Submit();
+
+				bool hasPendingBatch = false;
+				for (uint32_t i = 1; i < BatchCount && hasPendingBatch == false; ++i)
+				{
+					Batch& batch = mBatches[(mRecordingBatch + i) % BatchCount];
+					if (batch.IsPending)
+					{
+						Retire(batch);
+						hasPendingBatch = true;
+					}
+				}
+				Debug_AssertMsg(hasPendingBatch, "staging ring full without uploads in flight");
+			}
+
+			outBuffer = mStagingBuffer.GetBuffer();
+		}
+		else
+		{
+			VkBufferCreateInfo bufferInfo = {};
+			bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferInfo.size = size;
+			bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			TemporaryBuffer temporaryBuffer;
+			VK_CHECK(vkCreateBuffer(mDevice, &bufferInfo, nullptr, &temporaryBuffer.Buffer));
+			VK_CHECK(mAllocator->AllocateForBuffer(temporaryBuffer.Buffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, temporaryBuffer.Memory));
+
+			// destroyed with the batch that copies it
+			mBatches[mRecordingBatch].TemporaryBuffers.push_back(temporaryBuffer);
+
+			outBuffer = temporaryBuffer.Buffer;
+			outOffset = 0;
+			stagingData = temporaryBuffer.Memory.MappedData;
+		}
+
+		memcpy(stagingData, data, static_cast<size_t>(size));
+		mUploadedSize += size;
+	}
+
+	void VK::UploadQueue::Retire(Batch& batch)
+	{
+		VK_CHECK(vkWaitForFences(mDevice, 1, &batch.Fence, VK_TRUE, UINT64_MAX));
+		VK_CHECK(vkResetFences(mDevice, 1, &batch.Fence));
+
+		mStagingBuffer.Release(batch.StagingHead);
+
+		for (TemporaryBuffer& temporaryBuffer : batch.TemporaryBuffers)
+		{
+			vkDestroyBuffer(mDevice, temporaryBuffer.Buffer, nullptr);
+			mAllocator->Free(temporaryBuffer.Memory);
+		}
+		batch.TemporaryBuffers.clear();
+
+		// handed over to the graphics queue by the next Acquire
+		mCompletedTransfers.push_back(std::move(batch.Transfer));
+		batch.Transfer = OwnershipTransfer();
+
+		batch.IsPending = false;
+	}
+} // namespace W
\ No newline at end of file
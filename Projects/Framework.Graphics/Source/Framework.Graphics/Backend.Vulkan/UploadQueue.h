@@ -0,0 +1,110 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+
+#include <array>
+#include <vector>
+
+namespace W
+{
+	namespace VK
+	{
+		// Records staging copies into batched command buffers submitted to a transfer queue with a fence,
+		// the staging ring is recycled as the fences signal and the CPU only waits when the ring or every batch is in flight
+		// Completed batches are handed over to the graphics queue by Acquire, with a semaphore and the ownership barriers
+		// of their resources when the transfer queue is from another family
+		class UploadQueue
+		{
+		public:
+			UploadQueue() = default;
+
+			UploadQueue(const UploadQueue&) = delete;
+			UploadQueue& operator=(const UploadQueue&) = delete;
+
+			// transferFamilyIndex can be the graphics family when the device has no dedicated transfer queue
+			VkResult Initialize(VkDevice device, MemoryAllocator& allocator, VkQueue transferQueue, uint32_t transferFamilyIndex, uint32_t graphicsFamilyIndex, VkDeviceSize stagingSize);
+			void Shutdown();
+
+			// Records copies of data, which can be released as soon as the call returns
+			// Returns the serial of the batch, the resource can be used on the graphics queue once it is acquired
+			uint64_t UploadBuffer(VkBuffer dstBuffer, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+			// Writes the first mip level, the image is left in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL for the graphics queue to generate the others
+			uint64_t UploadImage(VkImage dstImage, uint32_t width, uint32_t height, uint32_t mipLevels, const void* data, VkDeviceSize size);
+
+			void Submit();
+
+			// Recycles the staging memory of the completed batches, call once per frame
+			void Update();
+			void WaitIdle();
+
+			// Records the acquire barriers of the completed batches in a graphics command buffer,
+			// its submission must wait for the semaphores at VK_PIPELINE_STAGE_TRANSFER_BIT
+			void Acquire(VkCommandBuffer commandBuffer, std::vector<VkSemaphore>& outWaitSemaphores);
+			// Semaphores returned by Acquire, once the submission waiting for them is complete
+			void ReleaseSemaphores(std::vector<VkSemaphore>& semaphores);
+
+			uint64_t GetAcquiredSerial() const { return mAcquiredSerial; }
+			bool IsDedicatedQueue() const { return mTransferFamilyIndex != mGraphicsFamilyIndex; }
+
+			uint32_t GetSubmitCount() const { return static_cast<uint32_t>(mSubmitCount); }
+			VkDeviceSize GetUploadedSize() const { return mUploadedSize; }
+
+		private:
+			static const uint32_t BatchCount = 4;
+
+			struct TemporaryBuffer
+			{
+				VkBuffer Buffer;
+				MemoryAllocation Memory;
+			};
+
+			// Resources of a batch to hand over to the graphics queue
+			struct OwnershipTransfer
+			{
+				uint64_t Serial = 0;
+				VkSemaphore Semaphore = VK_NULL_HANDLE;
+				std::vector<VkBufferMemoryBarrier> BufferBarriers;
+				std::vector<VkImageMemoryBarrier> ImageBarriers;
+			};
+
+			struct Batch
+			{
+				VkCommandBuffer CommandBuffer = VK_NULL_HANDLE;
+				VkFence Fence = VK_NULL_HANDLE;
+				uint64_t StagingHead = 0;
+				std::vector<TemporaryBuffer> TemporaryBuffers;
+				OwnershipTransfer Transfer;
+				bool IsRecording = false;
+				bool IsPending = false;
+			};
+
+			VkCommandBuffer GetCommandBuffer();
+
+			// Copies the data in the staging ring, or a temporary buffer when it is larger than the ring
+			void Stage(const void* data, VkDeviceSize size, VkBuffer& outBuffer, VkDeviceSize& outOffset);
+			void Retire(Batch& batch);
+
+			VkDevice mDevice = VK_NULL_HANDLE;
+			MemoryAllocator* mAllocator = nullptr;
+			VkQueue mQueue = VK_NULL_HANDLE;
+			uint32_t mTransferFamilyIndex = 0;
+			uint32_t mGraphicsFamilyIndex = 0;
+			VkCommandPool mCommandPool = VK_NULL_HANDLE;
+			RingBuffer mStagingBuffer;
+
+			// Batches are submitted and retired in index order
+			std::array<Batch, BatchCount> mBatches;
+			uint32_t mRecordingBatch = 0;
+
+			// Retired batches waiting for Acquire, in submission order
+			std::vector<OwnershipTransfer> mCompletedTransfers;
+			std::vector<VkSemaphore> mFreeSemaphores;
+			std::vector<VkSemaphore> mSemaphores;
+
+			uint64_t mSubmitCount = 0;
+			uint64_t mAcquiredSerial = 0;
+			VkDeviceSize mUploadedSize = 0;
+		};
+	} // namespace VK
+} // namespace W
\ No newline at end of file
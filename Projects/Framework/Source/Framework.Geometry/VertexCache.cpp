@@ -0,0 +1,422 @@
+#include "VertexCache.h"
+#include <Framework.Debug/Debug.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace W
+{
+	static const uint32_t s_invalidIndex = ~0u;
+
+	//////////////////////////////////////////////////////////////////////////
+	//                          Vertex Cache Score                          //
+	//////////////////////////////////////////////////////////////////////////
+	static const uint32_t s_maxCacheSize = 32;
+	static const uint32_t s_maxValence = 32;
+
+	struct VertexScoreTable
+	{
+		float Cache[s_maxCacheSize];
+		float Valence[s_maxValence];
+
+		VertexScoreTable()
+		{
+			const float cacheDecayPower = 1.5f;
+			const float lastTriangleScore = 0.75f;
+			const float valenceBoostScale = 2.0f;
+			const float valenceBoostPower = 0.5f;
+
+			for (uint32_t i = 0; i < s_maxCacheSize; ++i)
+			{
+				// the vertices of the last triangle are scored the same regardless of the order they were emitted
+				if (i < 3)
+				{
+					Cache[i] = lastTriangleScore;
+				}
+				else
+				{
+					const float scaler = 1.0f / (s_maxCacheSize - 3);
+					Cache[i] = powf(1.0f - ((i - 3) * scaler), cacheDecayPower);
+				}
+			}
+
+			// boost the vertices with few remaining triangles to get rid of lone triangles
+			Valence[0] = 0.0f;
+			for (uint32_t i = 1; i < s_maxValence; ++i)
+			{
+				Valence[i] = valenceBoostScale * powf(static_cast<float>(i), -valenceBoostPower);
+			}
+		}
+
+		float Score(uint32_t cachePosition, uint32_t liveTriangles) const
+		{
+			if (liveTriangles == 0)
+				return -1.0f;
+
+			float score = (cachePosition < s_maxCacheSize) ? Cache[cachePosition] : 0.0f;
+			score += (liveTriangles < s_maxValence) ? Valence[liveTriangles] : 2.0f * powf(static_cast<float>(liveTriangles), -0.5f);
+			return score;
+		}
+	};
+
+	static const VertexScoreTable s_vertexScoreTable;
+
+	//////////////////////////////////////////////////////////////////////////
+	//                           Cache Analysis                             //
+	//////////////////////////////////////////////////////////////////////////
+	Geometry::VertexCacheStatistics Geometry::AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		Debug_Assert(indexCount % 3 == 0);
+
+		VertexCacheStatistics statistics;
+		if (indexCount == 0)
+			return statistics;
+
+		// a vertex is in the FIFO cache while fewer than cacheSize vertices were added after it
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		uint32_t timestamp = cacheSize + 1;
+
+		size_t referencedVertexCount = 0;
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			const uint32_t index = indices[i];
+			Debug_Assert(index < vertexCount);
+
+			if (cacheTimestamps[index] == 0)
+			{
+				++referencedVertexCount;
+			}
+
+			if (timestamp - cacheTimestamps[index] > cacheSize)
+			{
+				cacheTimestamps[index] = timestamp++;
+				statistics.VerticesTransformed += 1;
+			}
+		}
+
+		statistics.ACMR = static_cast<float>(statistics.VerticesTransformed) / static_cast<float>(indexCount / 3);
+		statistics.ATVR = static_cast<float>(statistics.VerticesTransformed) / static_cast<float>(referencedVertexCount);
+		return statistics;
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//                         Vertex Cache Order                           //
+	//////////////////////////////////////////////////////////////////////////
+	void Geometry::OptimizeVertexCache(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		Debug_Assert(indexCount % 3 == 0);
+		Debug_Assert(outIndices != indices);
+
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// triangle adjacency of every vertex, the live triangles are kept at the front of each range
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			Debug_Assert(indices[i] < vertexCount);
+			liveTriangles[indices[i]] += 1;
+		}
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+		}
+
+		std::vector<uint32_t> adjacency(indexCount);
+		{
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < indexCount; ++i)
+			{
+				adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		std::vector<uint32_t> cachePositions(vertexCount, s_invalidIndex);
+
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+		{
+			vertexScores[v] = s_vertexScoreTable.Score(s_invalidIndex, liveTriangles[v]);
+		}
+
+		std::vector<float> triangleScores(triangleCount);
+		std::vector<bool> emitted(triangleCount, false);
+
+		uint32_t bestTriangle = 0;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			const uint32_t* triangle = &indices[t * 3];
+			triangleScores[t] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+
+			if (triangleScores[t] > triangleScores[bestTriangle])
+			{
+				bestTriangle = static_cast<uint32_t>(t);
+			}
+		}
+
+		uint32_t cache[s_maxCacheSize + 3];
+		uint32_t cacheCount = 0;
+
+		size_t inputCursor = 0;
+		for (size_t outputTriangle = 0; outputTriangle < triangleCount; ++outputTriangle)
+		{
+			// dead end, continue with the next triangle in input order
+			if (bestTriangle == s_invalidIndex)
+			{
+				while (emitted[inputCursor])
+				{
+					++inputCursor;
+				}
+				bestTriangle = static_cast<uint32_t>(inputCursor);
+			}
+
+			const uint32_t* triangle = &indices[bestTriangle * 3];
+			outIndices[(outputTriangle * 3) + 0] = triangle[0];
+			outIndices[(outputTriangle * 3) + 1] = triangle[1];
+			outIndices[(outputTriangle * 3) + 2] = triangle[2];
+			emitted[bestTriangle] = true;
+
+			// remove the triangle from the adjacency of its vertices
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t v = triangle[k];
+				uint32_t* vertexAdjacency = &adjacency[adjacencyOffsets[v]];
+				for (uint32_t a = 0; a < liveTriangles[v]; ++a)
+				{
+					if (vertexAdjacency[a] == bestTriangle)
+					{
+						vertexAdjacency[a] = vertexAdjacency[liveTriangles[v] - 1];
+						liveTriangles[v] -= 1;
+						break;
+					}
+				}
+			}
+
+			// move the triangle's vertices to the front of the LRU cache
+			uint32_t newCache[s_maxCacheSize + 3];
+			uint32_t newCacheCount = 0;
+
+			newCache[newCacheCount++] = triangle[0];
+			newCache[newCacheCount++] = triangle[1];
+			newCache[newCacheCount++] = triangle[2];
+
+			for (uint32_t i = 0; i < cacheCount; ++i)
+			{
+				const uint32_t v = cache[i];
+				if (v != triangle[0] && v != triangle[1] && v != triangle[2])
+				{
+					newCache[newCacheCount++] = v;
+				}
+			}
+
+			// vertices pushed out of the cache only lose their cache score
+			for (uint32_t i = s_maxCacheSize; i < newCacheCount; ++i)
+			{
+				const uint32_t v = newCache[i];
+				cachePositions[v] = s_invalidIndex;
+				vertexScores[v] = s_vertexScoreTable.Score(s_invalidIndex, liveTriangles[v]);
+			}
+
+			cacheCount = std::min(newCacheCount, s_maxCacheSize);
+			memcpy(cache, newCache, cacheCount * sizeof(uint32_t));
+
+			for (uint32_t i = 0; i < cacheCount; ++i)
+			{
+				const uint32_t v = cache[i];
+				cachePositions[v] = i;
+				vertexScores[v] = s_vertexScoreTable.Score(i, liveTriangles[v]);
+			}
+
+			// rescore the triangles touching the cache, the best of them is emitted next
+			bestTriangle = s_invalidIndex;
+			float bestScore = 0.0f;
+
+			for (uint32_t i = 0; i < cacheCount; ++i)
+			{
+				const uint32_t v = cache[i];
+				const uint32_t* vertexAdjacency = &adjacency[adjacencyOffsets[v]];
+				for (uint32_t a = 0; a < liveTriangles[v]; ++a)
+				{
+					const uint32_t t = vertexAdjacency[a];
+					const uint32_t* adjacentTriangle = &indices[t * 3];
+
+					const float score = vertexScores[adjacentTriangle[0]] + vertexScores[adjacentTriangle[1]] + vertexScores[adjacentTriangle[2]];
+					triangleScores[t] = score;
+
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestTriangle = t;
+					}
+				}
+			}
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//                             Overdraw                                 //
+	//////////////////////////////////////////////////////////////////////////
+	struct TriangleCluster
+	{
+		uint32_t FirstTriangle;
+		uint32_t TriangleCount;
+		float SortKey;
+	};
+
+	static void GetPosition(float(&outPosition)[3], const float* vertexPositions, size_t vertexPositionsStride, uint32_t index)
+	{
+		const uint8_t* position = reinterpret_cast<const uint8_t*>(vertexPositions) + (index * vertexPositionsStride);
+		memcpy(outPosition, position, sizeof(outPosition));
+	}
+
+	void Geometry::OptimizeOverdraw(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride)
+	{
+		Debug_Assert(indexCount % 3 == 0);
+		Debug_Assert(outIndices != indices);
+
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// hard cluster boundaries are where the cache optimized order restarts, a triangle missing on all of its vertices
+		const uint32_t cacheSize = 16;
+		std::vector<uint32_t> cacheTimestamps(vertexCount, 0);
+		uint32_t timestamp = cacheSize + 1;
+
+		std::vector<TriangleCluster> clusters;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			uint32_t misses = 0;
+			for (int k = 0; k < 3; ++k)
+			{
+				const uint32_t index = indices[(t * 3) + k];
+				Debug_Assert(index < vertexCount);
+
+				if (timestamp - cacheTimestamps[index] > cacheSize)
+				{
+					cacheTimestamps[index] = timestamp++;
+					misses += 1;
+				}
+			}
+
+			if (clusters.empty() || misses == 3)
+			{
+				clusters.push_back({ static_cast<uint32_t>(t), 0, 0.0f });
+			}
+			clusters.back().TriangleCount += 1;
+		}
+
+		// area weighted centroid and normal of every cluster
+		std::vector<float> clusterData(clusters.size() * 7, 0.0f);
+		float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			float* centroid = &clusterData[(c * 7) + 0];
+			float* normal = &clusterData[(c * 7) + 3];
+			float& area = clusterData[(c * 7) + 6];
+
+			const TriangleCluster& cluster = clusters[c];
+			for (uint32_t t = cluster.FirstTriangle; t < cluster.FirstTriangle + cluster.TriangleCount; ++t)
+			{
+				float p0[3], p1[3], p2[3];
+				GetPosition(p0, vertexPositions, vertexPositionsStride, indices[(t * 3) + 0]);
+				GetPosition(p1, vertexPositions, vertexPositionsStride, indices[(t * 3) + 1]);
+				GetPosition(p2, vertexPositions, vertexPositionsStride, indices[(t * 3) + 2]);
+
+				const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+				const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+				const float n[3] = { (e1[1] * e2[2]) - (e1[2] * e2[1]), (e1[2] * e2[0]) - (e1[0] * e2[2]), (e1[0] * e2[1]) - (e1[1] * e2[0]) };
+				const float triangleArea = sqrtf((n[0] * n[0]) + (n[1] * n[1]) + (n[2] * n[2]));
+
+				for (int k = 0; k < 3; ++k)
+				{
+					centroid[k] += (p0[k] + p1[k] + p2[k]) * (triangleArea / 3.0f);
+					normal[k] += n[k];
+				}
+				area += triangleArea;
+			}
+
+			for (int k = 0; k < 3; ++k)
+			{
+				meshCentroid[k] += centroid[k];
+			}
+			meshArea += area;
+		}
+
+		const float invMeshArea = (meshArea > 0.0f) ? (1.0f / meshArea) : 0.0f;
+		for (int k = 0; k < 3; ++k)
+		{
+			meshCentroid[k] *= invMeshArea;
+		}
+
+		// view independent occlusion potential, clusters facing away from the mesh center are more likely to occlude
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			const float* centroid = &clusterData[(c * 7) + 0];
+			const float* normal = &clusterData[(c * 7) + 3];
+			const float area = clusterData[(c * 7) + 6];
+
+			const float normalLength = sqrtf((normal[0] * normal[0]) + (normal[1] * normal[1]) + (normal[2] * normal[2]));
+			if (area <= 0.0f || normalLength <= 0.0f)
+				continue;
+
+			float sortKey = 0.0f;
+			for (int k = 0; k < 3; ++k)
+			{
+				sortKey += ((centroid[k] / area) - meshCentroid[k]) * (normal[k] / normalLength);
+			}
+			clusters[c].SortKey = sortKey;
+		}
+
+		std::stable_sort(clusters.begin(), clusters.end(), [](const TriangleCluster& lhs, const TriangleCluster& rhs)
+		{
+			return lhs.SortKey > rhs.SortKey;
+		});
+
+		size_t outputIndex = 0;
+		for (const TriangleCluster& cluster : clusters)
+		{
+			const size_t clusterIndexCount = cluster.TriangleCount * 3;
+			memcpy(&outIndices[outputIndex], &indices[cluster.FirstTriangle * 3], clusterIndexCount * sizeof(uint32_t));
+			outputIndex += clusterIndexCount;
+		}
+	}
+
+	//////////////////////////////////////////////////////////////////////////
+	//                            Vertex Fetch                              //
+	//////////////////////////////////////////////////////////////////////////
+	size_t Geometry::OptimizeVertexFetch(void* outVertices, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexStride)
+	{
+		Debug_Assert(outVertices != vertices);
+
+		uint8_t* dst = static_cast<uint8_t*>(outVertices);
+		const uint8_t* src = static_cast<const uint8_t*>(vertices);
+
+		std::vector<uint32_t> remap(vertexCount, s_invalidIndex);
+		uint32_t nextVertex = 0;
+
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			const uint32_t index = indices[i];
+			Debug_Assert(index < vertexCount);
+
+			if (remap[index] == s_invalidIndex)
+			{
+				memcpy(dst + (nextVertex * vertexStride), src + (index * vertexStride), vertexStride);
+				remap[index] = nextVertex++;
+			}
+
+			indices[i] = remap[index];
+		}
+
+		return nextVertex;
+	}
+} // namespace W
\ No newline at end of file
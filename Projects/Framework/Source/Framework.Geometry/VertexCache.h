@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace W
+{
+	namespace Geometry
+	{
+		struct VertexCacheStatistics
+		{
+			uint32_t VerticesTransformed = 0;
+			float ACMR = 0.0f; // average cache miss ratio, transformed vertices per triangle
+			float ATVR = 0.0f; // average transformed vertex ratio, transformed vertices per referenced vertex
+		};
+
+		// Simulate a FIFO post-transform cache over a triangle list
+		VertexCacheStatistics AnalyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = 16);
+
+		// Reorder the triangles for post-transform cache locality (Tom Forsyth's linear-speed vertex cache optimization)
+		void OptimizeVertexCache(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+		// Reorder clusters of cache optimized triangles from the outside in, so likely occluders are drawn first (Sander et al. "Tipsy")
+		// vertexPositions points to the first position, each position is 3 floats and positions are vertexPositionsStride bytes apart
+		void OptimizeOverdraw(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const float* vertexPositions, size_t vertexCount, size_t vertexPositionsStride);
+
+		// Reorder the vertices in the order the triangles first reference them and rewrite the indices in place,
+		// returns the number of referenced vertices written to outVertices
+		size_t OptimizeVertexFetch(void* outVertices, uint32_t* indices, size_t indexCount, const void* vertices, size_t vertexCount, size_t vertexStride);
+	} // namespace Geometry
+} // namespace W
\ No newline at end of file
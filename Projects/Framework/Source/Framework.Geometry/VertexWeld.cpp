@@ -0,0 +1,151 @@
+#include "VertexWeld.h"
+#include <Framework.Debug/Debug.h>
+
+#include <math.h>
+#include <string.h>
+
+#include <vector>
+
+namespace W
+{
+	static const uint32_t s_invalidIndex = ~0u;
+
+	struct VertexKey
+	{
+		const uint8_t* Vertices;
+		size_t Stride;
+		size_t ComponentCount;
+		float InvEpsilon;
+
+		// Quantized (or bitwise) representation of a single component
+		uint64_t Component(uint32_t vertexIndex, size_t componentIndex) const
+		{
+			float value;
+			memcpy(&value, Vertices + (vertexIndex * Stride) + (componentIndex * sizeof(float)), sizeof(float));
+
+			if (InvEpsilon > 0.0f)
+			{
+				// far vertices overflow 32 bits with a small epsilon, the grid index is clamped in double
+				// before the cast, which is undefined out of range, NaN and infinities end up at the limits
+				const double limit = 9.0e18;
+				const double quantized = floor(static_cast<double>(value) * InvEpsilon + 0.5);
+				const double clamped = (quantized < limit) ? ((quantized > -limit) ? quantized : -limit) : limit;
+				return static_cast<uint64_t>(static_cast<int64_t>(clamped));
+			}
+
+			// +0.0f folds negative zero into positive zero
+			value += 0.0f;
+
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(uint32_t));
+			return bits;
+		}
+
+		uint32_t Hash(uint32_t vertexIndex) const
+		{
+			// MurmurHash2 mixing
+			const uint32_t m = 0x5bd1e995;
+			uint32_t hash = 0;
+
+			for (size_t i = 0; i < ComponentCount; ++i)
+			{
+				const uint64_t component = Component(vertexIndex, i);
+				const uint32_t words[2] = { static_cast<uint32_t>(component), static_cast<uint32_t>(component >> 32) };
+				for (uint32_t k : words)
+				{
+					k *= m;
+					k ^= k >> 24;
+					k *= m;
+					hash *= m;
+					hash ^= k;
+				}
+			}
+
+			hash ^= hash >> 13;
+			hash *= m;
+			hash ^= hash >> 15;
+			return hash;
+		}
+
+		bool Equal(uint32_t lhs, uint32_t rhs) const
+		{
+			for (size_t i = 0; i < ComponentCount; ++i)
+			{
+				if (Component(lhs, i) != Component(rhs, i))
+					return false;
+			}
+			return true;
+		}
+	};
+
+	size_t Geometry::GenerateVertexRemap(uint32_t* outRemap, const void* vertices, size_t vertexCount, size_t vertexStride, float epsilon)
+	{
+		Debug_Assert(vertexStride > 0 && (vertexStride % sizeof(float)) == 0);
+		Debug_Assert(epsilon >= 0.0f);
+
+		VertexKey key;
+		key.Vertices = static_cast<const uint8_t*>(vertices);
+		key.Stride = vertexStride;
+		key.ComponentCount = vertexStride / sizeof(float);
+		key.InvEpsilon = (epsilon > 0.0f) ? (1.0f / epsilon) : 0.0f;
+
+		// open addressing table with a load factor below 0.5
+		size_t bucketCount = 1;
+		while (bucketCount < vertexCount * 2)
+		{
+			bucketCount *= 2;
+		}
+
+		const size_t bucketMask = bucketCount - 1;
+		std::vector<uint32_t> buckets(bucketCount, s_invalidIndex);
+
+		uint32_t uniqueVertexCount = 0;
+		for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+		{
+			size_t bucket = key.Hash(vertexIndex) & bucketMask;
+			while (buckets[bucket] != s_invalidIndex && !key.Equal(buckets[bucket], vertexIndex))
+			{
+				bucket = (bucket + 1) & bucketMask;
+			}
+
+			if (buckets[bucket] == s_invalidIndex)
+			{
+				buckets[bucket] = vertexIndex;
+				outRemap[vertexIndex] = uniqueVertexCount++;
+			}
+			else
+			{
+				outRemap[vertexIndex] = outRemap[buckets[bucket]];
+			}
+		}
+
+		return uniqueVertexCount;
+	}
+
+	void Geometry::RemapVertexBuffer(void* outVertices, const void* vertices, size_t vertexCount, size_t vertexStride, const uint32_t* remap)
+	{
+		Debug_Assert(outVertices != vertices);
+
+		uint8_t* dst = static_cast<uint8_t*>(outVertices);
+		const uint8_t* src = static_cast<const uint8_t*>(vertices);
+
+		// unique vertices are numbered in order of first occurrence, so only the first occurrence is copied
+		uint32_t nextVertex = 0;
+		for (size_t i = 0; i < vertexCount; ++i)
+		{
+			if (remap[i] == nextVertex)
+			{
+				memcpy(dst + (remap[i] * vertexStride), src + (i * vertexStride), vertexStride);
+				++nextVertex;
+			}
+		}
+	}
+
+	void Geometry::RemapIndexBuffer(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const uint32_t* remap)
+	{
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			outIndices[i] = remap[indices[i]];
+		}
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace W
+{
+	namespace Geometry
+	{
+		// Vertices are treated as tightly packed 32-bit floats, so vertexStride must be a multiple of 4.
+		// An epsilon of zero welds bitwise equal vertices, otherwise each component is quantized to a grid of epsilon.
+
+		// Map every vertex to the first equal vertex, returns the number of unique vertices
+		size_t GenerateVertexRemap(uint32_t* outRemap, const void* vertices, size_t vertexCount, size_t vertexStride, float epsilon = 0.0f);
+
+		// Compact the vertex buffer using a remap table, outVertices must hold the unique vertex count
+		void RemapVertexBuffer(void* outVertices, const void* vertices, size_t vertexCount, size_t vertexStride, const uint32_t* remap);
+
+		// Rewrite the index buffer using a remap table, outIndices may be the same as indices
+		void RemapIndexBuffer(uint32_t* outIndices, const uint32_t* indices, size_t indexCount, const uint32_t* remap);
+	} // namespace Geometry
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace W
+{
+	namespace IO
+	{
+		// Create a single directory, succeeds when the directory already exists
+		bool MakeDirectory(const char* directoryPath);
+	} // namespace IO
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace W
+{
+	namespace IO
+	{
+		// Read-only view of a whole file mapped into the address space
+		class MappedFile
+		{
+		public:
+			MappedFile() = default;
+			~MappedFile();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			bool Open(const char* filePath);
+			void Close();
+
+			bool IsOpen() const { return mData != nullptr; }
+			const void* Data() const { return mData; }
+			size_t Size() const { return mSize; }
+
+		private:
+			const void* mData = nullptr;
+			size_t mSize = 0;
+
+			void* mFileHandle = nullptr;
+			void* mMappingHandle = nullptr;
+		};
+	} // namespace IO
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,14 @@
+#include "..\FileSystem.h"
+
+#include <Windows.h>
+
+namespace W
+{
+	bool IO::MakeDirectory(const char* directoryPath)
+	{
+		if (CreateDirectoryA(directoryPath, nullptr) != FALSE)
+			return true;
+
+		return GetLastError() == ERROR_ALREADY_EXISTS;
+	}
+} // namespace W
\ No newline at end of file
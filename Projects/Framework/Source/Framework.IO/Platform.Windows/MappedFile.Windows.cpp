@@ -0,0 +1,65 @@
+#include "..\MappedFile.h"
+#include <Framework.Debug/Debug.h>
+
+#include <Windows.h>
+
+namespace W
+{
+	IO::MappedFile::~MappedFile()
+	{
+		Close();
+	}
+
+	bool IO::MappedFile::Open(const char* filePath)
+	{
+		Debug_Assert(IsOpen() == false);
+
+		HANDLE fileHandle = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(fileHandle, &fileSize) == FALSE || fileSize.QuadPart == 0)
+		{
+			// empty files can not be mapped
+			CloseHandle(fileHandle);
+			return false;
+		}
+
+		HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mappingHandle == nullptr)
+		{
+			CloseHandle(fileHandle);
+			return false;
+		}
+
+		const void* data = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+		if (data == nullptr)
+		{
+			CloseHandle(mappingHandle);
+			CloseHandle(fileHandle);
+			return false;
+		}
+
+		mData = data;
+		mSize = static_cast<size_t>(fileSize.QuadPart);
+		mFileHandle = fileHandle;
+		mMappingHandle = mappingHandle;
+		return true;
+	}
+
+	void IO::MappedFile::Close()
+	{
+		if (mData != nullptr)
+		{
+			UnmapViewOfFile(mData);
+			CloseHandle(mMappingHandle);
+			CloseHandle(mFileHandle);
+		}
+
+		mData = nullptr;
+		mSize = 0;
+		mFileHandle = nullptr;
+		mMappingHandle = nullptr;
+	}
+} // namespace W
\ No newline at end of file
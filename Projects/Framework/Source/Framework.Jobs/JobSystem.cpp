@@ -0,0 +1,308 @@
+#include "JobSystem.h"
+#include <Framework.Debug/Debug.h>
+
+namespace W
+{
+	static const size_t s_queueCapacity = 4096;
+	static const int s_spinCount = 64;
+
+	struct Job
+	{
+		JobSystem::JobFunction Function;
+		JobCounter* Counter;
+	};
+
+	// The job system and queue of the current thread
+	struct ThreadContext
+	{
+		const JobSystem* System;
+		uint32_t Index;
+	};
+
+	static thread_local ThreadContext s_threadContext = { nullptr, 0 };
+
+	JobSystem::JobSystem(uint32_t workerCount)
+		: mQueuedJobCount(0)
+		, mSleepingCount(0)
+		, mStop(false)
+	{
+		if (workerCount == 0)
+		{
+			const uint32_t hardwareThreadCount = std::thread::hardware_concurrency();
+			workerCount = (hardwareThreadCount > 1) ? (hardwareThreadCount - 1) : 1;
+		}
+
+		Debug_AssertMsg(s_threadContext.System == nullptr, "the thread already owns a job system");
+		s_threadContext.System = this;
+		s_threadContext.Index = 0;
+
+		for (uint32_t i = 0; i <= workerCount; ++i)
+		{
+			mQueues.push_back(std::make_unique<ThreadQueue>(s_queueCapacity));
+		}
+
+		for (uint32_t i = 1; i <= workerCount; ++i)
+		{
+			mWorkers.emplace_back(&JobSystem::WorkerMain, this, i);
+		}
+	}
+
+	JobSystem::~JobSystem()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mStop = true;
+		}
+		mSleepCondition.notify_all();
+
+		for (std::thread& worker : mWorkers)
+		{
+			worker.join();
+		}
+
+		Debug_AssertMsg(mQueuedJobCount == 0, "job system destroyed with queued jobs");
+		s_threadContext.System = nullptr;
+	}
+
+	void JobSystem::Run(JobFunction function, JobCounter* counter)
+	{
+		if (counter != nullptr)
+		{
+			counter->mValue.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Job* job = new Job{ std::move(function), counter };
+		Submit(job);
+	}
+
+	void JobSystem::RunAfter(JobCounter& dependency, JobFunction function, JobCounter* counter)
+	{
+		if (counter != nullptr)
+		{
+			counter->mValue.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		Job* job = new Job{ std::move(function), counter };
+
+		// Finish takes the continuation list under the same lock once the counter reaches zero,
+		// a counter that is already done runs the job right away
+		{
+			std::lock_guard<std::mutex> lock(dependency.mContinuationMutex);
+			if (dependency.IsDone() == false)
+			{
+				dependency.mContinuations.push_back(job);
+				return;
+			}
+		}
+
+		Submit(job);
+	}
+
+	void JobSystem::Wait(const JobCounter& counter)
+	{
+		const int threadIndex = GetThreadIndex();
+
+		int idleCount = 0;
+		while (counter.IsDone() == false)
+		{
+			if (threadIndex >= 0 && TryRunJob(static_cast<uint32_t>(threadIndex)))
+			{
+				idleCount = 0;
+			}
+			else if (++idleCount > s_spinCount)
+			{
+				std::this_thread::yield();
+			}
+		}
+
+		// the job that finished the counter released it
+		std::lock_guard<std::mutex> lock(counter.mContinuationMutex);
+	}
+
+	void JobSystem::ParallelFor(size_t count, size_t grainSize, const RangeFunction& function)
+	{
+		if (count == 0)
+			return;
+
+		if (grainSize == 0)
+		{
+			grainSize = 1;
+		}
+
+		// the calling thread processes the whole range, except the parts other threads split off
+		JobCounter counter;
+		ParallelForRange(0, count, grainSize, function, counter);
+		Wait(counter);
+	}
+
+	void JobSystem::ParallelForRange(size_t begin, size_t end, size_t grainSize, const RangeFunction& function, JobCounter& counter)
+	{
+		// Lazy binary splitting: hand half of the remaining range to the other threads while the local queue
+		// is empty (they are likely hungry), otherwise keep processing grain sized chunks locally
+		while (end - begin > grainSize)
+		{
+			if (IsLocalQueueEmpty())
+			{
+				const size_t middle = begin + ((end - begin) / 2);
+				Run([this, middle, end, grainSize, &function, &counter]()
+				{
+					ParallelForRange(middle, end, grainSize, function, counter);
+				}, &counter);
+				end = middle;
+			}
+			else
+			{
+				function(begin, begin + grainSize);
+				begin += grainSize;
+			}
+		}
+
+		function(begin, end);
+	}
+
+	void JobSystem::Submit(Job* job)
+	{
+		mQueuedJobCount.fetch_add(1, std::memory_order_seq_cst);
+
+		const int threadIndex = GetThreadIndex();
+		if (threadIndex >= 0)
+		{
+			if (mQueues[threadIndex]->Deque.Push(job) == false)
+			{
+				// the local queue is full, run the job right away
+				mQueuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+				Execute(job);
+				return;
+			}
+		}
+		else
+		{
+			std::lock_guard<std::mutex> lock(mSharedMutex);
+			mSharedQueue.push_back(job);
+		}
+
+		if (mSleepingCount.load(std::memory_order_seq_cst) > 0)
+		{
+			std::lock_guard<std::mutex> lock(mSleepMutex);
+			mSleepCondition.notify_one();
+		}
+	}
+
+	void JobSystem::Execute(Job* job)
+	{
+		job->Function();
+
+		JobCounter* counter = job->Counter;
+		delete job;
+
+		Finish(counter);
+	}
+
+	void JobSystem::Finish(JobCounter* counter)
+	{
+		if (counter == nullptr)
+			return;
+
+		int value = counter->mValue.load(std::memory_order_relaxed);
+		while (value > 1)
+		{
+			if (counter->mValue.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+				return;
+		}
+
+		// Likely the last job, the counter may be destroyed by its waiter as soon as it reaches zero
+		// so it only reaches zero under the lock and Wait takes the lock before returning
+		std::vector<Job*> continuations;
+		{
+			std::lock_guard<std::mutex> lock(counter->mContinuationMutex);
+			if (counter->mValue.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			{
+				continuations.swap(counter->mContinuations);
+			}
+		}
+
+		for (Job* continuation : continuations)
+		{
+			Submit(continuation);
+		}
+	}
+
+	bool JobSystem::TryRunJob(uint32_t threadIndex)
+	{
+		Job* job = FindJob(threadIndex);
+		if (job == nullptr)
+			return false;
+
+		mQueuedJobCount.fetch_sub(1, std::memory_order_relaxed);
+		Execute(job);
+		return true;
+	}
+
+	Job* JobSystem::FindJob(uint32_t threadIndex)
+	{
+		Job* job = nullptr;
+		if (mQueues[threadIndex]->Deque.Pop(job))
+			return job;
+
+		// steal from the other threads, starting after our own queue to spread the thieves
+		const uint32_t queueCount = static_cast<uint32_t>(mQueues.size());
+		for (uint32_t i = 1; i < queueCount; ++i)
+		{
+			if (mQueues[(threadIndex + i) % queueCount]->Deque.Steal(job))
+				return job;
+		}
+
+		std::lock_guard<std::mutex> lock(mSharedMutex);
+		if (mSharedQueue.empty())
+			return nullptr;
+
+		job = mSharedQueue.front();
+		mSharedQueue.pop_front();
+		return job;
+	}
+
+	int JobSystem::GetThreadIndex() const
+	{
+		return (s_threadContext.System == this) ? static_cast<int>(s_threadContext.Index) : -1;
+	}
+
+	bool JobSystem::IsLocalQueueEmpty() const
+	{
+		const int threadIndex = GetThreadIndex();
+		return (threadIndex < 0) || mQueues[threadIndex]->Deque.IsEmpty();
+	}
+
+	void JobSystem::WorkerMain(uint32_t threadIndex)
+	{
+		s_threadContext.System = this;
+		s_threadContext.Index = threadIndex;
+
+		int idleCount = 0;
+		while (mStop.load(std::memory_order_relaxed) == false)
+		{
+			if (TryRunJob(threadIndex))
+			{
+				idleCount = 0;
+				continue;
+			}
+
+			if (++idleCount < s_spinCount)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			// Nothing to run, sleep until a job is queued
+			std::unique_lock<std::mutex> lock(mSleepMutex);
+			mSleepingCount.fetch_add(1, std::memory_order_seq_cst);
+			mSleepCondition.wait(lock, [this]()
+			{
+				return mStop.load(std::memory_order_relaxed) || mQueuedJobCount.load(std::memory_order_seq_cst) > 0;
+			});
+			mSleepingCount.fetch_sub(1, std::memory_order_relaxed);
+			idleCount = 0;
+		}
+
+		s_threadContext.System = nullptr;
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <Framework.Jobs/WorkStealingDeque.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace W
+{
+	struct Job;
+	class JobSystem;
+
+	// Number of unfinished jobs, a job system can wait on it or start jobs when it reaches zero
+	// A counter must not be destroyed before a JobSystem::Wait on it returned
+	class JobCounter
+	{
+	public:
+		JobCounter() : mValue(0) {}
+
+		JobCounter(const JobCounter&) = delete;
+		JobCounter& operator=(const JobCounter&) = delete;
+
+		bool IsDone() const { return mValue.load(std::memory_order_acquire) == 0; }
+
+	private:
+		friend class JobSystem;
+
+		std::atomic<int> mValue;
+
+		// jobs waiting for the counter to reach zero
+		mutable std::mutex mContinuationMutex;
+		std::vector<Job*> mContinuations;
+	};
+
+	// Work-stealing job system
+	// Every worker thread and the thread that created the job system own a deque, they pop their own jobs
+	// and steal from the others when it is empty. Other threads submit through a shared queue.
+	class JobSystem
+	{
+	public:
+		using JobFunction = std::function<void()>;
+		using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+		// workerCount 0 uses one worker per hardware thread besides the calling thread
+		explicit JobSystem(uint32_t workerCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		uint32_t GetWorkerCount() const { return static_cast<uint32_t>(mWorkers.size()); }
+
+		// Queue a job, counter (optional) is incremented now and decremented when the job is done
+		void Run(JobFunction function, JobCounter* counter = nullptr);
+
+		// Queue a job once dependency reaches zero, it is queued now when dependency is already zero
+		// the jobs counted by dependency must be queued first, a job added to it afterwards is not waited for
+		void RunAfter(JobCounter& dependency, JobFunction function, JobCounter* counter = nullptr);
+
+		// Run other jobs on the calling thread until the counter reaches zero
+		void Wait(const JobCounter& counter);
+
+		// Call function on sub-ranges of [0, count) in parallel and wait for all of them
+		// Ranges are split lazily while other threads are hungry, but never below grainSize items
+		void ParallelFor(size_t count, size_t grainSize, const RangeFunction& function);
+
+	private:
+		struct ThreadQueue
+		{
+			explicit ThreadQueue(size_t capacity) : Deque(capacity) {}
+			WorkStealingDeque<Job*> Deque;
+		};
+
+		void Submit(Job* job);
+		void Execute(Job* job);
+		void Finish(JobCounter* counter);
+		bool TryRunJob(uint32_t threadIndex);
+		Job* FindJob(uint32_t threadIndex);
+		int GetThreadIndex() const;
+		bool IsLocalQueueEmpty() const;
+
+		void WorkerMain(uint32_t threadIndex);
+		void ParallelForRange(size_t begin, size_t end, size_t grainSize, const RangeFunction& function, JobCounter& counter);
+
+		// index 0 is the thread that created the job system, workers are 1..N
+		std::vector<std::unique_ptr<ThreadQueue>> mQueues;
+		std::vector<std::thread> mWorkers;
+
+		// jobs submitted from threads the job system does not know
+		std::mutex mSharedMutex;
+		std::deque<Job*> mSharedQueue;
+
+		// idle workers sleep until jobs are queued
+		std::mutex mSleepMutex;
+		std::condition_variable mSleepCondition;
+		std::atomic<int> mQueuedJobCount;
+		std::atomic<int> mSleepingCount;
+		std::atomic<bool> mStop;
+	};
+} // namespace W
\ No newline at end of file
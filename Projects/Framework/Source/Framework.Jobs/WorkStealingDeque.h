@@ -0,0 +1,101 @@
+#pragma once
+
+#include <Framework.Debug/Debug.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+
+namespace W
+{
+	// Fixed capacity Chase-Lev deque (Le et al. "Correct and Efficient Work-Stealing for Weak Memory Models")
+	// The owner thread pushes and pops at the bottom, any other thread steals from the top
+	// T must be trivially copyable, usually a pointer
+	template <typename T>
+	class WorkStealingDeque
+	{
+	public:
+		explicit WorkStealingDeque(size_t capacity)
+			: mTop(0)
+			, mBottom(0)
+			, mItems(new std::atomic<T>[capacity])
+			, mMask(static_cast<int64_t>(capacity) - 1)
+		{
+			Debug_AssertMsg(capacity > 0 && (capacity & (capacity - 1)) == 0, "capacity must be a power of two");
+		}
+
+		WorkStealingDeque(const WorkStealingDeque&) = delete;
+		WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+		// Owner only, fails when the deque is full
+		bool Push(T item)
+		{
+			const int64_t bottom = mBottom.load(std::memory_order_relaxed);
+			const int64_t top = mTop.load(std::memory_order_acquire);
+			if (bottom - top > mMask)
+				return false;
+
+			mItems[bottom & mMask].store(item, std::memory_order_relaxed);
+			mBottom.store(bottom + 1, std::memory_order_release);
+			return true;
+		}
+
+		// Owner only, takes the most recently pushed item
+		bool Pop(T& outItem)
+		{
+			const int64_t bottom = mBottom.load(std::memory_order_relaxed) - 1;
+			mBottom.store(bottom, std::memory_order_seq_cst);
+			int64_t top = mTop.load(std::memory_order_seq_cst);
+
+			if (top > bottom)
+			{
+				// empty
+				mBottom.store(bottom + 1, std::memory_order_relaxed);
+				return false;
+			}
+
+			T item = mItems[bottom & mMask].load(std::memory_order_relaxed);
+			if (top == bottom)
+			{
+				// last item, race the thieves for it
+				const bool won = mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+				mBottom.store(bottom + 1, std::memory_order_relaxed);
+				if (won == false)
+					return false;
+			}
+
+			outItem = item;
+			return true;
+		}
+
+		// Any thread, takes the oldest item
+		bool Steal(T& outItem)
+		{
+			int64_t top = mTop.load(std::memory_order_seq_cst);
+			const int64_t bottom = mBottom.load(std::memory_order_seq_cst);
+			if (top >= bottom)
+				return false;
+
+			T item = mItems[top & mMask].load(std::memory_order_relaxed);
+			if (mTop.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed) == false)
+				return false;
+
+			outItem = item;
+			return true;
+		}
+
+		// Approximate when called from a thief
+		bool IsEmpty() const
+		{
+			return mBottom.load(std::memory_order_relaxed) <= mTop.load(std::memory_order_relaxed);
+		}
+
+	private:
+		std::atomic<int64_t> mTop;
+		std::atomic<int64_t> mBottom;
+		std::unique_ptr<std::atomic<T>[]> mItems;
+		const int64_t mMask;
+	};
+} // namespace W
\ No newline at end of file
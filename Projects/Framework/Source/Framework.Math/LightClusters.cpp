@@ -0,0 +1,178 @@
+#include "LightClusters.h"
+#include <Framework.Debug/Debug.h>
+
+#include <emmintrin.h>
+#include <math.h>
+#include <vector>
+
+namespace W
+{
+	// Inclusive cluster ranges covered by a visible light
+	struct LightBounds
+	{
+		uint32_t Light;
+		uint16_t MinX, MaxX;
+		uint16_t MinY, MaxY;
+		uint16_t MinZ, MaxZ;
+	};
+
+	// Screen tiles covered by the box around a sphere between the depths minDepth and maxDepth
+	// lo and hi are the sphere extents on the axis, the box projects smallest at the far depth when positive
+	static inline void ComputeTileRange(__m128 lo, __m128 hi, __m128 minDepth, __m128 maxDepth, __m128 scale, __m128 bias, __m128 maxTile, __m128& inOutVisible, __m128i& outMin, __m128i& outMax)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 loPositive = _mm_cmpge_ps(lo, zero);
+		const __m128 hiPositive = _mm_cmpge_ps(hi, zero);
+		const __m128 loDepth = _mm_or_ps(_mm_and_ps(loPositive, maxDepth), _mm_andnot_ps(loPositive, minDepth));
+		const __m128 hiDepth = _mm_or_ps(_mm_and_ps(hiPositive, minDepth), _mm_andnot_ps(hiPositive, maxDepth));
+
+		const __m128 t0 = _mm_add_ps(_mm_mul_ps(_mm_div_ps(lo, loDepth), scale), bias);
+		const __m128 t1 = _mm_add_ps(_mm_mul_ps(_mm_div_ps(hi, hiDepth), scale), bias);
+		const __m128 tileMin = _mm_min_ps(t0, t1);
+		const __m128 tileMax = _mm_max_ps(t0, t1);
+
+		inOutVisible = _mm_and_ps(inOutVisible, _mm_and_ps(_mm_cmpge_ps(tileMax, zero), _mm_cmplt_ps(tileMin, _mm_add_ps(maxTile, _mm_set1_ps(1.0f)))));
+
+		// clamped to the grid the truncation is the floor
+		outMin = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(tileMin, zero), maxTile));
+		outMax = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(tileMax, zero), maxTile));
+	}
+
+	size_t Math::BinLights(uint32_t* outClusters, uint32_t* outIndices, size_t maxIndices, const ClusterGrid& grid, const LightSphere* lights, size_t lightCount)
+	{
+		Debug_AssertMsg(grid.NearZ > 0.0f && grid.FarZ > grid.NearZ, "invalid cluster depth range");
+		Debug_AssertMsg(grid.CountX <= 0xFFFF && grid.CountY <= 0xFFFF && grid.CountZ <= 0xFFFF, "too many clusters");
+
+		const uint32_t clusterCount = grid.GetClusterCount();
+
+		// screen tile t = (p / depth * projection * 0.5 + 0.5) * count
+		const __m128 scaleX = _mm_set1_ps(grid.ProjectionX * 0.5f * grid.CountX);
+		const __m128 scaleY = _mm_set1_ps(grid.ProjectionY * 0.5f * grid.CountY);
+		const __m128 biasX = _mm_set1_ps(0.5f * grid.CountX);
+		const __m128 biasY = _mm_set1_ps(0.5f * grid.CountY);
+		const __m128 maxTileX = _mm_set1_ps(static_cast<float>(grid.CountX - 1));
+		const __m128 maxTileY = _mm_set1_ps(static_cast<float>(grid.CountY - 1));
+		const __m128 nearZ = _mm_set1_ps(grid.NearZ);
+		const __m128 farZ = _mm_set1_ps(grid.FarZ);
+
+		// depth slice s = log(depth / near) * count / log(far / near)
+		const float sliceScale = grid.CountZ / logf(grid.FarZ / grid.NearZ);
+		const float sliceBias = -logf(grid.NearZ) * sliceScale;
+		const float maxSlice = static_cast<float>(grid.CountZ - 1);
+
+		std::vector<LightBounds> lightBounds;
+		lightBounds.reserve(lightCount);
+
+		// four lights at a time, the last group is padded with lights behind the camera
+		for (size_t first = 0; first < lightCount; first += 4)
+		{
+			LightSphere group[4] = {};
+			for (size_t i = 0; i < 4; ++i)
+			{
+				if (first + i < lightCount)
+				{
+					group[i] = lights[first + i];
+				}
+				else
+				{
+					group[i].Center[2] = 1.0f;
+				}
+			}
+
+			__m128 x = _mm_load_ps(group[0].Center);
+			__m128 y = _mm_load_ps(group[1].Center);
+			__m128 z = _mm_load_ps(group[2].Center);
+			__m128 radius = _mm_load_ps(group[3].Center);
+			_MM_TRANSPOSE4_PS(x, y, z, radius);
+
+			const __m128 depth = _mm_sub_ps(_mm_setzero_ps(), z);
+			const __m128 depthMin = _mm_sub_ps(depth, radius);
+			const __m128 depthMax = _mm_add_ps(depth, radius);
+			__m128 visible = _mm_and_ps(_mm_cmpgt_ps(depthMax, nearZ), _mm_cmplt_ps(depthMin, farZ));
+
+			const __m128 minDepth = _mm_max_ps(depthMin, nearZ);
+			const __m128 maxDepth = _mm_max_ps(_mm_min_ps(depthMax, farZ), minDepth);
+
+			__m128i minX, maxX, minY, maxY;
+			ComputeTileRange(_mm_sub_ps(x, radius), _mm_add_ps(x, radius), minDepth, maxDepth, scaleX, biasX, maxTileX, visible, minX, maxX);
+			ComputeTileRange(_mm_sub_ps(y, radius), _mm_add_ps(y, radius), minDepth, maxDepth, scaleY, biasY, maxTileY, visible, minY, maxY);
+
+			const int visibleMask = _mm_movemask_ps(visible);
+			if (visibleMask == 0)
+				continue;
+
+			alignas(16) int32_t tiles[4][4];
+			alignas(16) float depths[2][4];
+			_mm_store_si128(reinterpret_cast<__m128i*>(tiles[0]), minX);
+			_mm_store_si128(reinterpret_cast<__m128i*>(tiles[1]), maxX);
+			_mm_store_si128(reinterpret_cast<__m128i*>(tiles[2]), minY);
+			_mm_store_si128(reinterpret_cast<__m128i*>(tiles[3]), maxY);
+			_mm_store_ps(depths[0], minDepth);
+			_mm_store_ps(depths[1], maxDepth);
+
+			for (int i = 0; i < 4; ++i)
+			{
+				if ((visibleMask & (1 << i)) == 0)
+					continue;
+
+				const float sliceMin = fminf(fmaxf(logf(depths[0][i]) * sliceScale + sliceBias, 0.0f), maxSlice);
+				const float sliceMax = fminf(fmaxf(logf(depths[1][i]) * sliceScale + sliceBias, 0.0f), maxSlice);
+
+				LightBounds bounds;
+				bounds.Light = static_cast<uint32_t>(first + i);
+				bounds.MinX = static_cast<uint16_t>(tiles[0][i]);
+				bounds.MaxX = static_cast<uint16_t>(tiles[1][i]);
+				bounds.MinY = static_cast<uint16_t>(tiles[2][i]);
+				bounds.MaxY = static_cast<uint16_t>(tiles[3][i]);
+				bounds.MinZ = static_cast<uint16_t>(sliceMin);
+				bounds.MaxZ = static_cast<uint16_t>(sliceMax);
+				lightBounds.push_back(bounds);
+			}
+		}
+
+		// count the lights of every cluster, then lay the clusters out one after the other
+		for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+		{
+			outClusters[cluster * 2 + 1] = 0;
+		}
+
+		for (const LightBounds& bounds : lightBounds)
+		{
+			for (uint32_t z = bounds.MinZ; z <= bounds.MaxZ; ++z)
+				for (uint32_t y = bounds.MinY; y <= bounds.MaxY; ++y)
+					for (uint32_t x = bounds.MinX; x <= bounds.MaxX; ++x)
+						outClusters[(x + grid.CountX * (y + grid.CountY * z)) * 2 + 1] += 1;
+		}
+
+		size_t indexCount = 0;
+		for (uint32_t cluster = 0; cluster < clusterCount; ++cluster)
+		{
+			outClusters[cluster * 2] = static_cast<uint32_t>(indexCount);
+			indexCount += outClusters[cluster * 2 + 1];
+			outClusters[cluster * 2 + 1] = 0;
+		}
+
+		// the counts are rebuilt while filling, clusters past maxIndices keep what fits
+		for (const LightBounds& bounds : lightBounds)
+		{
+			for (uint32_t z = bounds.MinZ; z <= bounds.MaxZ; ++z)
+			{
+				for (uint32_t y = bounds.MinY; y <= bounds.MaxY; ++y)
+				{
+					for (uint32_t x = bounds.MinX; x <= bounds.MaxX; ++x)
+					{
+						uint32_t* cluster = &outClusters[(x + grid.CountX * (y + grid.CountY * z)) * 2];
+						const size_t index = static_cast<size_t>(cluster[0]) + cluster[1];
+						if (index < maxIndices)
+						{
+							outIndices[index] = bounds.Light;
+							cluster[1] += 1;
+						}
+					}
+				}
+			}
+		}
+
+		return indexCount;
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace W
+{
+	namespace Math
+	{
+		// Froxels of a symmetric perspective frustum looking down -Z, tiles split the screen evenly
+		// and slices split the view depth exponentially between NearZ and FarZ
+		struct ClusterGrid
+		{
+			uint32_t CountX = 16;
+			uint32_t CountY = 9;
+			uint32_t CountZ = 24;
+			float NearZ = 0.1f;
+			float FarZ = 1000.0f;
+			float ProjectionX = 1.0f; // [0][0] and [1][1] of the projection matrix, negative when the axis is flipped
+			float ProjectionY = 1.0f;
+
+			uint32_t GetClusterCount() const { return CountX * CountY * CountZ; }
+		};
+
+		// Sphere of influence of a light in view space
+		struct alignas(16) LightSphere
+		{
+			float Center[3];
+			float Radius;
+		};
+
+		// Bins the lights into the clusters their bounding spheres overlap, lightCount can be in the thousands
+		// outClusters receives (offset in outIndices, light count) of every cluster, x first then y then z,
+		// the indices of a cluster are in increasing light order and the ones past maxIndices are dropped
+		// returns the number of indices the lights needed, more than maxIndices when some were dropped
+		size_t BinLights(uint32_t* outClusters, uint32_t* outIndices, size_t maxIndices, const ClusterGrid& grid, const LightSphere* lights, size_t lightCount);
+	} // namespace Math
+} // namespace W
\ No newline at end of file
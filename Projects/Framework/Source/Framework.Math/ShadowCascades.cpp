@@ -0,0 +1,98 @@
+#include "ShadowCascades.h"
+#include <Framework.Debug/Debug.h>
+
+#include <math.h>
+
+namespace W
+{
+	static inline float Dot(const float a[3], const float b[3])
+	{
+		return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+	}
+
+	static inline void Cross(float out[3], const float a[3], const float b[3])
+	{
+		out[0] = a[1] * b[2] - a[2] * b[1];
+		out[1] = a[2] * b[0] - a[0] * b[2];
+		out[2] = a[0] * b[1] - a[1] * b[0];
+	}
+
+	void Math::ComputeCascadeSplits(float* outSplits, uint32_t cascadeCount, float nearZ, float farZ, float logWeight)
+	{
+		Debug_AssertMsg(nearZ > 0.0f && farZ > nearZ, "invalid cascade depth range");
+
+		for (uint32_t i = 1; i < cascadeCount; ++i)
+		{
+			const float t = static_cast<float>(i) / cascadeCount;
+			const float logSplit = nearZ * powf(farZ / nearZ, t);
+			const float uniformSplit = nearZ + (farZ - nearZ) * t;
+			outSplits[i - 1] = logWeight * logSplit + (1.0f - logWeight) * uniformSplit;
+		}
+		outSplits[cascadeCount - 1] = farZ;
+	}
+
+	void Math::FitCascade(Matrix4& outViewProjection, const CascadeCamera& camera, float splitNear, float splitFar, const float lightDirection[3], const CascadeSettings& settings)
+	{
+		Debug_AssertMsg(splitNear >= 0.0f && splitFar > splitNear, "invalid cascade slice");
+		Debug_AssertMsg(settings.SnapTexels * 2 < settings.Resolution, "the snap steps leave no room for the slice");
+
+		// smallest sphere through the corners of the slice, on the view axis where the near and far corners are equally
+		// far, or at the far plane when the slice is wide, it only depends on the split distances and the field of view
+		const float slope = camera.TanHalfFovX * camera.TanHalfFovX + camera.TanHalfFovY * camera.TanHalfFovY;
+		float centerDistance = 0.5f * (splitNear + splitFar) * (1.0f + slope);
+		if (centerDistance > splitFar)
+		{
+			centerDistance = splitFar;
+		}
+		const float farOffset = splitFar - centerDistance;
+		const float sliceRadius = sqrtf(farOffset * farOffset + splitFar * splitFar * slope);
+
+		// grown so the slice stays in the tile wherever its center is within half a step of the snapped one
+		const float snapRatio = static_cast<float>(settings.SnapTexels) / settings.Resolution;
+		const float radius = sliceRadius / (1.0f - snapRatio);
+		const float step = 2.0f * radius * snapRatio;
+
+		// light space axes, only depend on the light direction
+		float up[3] = { 0.0f, 0.0f, 1.0f };
+		if (fabsf(lightDirection[2]) > 0.99f)
+		{
+			up[0] = 1.0f;
+			up[2] = 0.0f;
+		}
+
+		float axisX[3];
+		Cross(axisX, up, lightDirection);
+		const float length = sqrtf(Dot(axisX, axisX));
+		axisX[0] /= length;
+		axisX[1] /= length;
+		axisX[2] /= length;
+
+		float axisY[3];
+		Cross(axisY, lightDirection, axisX);
+
+		float center[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			center[i] = camera.Position[i] + camera.Forward[i] * centerDistance;
+		}
+
+		const float centerX = floorf(Dot(center, axisX) / step + 0.5f) * step;
+		const float centerY = floorf(Dot(center, axisY) / step + 0.5f) * step;
+		const float centerZ = floorf(Dot(center, lightDirection) / step + 0.5f) * step;
+
+		const float depthMin = centerZ - radius - settings.CasterDistance;
+		const float depthRange = 2.0f * radius + settings.CasterDistance;
+
+		for (int i = 0; i < 3; ++i)
+		{
+			outViewProjection.Columns[i][0] = axisX[i] / radius;
+			outViewProjection.Columns[i][1] = axisY[i] / radius;
+			outViewProjection.Columns[i][2] = lightDirection[i] / depthRange;
+			outViewProjection.Columns[i][3] = 0.0f;
+		}
+		outViewProjection.Columns[3][0] = -centerX / radius;
+		outViewProjection.Columns[3][1] = -centerY / radius;
+		outViewProjection.Columns[3][2] = -depthMin / depthRange;
+		outViewProjection.Columns[3][3] = 1.0f;
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <Framework.Math/Transform.h>
+
+#include <stdint.h>
+
+namespace W
+{
+	namespace Math
+	{
+		// Symmetric perspective camera the cascades are fitted to, Forward is a unit vector
+		struct CascadeCamera
+		{
+			float Position[3];
+			float Forward[3];
+			float TanHalfFovX;
+			float TanHalfFovY;
+		};
+
+		// Shadow map tile of a cascade and how far it reaches toward the light for the casters outside the view
+		struct CascadeSettings
+		{
+			uint32_t Resolution = 2048;
+			uint32_t SnapTexels = 16; // the cascade moves in steps of this many texels, it is only re-rendered when it does
+			float CasterDistance = 100.0f;
+		};
+
+		// Far distance of each cascade, blending the logarithmic and the uniform splits of [nearZ, farZ] by logWeight
+		void ComputeCascadeSplits(float* outSplits, uint32_t cascadeCount, float nearZ, float farZ, float logWeight);
+
+		// Orthographic view projection of a directional light covering the camera frustum between splitNear and splitFar
+		// the frustum slice is bounded by a sphere whose radius does not change with the camera rotation, its center is
+		// snapped to whole texel steps of the light space, so the matrix only changes when the cascade moves by SnapTexels
+		// x and y are mapped to [-1, 1] and the depth to [0, 1], lightDirection is the unit direction the light travels
+		void FitCascade(Matrix4& outViewProjection, const CascadeCamera& camera, float splitNear, float splitFar, const float lightDirection[3], const CascadeSettings& settings);
+	} // namespace Math
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "Transform.h"
+#include <Framework.Debug/Debug.h>
+
+#include <emmintrin.h>
+#include <stdint.h>
+
+namespace W
+{
+	static inline __m128 Cross3(__m128 a, __m128 b)
+	{
+		// a.yzx * b.zxy - a.zxy * b.yzx, w is a.w * b.w - a.w * b.w = 0
+		const __m128 aYZX = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 bYZX = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+		const __m128 c = _mm_sub_ps(_mm_mul_ps(a, bYZX), _mm_mul_ps(aYZX, b));
+		return _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 2, 1));
+	}
+
+	static inline __m128 Dot4(__m128 a, __m128 b)
+	{
+		__m128 product = _mm_mul_ps(a, b);
+		product = _mm_add_ps(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(2, 3, 0, 1)));
+		return _mm_add_ps(product, _mm_shuffle_ps(product, product, _MM_SHUFFLE(1, 0, 3, 2)));
+	}
+
+	void Math::ComputeObjectTransforms(void* outTransforms, size_t outStride, const Matrix4* models, size_t count, const Matrix4& viewProjection)
+	{
+		Debug_AssertMsg(outStride >= sizeof(ObjectTransform) && (outStride % 16) == 0, "invalid object transform stride");
+		Debug_AssertMsg((reinterpret_cast<uintptr_t>(outTransforms) % 16) == 0, "object transforms must be 16 bytes aligned");
+
+		const __m128 vp0 = _mm_load_ps(viewProjection.Columns[0]);
+		const __m128 vp1 = _mm_load_ps(viewProjection.Columns[1]);
+		const __m128 vp2 = _mm_load_ps(viewProjection.Columns[2]);
+		const __m128 vp3 = _mm_load_ps(viewProjection.Columns[3]);
+
+		uint8_t* output = static_cast<uint8_t*>(outTransforms);
+		for (size_t i = 0; i < count; ++i, output += outStride)
+		{
+			ObjectTransform* transform = reinterpret_cast<ObjectTransform*>(output);
+
+			const __m128 m0 = _mm_load_ps(models[i].Columns[0]);
+			const __m128 m1 = _mm_load_ps(models[i].Columns[1]);
+			const __m128 m2 = _mm_load_ps(models[i].Columns[2]);
+			const __m128 m3 = _mm_load_ps(models[i].Columns[3]);
+
+			// the output is usually mapped write combined memory, only stores touch it
+			_mm_stream_ps(transform->Model.Columns[0], m0);
+			_mm_stream_ps(transform->Model.Columns[1], m1);
+			_mm_stream_ps(transform->Model.Columns[2], m2);
+			_mm_stream_ps(transform->Model.Columns[3], m3);
+
+			// inverse transpose of the 3x3 with columns a, b, c is (b x c, c x a, a x b) / det, the w of the model columns does not contribute
+			const __m128 mask = _mm_castsi128_ps(_mm_set_epi32(0, -1, -1, -1));
+			const __m128 a = _mm_and_ps(m0, mask);
+			const __m128 b = _mm_and_ps(m1, mask);
+			const __m128 c = _mm_and_ps(m2, mask);
+
+			const __m128 bc = Cross3(b, c);
+			const __m128 ca = Cross3(c, a);
+			const __m128 ab = Cross3(a, b);
+
+			const __m128 det = Dot4(a, bc);
+			const __m128 invDet = _mm_and_ps(_mm_div_ps(_mm_set1_ps(1.0f), det), _mm_cmpneq_ps(det, _mm_setzero_ps()));
+
+			_mm_stream_ps(transform->Normal[0], _mm_mul_ps(bc, invDet));
+			_mm_stream_ps(transform->Normal[1], _mm_mul_ps(ca, invDet));
+			_mm_stream_ps(transform->Normal[2], _mm_mul_ps(ab, invDet));
+
+			// each column of viewProjection * model combines the view projection columns by a model column
+			const __m128 columns[4] = { m0, m1, m2, m3 };
+			for (int column = 0; column < 4; ++column)
+			{
+				const __m128 m = columns[column];
+				__m128 result = _mm_mul_ps(vp0, _mm_shuffle_ps(m, m, _MM_SHUFFLE(0, 0, 0, 0)));
+				result = _mm_add_ps(result, _mm_mul_ps(vp1, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1))));
+				result = _mm_add_ps(result, _mm_mul_ps(vp2, _mm_shuffle_ps(m, m, _MM_SHUFFLE(2, 2, 2, 2))));
+				result = _mm_add_ps(result, _mm_mul_ps(vp3, _mm_shuffle_ps(m, m, _MM_SHUFFLE(3, 3, 3, 3))));
+				_mm_stream_ps(transform->ModelViewProjection.Columns[column], result);
+			}
+		}
+
+		// streaming stores are weakly ordered, make them visible before the GPU reads the data
+		_mm_sfence();
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stddef.h>
+
+namespace W
+{
+	namespace Math
+	{
+		// Column major 4x4 matrix, same layout as glm::mat4 and GLSL mat4
+		struct alignas(16) Matrix4
+		{
+			float Columns[4][4];
+		};
+
+		// Per object constants, matches { mat4 model; mat3 normal; mat4 modelViewProjection; } in std140 and std430
+		struct alignas(16) ObjectTransform
+		{
+			Matrix4 Model;
+			float Normal[3][4]; // inverse transpose of the upper 3x3 of the model matrix, each column padded to 4 floats
+			Matrix4 ModelViewProjection;
+		};
+
+		// Fills the constants of count objects in one pass with SSE, transforms are written outStride bytes apart
+		// outTransforms must be 16 bytes aligned, outStride a multiple of 16 and at least sizeof(ObjectTransform)
+		void ComputeObjectTransforms(void* outTransforms, size_t outStride, const Matrix4* models, size_t count, const Matrix4& viewProjection);
+	} // namespace Math
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,59 @@
+#include "RingAllocator.h"
+#include <Framework.Debug/Debug.h>
+
+namespace W
+{
+	Memory::RingAllocator::RingAllocator(uint64_t size)
+		: mSize(size)
+		, mHead(0)
+		, mTail(0)
+	{
+		Debug_AssertMsg(size > 0, "empty allocator");
+	}
+
+	bool Memory::RingAllocator::Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset)
+	{
+		Debug_AssertMsg(alignment > 0 && (alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+
+		// An empty ring starts over at zero so it can hold its whole size
+		if (mHead == mTail)
+		{
+			mHead += (mSize - (mHead % mSize)) % mSize;
+			mTail = mHead;
+		}
+
+		const uint64_t offset = mHead % mSize;
+		uint64_t alignedOffset = (offset + alignment - 1) & ~(alignment - 1);
+
+		// An allocation never wraps, skip the end of the ring and start over at zero
+		uint64_t head = mHead;
+		if (alignedOffset + size > mSize)
+		{
+			head += mSize - offset;
+			alignedOffset = 0;
+		}
+		else
+		{
+			head += alignedOffset - offset;
+		}
+		head += size;
+
+		if (head - mTail > mSize)
+			return false;
+
+		mHead = head;
+		outOffset = alignedOffset;
+		return true;
+	}
+
+	void Memory::RingAllocator::Release(uint64_t head)
+	{
+		Debug_AssertMsg(head <= mHead, "released a marker past the head");
+
+		// a marker taken before the ring was last emptied is already released
+		if (head > mTail)
+		{
+			mTail = head;
+		}
+	}
+} // namespace W
\ No newline at end of file
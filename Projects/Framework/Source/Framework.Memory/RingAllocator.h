@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace W
+{
+	namespace Memory
+	{
+		// Allocates offsets in a ring for transient data that is released in the order it was allocated,
+		// typically everything written during a frame once the GPU is done with that frame
+		// Positions keep growing past the size so a full ring and an empty ring are told apart
+		class RingAllocator
+		{
+		public:
+			explicit RingAllocator(uint64_t size);
+
+			// alignment must be a power of two, fails when the ring is full until older allocations are released
+			bool Allocate(uint64_t size, uint64_t alignment, uint64_t& outOffset);
+
+			// Marker past every allocation made so far, release it once they are no longer in use
+			uint64_t GetHead() const { return mHead; }
+			void Release(uint64_t head);
+
+			uint64_t GetSize() const { return mSize; }
+			uint64_t GetUsedSize() const { return mHead - mTail; }
+
+		private:
+			uint64_t mSize;
+			uint64_t mHead;
+			uint64_t mTail;
+		};
+	} // namespace Memory
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,298 @@
+#include "TlsfAllocator.h"
+#include <Framework.Debug/Debug.h>
+
+#include <intrin.h>
+
+namespace W
+{
+	static uint32_t BitScanForward(uint64_t mask)
+	{
+		unsigned long index;
+		_BitScanForward64(&index, mask);
+		return static_cast<uint32_t>(index);
+	}
+
+	static uint32_t BitScanReverse(uint64_t mask)
+	{
+		unsigned long index;
+		_BitScanReverse64(&index, mask);
+		return static_cast<uint32_t>(index);
+	}
+
+	static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	Memory::TlsfAllocator::TlsfAllocator(uint64_t size)
+		: mSize(size)
+		, mUsedSize(0)
+		, mAllocationCount(0)
+		, mFirstLevelMap(0)
+	{
+		Debug_AssertMsg(size > 0, "empty allocator");
+
+		for (uint32_t firstLevel = 0; firstLevel < FirstLevelCount; ++firstLevel)
+		{
+			mSecondLevelMap[firstLevel] = 0;
+			for (uint32_t secondLevel = 0; secondLevel < SecondLevelCount; ++secondLevel)
+			{
+				mFreeLists[firstLevel][secondLevel] = InvalidNode;
+			}
+		}
+
+		InsertFree(CreateNode(0, size));
+	}
+
+	bool Memory::TlsfAllocator::Allocate(uint64_t size, uint64_t alignment, Allocation& outAllocation)
+	{
+		Debug_AssertMsg(alignment > 0 && (alignment & (alignment - 1)) == 0, "alignment must be a power of two");
+		if (size == 0)
+		{
+			size = 1;
+		}
+
+		// Any block of the class found is large enough for the padding of the worst alignment
+		const uint64_t searchSize = size + alignment - 1;
+		if (searchSize > mSize)
+			return false;
+
+		const uint32_t node = FindFree(searchSize);
+		if (node == InvalidNode)
+			return false;
+
+		RemoveFree(node);
+
+		// Free blocks are always coalesced so the previous block is allocated, the padding becomes a free block
+		const uint64_t padding = AlignUp(mNodes[node].Offset, alignment) - mNodes[node].Offset;
+		if (padding > 0)
+		{
+			const uint32_t paddingNode = CreateNode(mNodes[node].Offset, padding);
+			const uint32_t prevNode = mNodes[node].PrevPhysical;
+			mNodes[paddingNode].PrevPhysical = prevNode;
+			mNodes[paddingNode].NextPhysical = node;
+			if (prevNode != InvalidNode)
+			{
+				mNodes[prevNode].NextPhysical = paddingNode;
+			}
+			mNodes[node].PrevPhysical = paddingNode;
+			mNodes[node].Offset += padding;
+			mNodes[node].Size -= padding;
+			InsertFree(paddingNode);
+		}
+
+		Split(node, size);
+		mNodes[node].IsFree = false;
+
+		mUsedSize += mNodes[node].Size;
+		++mAllocationCount;
+
+		outAllocation.Offset = mNodes[node].Offset;
+		outAllocation.NodeIndex = node;
+		return true;
+	}
+
+	void Memory::TlsfAllocator::Free(Allocation& allocation)
+	{
+		if (allocation.IsValid() == false)
+			return;
+
+		uint32_t node = allocation.NodeIndex;
+		Debug_AssertMsg(mNodes[node].IsFree == false && mNodes[node].Offset == allocation.Offset, "invalid allocation");
+
+		mUsedSize -= mNodes[node].Size;
+		--mAllocationCount;
+		mNodes[node].IsFree = true;
+
+		// Coalesce with the free neighbors
+		const uint32_t nextNode = mNodes[node].NextPhysical;
+		if (nextNode != InvalidNode && mNodes[nextNode].IsFree)
+		{
+			RemoveFree(nextNode);
+			Merge(node, nextNode);
+		}
+
+		const uint32_t prevNode = mNodes[node].PrevPhysical;
+		if (prevNode != InvalidNode && mNodes[prevNode].IsFree)
+		{
+			RemoveFree(prevNode);
+			Merge(prevNode, node);
+			node = prevNode;
+		}
+
+		InsertFree(node);
+		allocation = Allocation();
+	}
+
+	Memory::AllocatorStatistics Memory::TlsfAllocator::GetStatistics() const
+	{
+		AllocatorStatistics statistics;
+		statistics.Size = mSize;
+		statistics.UsedSize = mUsedSize;
+		statistics.FreeSize = mSize - mUsedSize;
+		statistics.AllocationCount = mAllocationCount;
+
+		for (uint32_t firstLevel = 0; firstLevel < FirstLevelCount; ++firstLevel)
+		{
+			for (uint32_t secondLevel = 0; secondLevel < SecondLevelCount; ++secondLevel)
+			{
+				for (uint32_t node = mFreeLists[firstLevel][secondLevel]; node != InvalidNode; node = mNodes[node].NextFree)
+				{
+					++statistics.FreeBlockCount;
+					if (mNodes[node].Size > statistics.LargestFreeSize)
+					{
+						statistics.LargestFreeSize = mNodes[node].Size;
+					}
+				}
+			}
+		}
+
+		return statistics;
+	}
+
+	void Memory::TlsfAllocator::Mapping(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+	{
+		if (size < SecondLevelCount)
+		{
+			outFirstLevel = 0;
+			outSecondLevel = static_cast<uint32_t>(size);
+			return;
+		}
+
+		const uint32_t log2Size = BitScanReverse(size);
+		outFirstLevel = log2Size - SecondLevelLog2 + 1;
+		outSecondLevel = static_cast<uint32_t>(size >> (log2Size - SecondLevelLog2)) ^ SecondLevelCount;
+	}
+
+	uint32_t Memory::TlsfAllocator::CreateNode(uint64_t offset, uint64_t size)
+	{
+		uint32_t node;
+		if (mUnusedNodes.empty())
+		{
+			node = static_cast<uint32_t>(mNodes.size());
+			mNodes.emplace_back();
+		}
+		else
+		{
+			node = mUnusedNodes.back();
+			mUnusedNodes.pop_back();
+		}
+
+		mNodes[node] = { offset, size, InvalidNode, InvalidNode, InvalidNode, InvalidNode, true };
+		return node;
+	}
+
+	void Memory::TlsfAllocator::DestroyNode(uint32_t node)
+	{
+		mUnusedNodes.push_back(node);
+	}
+
+	void Memory::TlsfAllocator::InsertFree(uint32_t node)
+	{
+		uint32_t firstLevel, secondLevel;
+		Mapping(mNodes[node].Size, firstLevel, secondLevel);
+
+		const uint32_t head = mFreeLists[firstLevel][secondLevel];
+		mNodes[node].IsFree = true;
+		mNodes[node].PrevFree = InvalidNode;
+		mNodes[node].NextFree = head;
+		if (head != InvalidNode)
+		{
+			mNodes[head].PrevFree = node;
+		}
+
+		mFreeLists[firstLevel][secondLevel] = node;
+		mFirstLevelMap |= 1ull << firstLevel;
+		mSecondLevelMap[firstLevel] |= 1u << secondLevel;
+	}
+
+	void Memory::TlsfAllocator::RemoveFree(uint32_t node)
+	{
+		uint32_t firstLevel, secondLevel;
+		Mapping(mNodes[node].Size, firstLevel, secondLevel);
+
+		const uint32_t prevFree = mNodes[node].PrevFree;
+		const uint32_t nextFree = mNodes[node].NextFree;
+		if (prevFree != InvalidNode)
+		{
+			mNodes[prevFree].NextFree = nextFree;
+		}
+		else
+		{
+			mFreeLists[firstLevel][secondLevel] = nextFree;
+		}
+
+		if (nextFree != InvalidNode)
+		{
+			mNodes[nextFree].PrevFree = prevFree;
+		}
+
+		if (mFreeLists[firstLevel][secondLevel] == InvalidNode)
+		{
+			mSecondLevelMap[firstLevel] &= ~(1u << secondLevel);
+			if (mSecondLevelMap[firstLevel] == 0)
+			{
+				mFirstLevelMap &= ~(1ull << firstLevel);
+			}
+		}
+	}
+
+	uint32_t Memory::TlsfAllocator::FindFree(uint64_t size) const
+	{
+		// Round up to the next class so every block of the class found fits
+		if (size >= SecondLevelCount)
+		{
+			size += (1ull << (BitScanReverse(size) - SecondLevelLog2)) - 1;
+		}
+
+		uint32_t firstLevel, secondLevel;
+		Mapping(size, firstLevel, secondLevel);
+
+		// Smallest class at least as large, in the same power of two or the next non empty one
+		uint32_t secondLevelMap = mSecondLevelMap[firstLevel] & (~0u << secondLevel);
+		if (secondLevelMap == 0)
+		{
+			const uint64_t firstLevelMap = mFirstLevelMap & (~0ull << (firstLevel + 1));
+			if (firstLevelMap == 0)
+				return InvalidNode;
+
+			firstLevel = BitScanForward(firstLevelMap);
+			secondLevelMap = mSecondLevelMap[firstLevel];
+		}
+
+		return mFreeLists[firstLevel][BitScanForward(secondLevelMap)];
+	}
+
+	void Memory::TlsfAllocator::Split(uint32_t node, uint64_t size)
+	{
+		const uint64_t remainingSize = mNodes[node].Size - size;
+		if (remainingSize == 0)
+			return;
+
+		const uint32_t tailNode = CreateNode(mNodes[node].Offset + size, remainingSize);
+		const uint32_t nextNode = mNodes[node].NextPhysical;
+		mNodes[tailNode].PrevPhysical = node;
+		mNodes[tailNode].NextPhysical = nextNode;
+		if (nextNode != InvalidNode)
+		{
+			mNodes[nextNode].PrevPhysical = tailNode;
+		}
+		mNodes[node].NextPhysical = tailNode;
+		mNodes[node].Size = size;
+
+		InsertFree(tailNode);
+	}
+
+	void Memory::TlsfAllocator::Merge(uint32_t node, uint32_t nextNode)
+	{
+		const uint32_t nextNextNode = mNodes[nextNode].NextPhysical;
+		mNodes[node].Size += mNodes[nextNode].Size;
+		mNodes[node].NextPhysical = nextNextNode;
+		if (nextNextNode != InvalidNode)
+		{
+			mNodes[nextNextNode].PrevPhysical = node;
+		}
+
+		DestroyNode(nextNode);
+	}
+} // namespace W
\ No newline at end of file
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+namespace W
+{
+	namespace Memory
+	{
+		struct AllocatorStatistics
+		{
+			uint64_t Size = 0;
+			uint64_t UsedSize = 0;
+			uint64_t FreeSize = 0;
+			uint64_t LargestFreeSize = 0;
+			uint32_t AllocationCount = 0;
+			uint32_t FreeBlockCount = 0;
+
+			// 0 when the free space is one block, close to 1 when it is scattered in small blocks
+			float GetFragmentation() const { return (FreeSize > 0) ? 1.0f - static_cast<float>(LargestFreeSize) / static_cast<float>(FreeSize) : 0.0f; }
+		};
+
+		// Two-level segregated fit allocator (Masmano et al. "TLSF: a New Dynamic Memory Allocator for Real-Time Systems")
+		// Manages offsets in a range it does not own, such as a block of GPU memory, allocating and freeing in constant time
+		class TlsfAllocator
+		{
+		public:
+			struct Allocation
+			{
+				uint64_t Offset = 0;
+				uint32_t NodeIndex = InvalidNode;
+
+				bool IsValid() const { return NodeIndex != InvalidNode; }
+			};
+
+			explicit TlsfAllocator(uint64_t size);
+
+			TlsfAllocator(const TlsfAllocator&) = delete;
+			TlsfAllocator& operator=(const TlsfAllocator&) = delete;
+
+			// alignment must be a power of two, fails when no free block is large enough
+			bool Allocate(uint64_t size, uint64_t alignment, Allocation& outAllocation);
+			void Free(Allocation& allocation);
+
+			uint64_t GetSize() const { return mSize; }
+			uint64_t GetUsedSize() const { return mUsedSize; }
+			uint32_t GetAllocationCount() const { return mAllocationCount; }
+			bool IsEmpty() const { return mAllocationCount == 0; }
+
+			AllocatorStatistics GetStatistics() const;
+
+		private:
+			static const uint32_t InvalidNode = 0xffffffff;
+
+			// Each power of two size class is split in 32 linear sub classes, sizes below 32 have a class each
+			static const uint32_t SecondLevelLog2 = 5;
+			static const uint32_t SecondLevelCount = 1 << SecondLevelLog2;
+			static const uint32_t FirstLevelCount = 64 - SecondLevelLog2 + 1;
+
+			struct Node
+			{
+				uint64_t Offset;
+				uint64_t Size;
+				uint32_t PrevPhysical;
+				uint32_t NextPhysical;
+				uint32_t PrevFree;
+				uint32_t NextFree;
+				bool IsFree;
+			};
+
+			static void Mapping(uint64_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel);
+
+			uint32_t CreateNode(uint64_t offset, uint64_t size);
+			void DestroyNode(uint32_t node);
+
+			void InsertFree(uint32_t node);
+			void RemoveFree(uint32_t node);
+			uint32_t FindFree(uint64_t size) const;
+
+			// Splits the tail of the node past size into a free node
+			void Split(uint32_t node, uint64_t size);
+			void Merge(uint32_t node, uint32_t nextNode);
+
+			uint64_t mSize;
+			uint64_t mUsedSize;
+			uint32_t mAllocationCount;
+
+			uint64_t mFirstLevelMap;
+			uint32_t mSecondLevelMap[FirstLevelCount];
+			uint32_t mFreeLists[FirstLevelCount][SecondLevelCount];
+
+			std::vector<Node> mNodes;
+			std::vector<uint32_t> mUnusedNodes;
+		};
+	} // namespace Memory
+} // namespace W
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "Hash.h"
 
+#include <intrin.h>
+#include <nmmintrin.h>
+#include <string.h>
+
 namespace W
 {
 	// CRC-32 Table
@@ -76,6 +80,102 @@ namespace W
 		0x66e7a46c27f3aa2c, 0x1c3fd4a417c62355, 0x935745fc4798b8de, 0xe98f353477ad31a7, 0xa6df411fbfb21ca3, 0xdc0731d78f8795da, 0x536fa08fdfd90e51, 0x29b7d047efec8728
 	};
 
+	// CRC-64 Slice-by-8 Tables, table[k][i] is the CRC of byte i followed by k zero bytes
+	struct Crc64SliceTable
+	{
+		uint64_t Table[8][256];
+
+		Crc64SliceTable()
+		{
+			for (int i = 0; i < 256; ++i)
+			{
+				Table[0][i] = s_crc64[i];
+			}
+
+			for (int k = 1; k < 8; ++k)
+			{
+				for (int i = 0; i < 256; ++i)
+				{
+					const uint64_t previous = Table[k - 1][i];
+					Table[k][i] = (previous >> 8) ^ s_crc64[previous & 0xff];
+				}
+			}
+		}
+	};
+
+	static const Crc64SliceTable& GetCrc64SliceTable()
+	{
+		static const Crc64SliceTable s_crc64Slices;
+		return s_crc64Slices;
+	}
+
+	// CRC-32C Slice-by-8 Tables (reflected Castagnoli polynomial 0x82F63B78)
+	struct Crc32CSliceTable
+	{
+		uint32_t Table[8][256];
+
+		Crc32CSliceTable()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; ++bit)
+				{
+					crc = (crc & 1) ? ((crc >> 1) ^ 0x82f63b78) : (crc >> 1);
+				}
+				Table[0][i] = crc;
+			}
+
+			for (int k = 1; k < 8; ++k)
+			{
+				for (int i = 0; i < 256; ++i)
+				{
+					const uint32_t previous = Table[k - 1][i];
+					Table[k][i] = (previous >> 8) ^ Table[0][previous & 0xff];
+				}
+			}
+		}
+	};
+
+	static const Crc32CSliceTable& GetCrc32CSliceTable()
+	{
+		static const Crc32CSliceTable s_crc32cSlices;
+		return s_crc32cSlices;
+	}
+
+	static uint32_t Crc32CHardware(const void* data, size_t size, uint32_t previousHash)
+	{
+		uint64_t crc = ~previousHash;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+		while (size >= 8)
+		{
+			uint64_t block;
+			memcpy(&block, bytes, sizeof(block));
+			crc = _mm_crc32_u64(crc, block);
+
+			bytes += 8;
+			size -= 8;
+		}
+
+		uint32_t crc32 = static_cast<uint32_t>(crc);
+		while (size > 0)
+		{
+			crc32 = _mm_crc32_u8(crc32, bytes[0]);
+			++bytes;
+			--size;
+		}
+
+		return ~crc32;
+	}
+
+	using Crc32CFunction = uint32_t(*)(const void* data, size_t size, uint32_t previousHash);
+
+	static Crc32CFunction SelectCrc32C()
+	{
+		return Hash::IsCrc32CHardwareSupported() ? Crc32CHardware : Hash::Crc32CPortable;
+	}
+
 	uint32_t Hash::StringHash32(const char* text, uint32_t previousHash)
 	{
 		uint32_t crc = previousHash;
@@ -100,11 +200,102 @@ namespace W
 		{
 			while (text[0] != '\0')
 			{
-				crc = s_crc32[(crc ^ text[0]) & 0xff] ^ (crc >> 8);
+				crc = s_crc64[(crc ^ text[0]) & 0xff] ^ (crc >> 8);
 				++text;
 			}
 		}
 
 		return crc;
 	}
+
+	uint64_t Hash::BufferHash64(const void* data, size_t size, uint64_t previousHash)
+	{
+		const Crc64SliceTable& slices = GetCrc64SliceTable();
+
+		uint64_t crc = previousHash;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+		// Slice-by-8, one table lookup per input byte but 8 independent lookups per iteration
+		// Note: the 64-bit loads assume a little-endian platform
+		while (size >= 8)
+		{
+			uint64_t block;
+			memcpy(&block, bytes, sizeof(block));
+			crc ^= block;
+
+			crc = slices.Table[7][crc & 0xff] ^
+				slices.Table[6][(crc >> 8) & 0xff] ^
+				slices.Table[5][(crc >> 16) & 0xff] ^
+				slices.Table[4][(crc >> 24) & 0xff] ^
+				slices.Table[3][(crc >> 32) & 0xff] ^
+				slices.Table[2][(crc >> 40) & 0xff] ^
+				slices.Table[1][(crc >> 48) & 0xff] ^
+				slices.Table[0][crc >> 56];
+
+			bytes += 8;
+			size -= 8;
+		}
+
+		while (size > 0)
+		{
+			crc = s_crc64[(crc ^ bytes[0]) & 0xff] ^ (crc >> 8);
+			++bytes;
+			--size;
+		}
+
+		return crc;
+	}
+
+	bool Hash::IsCrc32CHardwareSupported()
+	{
+		// CPUID leaf 1, ECX bit 20
+		int cpuInfo[4];
+		__cpuid(cpuInfo, 1);
+		return (cpuInfo[2] & (1 << 20)) != 0;
+	}
+
+	uint32_t Hash::Crc32C(const void* data, size_t size, uint32_t previousHash)
+	{
+		static const Crc32CFunction s_crc32c = SelectCrc32C();
+		return s_crc32c(data, size, previousHash);
+	}
+
+	uint32_t Hash::Crc32CPortable(const void* data, size_t size, uint32_t previousHash)
+	{
+		const Crc32CSliceTable& slices = GetCrc32CSliceTable();
+
+		// Inverted on entry and exit, so an empty input keeps the previous hash and hashes chain
+		uint32_t crc = ~previousHash;
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+		while (size >= 8)
+		{
+			uint32_t low;
+			uint32_t high;
+			memcpy(&low, bytes, sizeof(low));
+			memcpy(&high, bytes + 4, sizeof(high));
+			crc ^= low;
+
+			crc = slices.Table[7][crc & 0xff] ^
+				slices.Table[6][(crc >> 8) & 0xff] ^
+				slices.Table[5][(crc >> 16) & 0xff] ^
+				slices.Table[4][crc >> 24] ^
+				slices.Table[3][high & 0xff] ^
+				slices.Table[2][(high >> 8) & 0xff] ^
+				slices.Table[1][(high >> 16) & 0xff] ^
+				slices.Table[0][high >> 24];
+
+			bytes += 8;
+			size -= 8;
+		}
+
+		while (size > 0)
+		{
+			crc = slices.Table[0][(crc ^ bytes[0]) & 0xff] ^ (crc >> 8);
+			++bytes;
+			--size;
+		}
+
+		return ~crc;
+	}
 } // namespace W
\ No newline at end of file
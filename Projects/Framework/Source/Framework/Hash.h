@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace W
@@ -11,5 +12,84 @@ namespace W
 
 		uint32_t StringHash32(const char* text, uint32_t previousHash = EmptyHash32);
 		uint64_t StringHash64(const char* text, uint64_t previousHash = EmptyHash64);
+
+		// Compile-time versions of the string hashes, bit-for-bit equal to the runtime versions
+		constexpr uint32_t ConstStringHash32(const char* text, uint32_t previousHash = EmptyHash32);
+		constexpr uint64_t ConstStringHash64(const char* text, uint64_t previousHash = EmptyHash64);
+
+		uint64_t BufferHash64(const void* data, size_t size, uint64_t previousHash = EmptyHash64);
+
+		// CRC-32C (Castagnoli), uses the SSE4.2 crc32 instruction when the CPU supports it
+		uint32_t Crc32C(const void* data, size_t size, uint32_t previousHash = EmptyHash32);
+
+		// CRC-32C slice-by-8 fallback, same results as Crc32C on any CPU
+		uint32_t Crc32CPortable(const void* data, size_t size, uint32_t previousHash = EmptyHash32);
+		bool IsCrc32CHardwareSupported();
+
+		// Incremental CRC-64 of a stream of buffers, the digest equals BufferHash64 of the concatenated buffers
+		class Hasher64
+		{
+		public:
+			explicit Hasher64(uint64_t seed = EmptyHash64) : mHash(seed) {}
+
+			void Update(const void* data, size_t size) { mHash = BufferHash64(data, size, mHash); }
+			uint64_t Digest() const { return mHash; }
+
+		private:
+			uint64_t mHash;
+		};
+
+		// The table entries of the runtime versions, computed a bit at a time
+		constexpr uint32_t ConstCrc32Byte(uint32_t crc, char byte)
+		{
+			crc ^= static_cast<uint8_t>(byte);
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 1) ? ((crc >> 1) ^ 0xedb88320u) : (crc >> 1);
+			}
+			return crc;
+		}
+
+		constexpr uint64_t ConstCrc64Byte(uint64_t crc, char byte)
+		{
+			crc ^= static_cast<uint8_t>(byte);
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 1) ? ((crc >> 1) ^ 0x95ac9329ac4bc9b5ull) : (crc >> 1);
+			}
+			return crc;
+		}
+
+		constexpr uint32_t ConstStringHash32(const char* text, uint32_t previousHash)
+		{
+			uint32_t crc = previousHash;
+			if (text != nullptr)
+			{
+				for (; text[0] != '\0'; ++text)
+				{
+					crc = ConstCrc32Byte(crc, text[0]);
+				}
+			}
+			return crc;
+		}
+
+		constexpr uint64_t ConstStringHash64(const char* text, uint64_t previousHash)
+		{
+			uint64_t crc = previousHash;
+			if (text != nullptr)
+			{
+				for (; text[0] != '\0'; ++text)
+				{
+					crc = ConstCrc64Byte(crc, text[0]);
+				}
+			}
+			return crc;
+		}
 	} // namespace Hash
+
+	namespace Literals
+	{
+		constexpr uint32_t operator"" _hash32(const char* text, size_t) { return Hash::ConstStringHash32(text); }
+		constexpr uint64_t operator"" _hash64(const char* text, size_t) { return Hash::ConstStringHash64(text); }
+	} // namespace Literals
 } // namespace W
\ No newline at end of file
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <Framework/Hash.h>
+#include <Framework.Debug/Debug.h>
+
+#include <functional>
+
+namespace W
+{
+	// A string literal with its 32-bit hash, folded at compile time when constructed from a literal
+	class HashedString
+	{
+	public:
+		constexpr HashedString() : mText(""), mHash(Hash::EmptyHash32) {}
+		constexpr explicit HashedString(const char* text) : mText(text), mHash(Hash::ConstStringHash32(text)) {}
+
+		constexpr const char* GetText() const { return mText; }
+		constexpr uint32_t GetHash() const { return mHash; }
+
+		// Equality is hash equality, two strings whose hashes collide compare equal, also as map keys
+		// debug builds compare the texts of equal hashes and assert on a collision
+		constexpr bool operator==(const HashedString& other) const
+		{
+#ifdef _DEBUG
+			return mHash == other.mHash && (TextEquals(mText, other.mText) || ReportCollision(other));
+#else
+			return mHash == other.mHash;
+#endif
+		}
+		constexpr bool operator!=(const HashedString& other) const { return !(*this == other); }
+
+	private:
+		static constexpr bool TextEquals(const char* lhs, const char* rhs)
+		{
+			while (*lhs != '\0' && *lhs == *rhs)
+			{
+				++lhs;
+				++rhs;
+			}
+			return *lhs == *rhs;
+		}
+
+		// not constexpr, a collision between literals fails to compile
+		bool ReportCollision(const HashedString& other) const
+		{
+			Debug_AssertMsg(false, "hashed strings \"%s\" and \"%s\" collide", mText, other.mText);
+			return true;
+		}
+
+		// the text is not copied, it must outlive the hashed string
+		const char* mText;
+		uint32_t mHash;
+	};
+
+	namespace Literals
+	{
+		constexpr HashedString operator"" _hs(const char* text, size_t) { return HashedString(text); }
+	} // namespace Literals
+} // namespace W
+
+namespace std
+{
+	template <>
+	struct hash<W::HashedString>
+	{
+		size_t operator()(const W::HashedString& hashedString) const { return hashedString.GetHash(); }
+	};
+} // namespace std
\ No newline at end of file
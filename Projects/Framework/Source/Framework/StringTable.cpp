@@ -0,0 +1,135 @@
+#include "StringTable.h"
+#include <Framework/Hash.h>
+#include <Framework.Debug/Debug.h>
+
+#include <string.h>
+
+namespace W
+{
+	static const uint32_t s_invalidId = ~0u;
+
+	const uint32_t StringTable::EmptyId;
+
+	StringTable::StringTable()
+		: mPageCursor(nullptr)
+		, mPageRemaining(0)
+		, mEntryChunks()
+		, mCount(0)
+	{
+		mBuckets.assign(1024, s_invalidId);
+
+		// id 0 is the empty string
+		Intern("");
+	}
+
+	StringTable::~StringTable()
+	{
+		for (const char** chunk : mEntryChunks)
+		{
+			delete[] chunk;
+		}
+	}
+
+	uint32_t StringTable::Intern(const char* text)
+	{
+		if (text == nullptr)
+			return EmptyId;
+
+		const uint32_t hash = Hash::StringHash32(text);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+
+		const size_t bucketMask = mBuckets.size() - 1;
+		size_t bucket = hash & bucketMask;
+		while (mBuckets[bucket] != s_invalidId)
+		{
+			const uint32_t id = mBuckets[bucket];
+			if (mEntryHashes[id] == hash && strcmp(GetText(id), text) == 0)
+				return id;
+
+			bucket = (bucket + 1) & bucketMask;
+		}
+
+		const uint32_t id = mCount;
+		const size_t chunkIndex = id / EntryChunkSize;
+		Debug_AssertMsg(chunkIndex < MaxEntryChunks, "string table is full");
+
+		if (mEntryChunks[chunkIndex] == nullptr)
+		{
+			mEntryChunks[chunkIndex] = new const char*[EntryChunkSize];
+		}
+
+		mEntryChunks[chunkIndex][id % EntryChunkSize] = Store(text, strlen(text));
+		mEntryHashes.push_back(hash);
+		mBuckets[bucket] = id;
+		++mCount;
+
+		// keep the load factor below 0.5
+		if (mCount * 2 > mBuckets.size())
+		{
+			GrowBuckets();
+		}
+
+		return id;
+	}
+
+	const char* StringTable::GetText(uint32_t id) const
+	{
+		Debug_Assert(id / EntryChunkSize < MaxEntryChunks && mEntryChunks[id / EntryChunkSize] != nullptr);
+		return mEntryChunks[id / EntryChunkSize][id % EntryChunkSize];
+	}
+
+	size_t StringTable::GetCount() const
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		return mCount;
+	}
+
+	StringTable& StringTable::GetGlobal()
+	{
+		static StringTable s_globalTable;
+		return s_globalTable;
+	}
+
+	const char* StringTable::Store(const char* text, size_t length)
+	{
+		const size_t size = length + 1;
+
+		// long strings get a page of their own, the current page stays open
+		if (size > PageSize)
+		{
+			mPages.push_back(std::make_unique<char[]>(size));
+			memcpy(mPages.back().get(), text, size);
+			return mPages.back().get();
+		}
+
+		if (size > mPageRemaining)
+		{
+			mPages.push_back(std::make_unique<char[]>(PageSize));
+			mPageCursor = mPages.back().get();
+			mPageRemaining = PageSize;
+		}
+
+		char* storage = mPageCursor;
+		memcpy(storage, text, size);
+		mPageCursor += size;
+		mPageRemaining -= size;
+		return storage;
+	}
+
+	void StringTable::GrowBuckets()
+	{
+		mBuckets.assign(mBuckets.size() * 2, s_invalidId);
+
+		const size_t bucketMask = mBuckets.size() - 1;
+		for (uint32_t id = 0; id < mCount; ++id)
+		{
+			size_t bucket = mEntryHashes[id] & bucketMask;
+			while (mBuckets[bucket] != s_invalidId)
+			{
+				bucket = (bucket + 1) & bucketMask;
+			}
+			mBuckets[bucket] = id;
+		}
+	}
+} // namespace W
\ No newline at end of file
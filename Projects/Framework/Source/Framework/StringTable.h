@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace W
+{
+	// Interned strings, each unique string is stored once in a paged arena and identified by a 32-bit id
+	// Interning is thread-safe, the text of an interned string never moves and lives as long as the table
+	class StringTable
+	{
+	public:
+		static const uint32_t EmptyId = 0;
+
+		StringTable();
+		~StringTable();
+
+		StringTable(const StringTable&) = delete;
+		StringTable& operator=(const StringTable&) = delete;
+
+		uint32_t Intern(const char* text);
+		const char* GetText(uint32_t id) const;
+		size_t GetCount() const;
+
+		// Table of the W::Name handles
+		static StringTable& GetGlobal();
+
+	private:
+		static const size_t PageSize = 64 * 1024;
+		static const size_t EntryChunkSize = 4096;
+		static const size_t MaxEntryChunks = 4096;
+
+		const char* Store(const char* text, size_t length);
+		void GrowBuckets();
+
+		mutable std::mutex mMutex;
+
+		// text arena
+		std::vector<std::unique_ptr<char[]>> mPages;
+		char* mPageCursor;
+		size_t mPageRemaining;
+
+		// id -> text, chunks never move so the text is read without locking
+		const char** mEntryChunks[MaxEntryChunks];
+		std::vector<uint32_t> mEntryHashes;
+		uint32_t mCount;
+
+		// open addressing hash set of ids
+		std::vector<uint32_t> mBuckets;
+	};
+
+	// Handle of a string interned in the global string table, compared by id
+	class Name
+	{
+	public:
+		Name() : mId(StringTable::EmptyId) {}
+		explicit Name(const char* text) : mId(StringTable::GetGlobal().Intern(text)) {}
+
+		const char* GetText() const { return StringTable::GetGlobal().GetText(mId); }
+		uint32_t GetId() const { return mId; }
+		bool IsEmpty() const { return mId == StringTable::EmptyId; }
+
+		bool operator==(const Name& other) const { return mId == other.mId; }
+		bool operator!=(const Name& other) const { return mId != other.mId; }
+		bool operator<(const Name& other) const { return mId < other.mId; }
+
+	private:
+		uint32_t mId;
+	};
+} // namespace W
+
+namespace std
+{
+	template <>
+	struct hash<W::Name>
+	{
+		size_t operator()(const W::Name& name) const { return name.GetId(); }
+	};
+} // namespace std
\ No newline at end of file
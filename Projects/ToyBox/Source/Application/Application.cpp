@@ -1,6 +1,8 @@
 #include "Application.h"
 #include <Graphics/Renderer.h>
 
+#include <Framework.Jobs/JobSystem.h>
+
 #define GLFW_INCLUDE_NONE
 #define GLFW_EXPOSE_NATIVE_WIN32
 #include <GLFW/glfw3.h>
@@ -29,6 +31,9 @@ void Application::Run()
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 	mMainWindow = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "ToyBox - Vulkan Renderer", nullptr, nullptr);
 
+	// create the worker threads, one per hardware thread besides the main thread
+	mJobSystem = new W::JobSystem();
+
 	// create graphics
 	Renderer* renderer = new Renderer();
 	renderer->Startup();
@@ -66,6 +71,9 @@ void Application::Run()
 	renderer->Shutdown();
 	delete renderer;
 
+	delete mJobSystem;
+	mJobSystem = nullptr;
+
 	// destroy window
 	glfwDestroyWindow(mMainWindow);
 	glfwTerminate();
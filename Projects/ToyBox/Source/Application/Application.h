@@ -2,6 +2,11 @@
 
 struct GLFWwindow;
 
+namespace W
+{
+	class JobSystem;
+} // namespace W
+
 class Application
 {
 public:
@@ -12,6 +17,7 @@ public:
 	void Shutdown();
 
 	GLFWwindow* MainWindow() const { return mMainWindow; }
+	W::JobSystem& Jobs() const { return *mJobSystem; }
 
 private:
 	Application() = default;
@@ -21,4 +27,5 @@ private:
 private:
 	bool mShouldExit = false;
 	GLFWwindow* mMainWindow = nullptr;
+	W::JobSystem* mJobSystem = nullptr;
 };
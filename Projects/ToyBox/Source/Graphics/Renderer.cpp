@@ -23,6 +23,8 @@
 #include <cstdlib>
 #include <array>
 #include <set>
+#include <map>
+#include <tuple>
 #include <unordered_map>
 
 #include <imgui.h>
@@ -41,6 +43,50 @@
 
 const int MAX_FRAMES_IN_FLIGHT = 2;
 
+// Host visible ring the scene uploads are copied through, larger uploads get a temporary staging buffer
+const VkDeviceSize STAGING_BUFFER_SIZE = 32 * 1024 * 1024;
+
+// Host visible ring the per frame constants are written to, shared by the frames in flight
+const VkDeviceSize FRAME_CONSTANTS_SIZE = 4 * 1024 * 1024;
+
+// Depth range of the camera, the light clusters slice it exponentially
+const float CAMERA_NEAR_PLANE = 0.01f;
+const float CAMERA_FAR_PLANE = 1000.0f;
+
+// Light indices a frame can bin into the clusters, the ones past it are dropped
+const uint32_t MAX_CLUSTER_LIGHT_INDICES = 128 * 1024;
+
+// Lights are binned up to the distance their attenuation falls under this
+const float LIGHT_CUTOFF = 1.0f / 256.0f;
+
+// Storage buffers of the scene set bound with dynamic offsets, the object transforms, the visible instances, the lights,
+// their clusters and the shadow views, one more than maxDescriptorSetStorageBuffersDynamic guarantees
+const uint32_t SCENE_DYNAMIC_STORAGE_BUFFER_COUNT = 5;
+
+// Attachments of the deferred geometry subpass, in GBufferAttachment order
+const VkFormat GBUFFER_FORMATS[GBuffer_Count] = { VK_FORMAT_R8G8B8A8_UNORM, VK_FORMAT_A2B10G10R10_UNORM_PACK32 };
+
+// The cascades of the sun share a map two by two, the point and spot lights an atlas of equal tiles
+const uint32_t SHADOW_CASCADE_COUNT = 4;
+const uint32_t SHADOW_CASCADE_SIZE = 2048;
+const uint32_t SHADOW_ATLAS_SIZE = 4096;
+const uint32_t SHADOW_ATLAS_TILE_SIZE = 512;
+// By preference, the first one filtering its comparisons is used, every device renders to D16_UNORM and samples it
+const VkFormat SHADOW_MAP_FORMATS[] = { VK_FORMAT_D16_UNORM, VK_FORMAT_D32_SFLOAT };
+
+// The cascades cover the view up to SHADOW_DISTANCE, their splits blend the logarithmic and the uniform ones
+const float SHADOW_DISTANCE = 100.0f;
+const float SHADOW_CASCADE_LOG_WEIGHT = 0.75f;
+// Near plane of the point and spot light views, their far plane is the light range
+const float SHADOW_NEAR_PLANE = 0.1f;
+// Widest spot cone with shadows, the perspective of its view degenerates near half a turn
+const float SHADOW_SPOT_MAX_ANGLE = glm::radians(170.0f);
+const float SHADOW_DEPTH_BIAS_CONSTANT = 1.25f;
+const float SHADOW_DEPTH_BIAS_SLOPE = 1.75f;
+
+// Compiled pipelines kept between runs, rebuilt when the driver or the device changes
+const char* PIPELINE_CACHE_PATH = "Build\\PipelineCache.bin";
+
 const std::vector<const char*> validationLayers = {
 	"VK_LAYER_KHRONOS_validation"
 };
@@ -83,6 +129,7 @@ static float s_AmbientLightIntensity = 0.3f;
 
 static float s_DirectionalLightColor[3] = { 255.0f / 255.0f, 239.0f / 255.0f, 230.0f / 255.0f }; // 5700 kelvin
 static float s_DirectionalLightIntensity = 0.7f;
+static float s_DirectionalLightDirection[3] = { -0.3f, -0.5f, -0.8f };
 
 //////////////////////////////////////////////////////////////////////////
 //                            Material Data                             //
@@ -91,6 +138,13 @@ static float s_MaterialColor[3] = { 1.0f, 1.0f, 1.0f };
 static float s_MaterialSpecularColor[3] = { 0.3f, 0.3f, 0.3f };
 static float s_MaterialRoughness = 0.5f;
 
+//////////////////////////////////////////////////////////////////////////
+//                           Render Settings                            //
+//////////////////////////////////////////////////////////////////////////
+static bool s_DeferredShading = false;
+static bool s_DepthPrepass = true;
+static int s_ShadowUpdateBudget = 6; // shadow views rendered per frame at most, enough for the cascades to follow the camera
+
 //////////////////////////////////////////////////////////////////////////
 //                         Vulkan Debug Layer                           //
 //////////////////////////////////////////////////////////////////////////
@@ -148,34 +202,68 @@ void Renderer::Shutdown()
 
 	CleanupSwapChain();
 
-	for (std::unique_ptr<Texture>& texture : mScene->Textures)
+	for (auto& pipeline : mGraphicsPipelines)
+	{
+		vkDestroyPipeline(mDevice, pipeline.second, nullptr);
+	}
+	vkDestroyShaderModule(mDevice, mFragShaderModule, nullptr);
+	vkDestroyShaderModule(mDevice, mVertShaderModule, nullptr);
+	vkDestroyShaderModule(mDevice, mDepthShaderModule, nullptr);
+	vkDestroyShaderModule(mDevice, mGBufferShaderModule, nullptr);
+	vkDestroyShaderModule(mDevice, mShadowShaderModule, nullptr);
+	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
+	vkDestroyPipeline(mDevice, mCullPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mCullPipelineLayout, nullptr);
+	vkDestroyPipeline(mDevice, mLightingPipeline, nullptr);
+	vkDestroyPipelineLayout(mDevice, mLightingPipelineLayout, nullptr);
+	vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+	vkDestroyRenderPass(mDevice, mDeferredRenderPass, nullptr);
+	vkDestroyRenderPass(mDevice, mOverlayRenderPass, nullptr);
+	vkDestroyRenderPass(mDevice, mShadowRenderPass, nullptr);
+
+	for (ShadowMap& shadowMap : mShadowMaps)
 	{
-		vkDestroySampler(mDevice, texture->TextureSampler, nullptr);
-		vkDestroyImageView(mDevice, texture->TextureImageView, nullptr);
+		vkDestroyFramebuffer(mDevice, shadowMap.Framebuffer, nullptr);
+		vkDestroyImageView(mDevice, shadowMap.ImageView, nullptr);
+		vkDestroyImage(mDevice, shadowMap.Image, nullptr);
+		mMemoryAllocator.Free(shadowMap.ImageMemory);
+	}
+	vkDestroySampler(mDevice, mShadowSampler, nullptr);
 
-		vkDestroyImage(mDevice, texture->TextureImage, nullptr);
-		vkFreeMemory(mDevice, texture->TextureImageMemory, nullptr);
+	for (std::unique_ptr<Texture>& texture : mScene->Textures)
+	{
+		DestroyTexture(texture.get());
 	}
+	DestroyTexture(mWhiteTexture.get());
 
 	//for (std::unique_ptr<Material>& material : mScene->Materials)
 	//{
 	//	vkFreeDescriptorSets(mDevice, mDescriptorPool, 1, &material->DescriptorSets);
 	//}
 
-	for (std::unique_ptr<Model>& model : mScene->Models)
-	{
-		vkDestroyBuffer(mDevice, model->VertexBuffer, nullptr);
-		vkFreeMemory(mDevice, model->VertexBufferMemory, nullptr);
-		vkDestroyBuffer(mDevice, model->IndexBuffer, nullptr);
-		vkFreeMemory(mDevice, model->IndexBufferMemory, nullptr);
-	}
+	vkDestroyBuffer(mDevice, mSceneVertexBuffer, nullptr);
+	mMemoryAllocator.Free(mSceneVertexBufferMemory);
+	vkDestroyBuffer(mDevice, mSceneIndexBuffer, nullptr);
+	mMemoryAllocator.Free(mSceneIndexBufferMemory);
+	vkDestroyBuffer(mDevice, mScenePositionBuffer, nullptr);
+	mMemoryAllocator.Free(mScenePositionBufferMemory);
+
+	vkDestroyBuffer(mDevice, mCullInstanceBuffer, nullptr);
+	mMemoryAllocator.Free(mCullInstanceBufferMemory);
+	vkDestroyBuffer(mDevice, mDrawCommandTemplateBuffer, nullptr);
+	mMemoryAllocator.Free(mDrawCommandTemplateBufferMemory);
+	vkDestroyBuffer(mDevice, mDrawCommandBuffer, nullptr);
+	mMemoryAllocator.Free(mDrawCommandBufferMemory);
+	vkDestroyBuffer(mDevice, mVisibleInstanceBuffer, nullptr);
+	mMemoryAllocator.Free(mVisibleInstanceBufferMemory);
 
 	vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);
 	vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
 	vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout2, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mCullDescriptorSetLayout, nullptr);
+	vkDestroyDescriptorSetLayout(mDevice, mGBufferDescriptorSetLayout, nullptr);
 
-	vkDestroyBuffer(mDevice, mUniformBuffers, nullptr);
-	vkFreeMemory(mDevice, mUniformBuffersMemory, nullptr);
+	mFrameConstants.Shutdown(mDevice, mMemoryAllocator);
 
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
@@ -186,6 +274,15 @@ void Renderer::Shutdown()
 	}
 
 	vkDestroyCommandPool(mDevice, mCommandPool, nullptr);
+	vkDestroyQueryPool(mDevice, mTimestampQueryPool, nullptr);
+
+	for (FrameData& frameData : mFrameData)
+	{
+		mUploadQueue.ReleaseSemaphores(frameData.UploadSemaphores);
+	}
+	mUploadQueue.Shutdown();
+	mPipelineCache.Shutdown();
+	mMemoryAllocator.Shutdown();
 	vkDestroyDevice(mDevice, nullptr);
 
 	if (s_enableValidationLayers)
@@ -230,6 +327,7 @@ void Renderer::FrameUpdate(float deltaTime)
 
 		ImGui::ColorEdit3("Light Color", s_DirectionalLightColor);
 		ImGui::DragFloat("Light Intensity", &s_DirectionalLightIntensity, 0.01f);
+		ImGui::DragFloat3("Light Direction", s_DirectionalLightDirection, 0.01f, -1.0f, 1.0f);
 
 		ImGui::Separator(); // -----------------------------------------------
 
@@ -237,6 +335,35 @@ void Renderer::FrameUpdate(float deltaTime)
 		ImGui::ColorEdit3("Material Specular Color", s_MaterialSpecularColor);
 		ImGui::DragFloat("Material Roughness", &s_MaterialRoughness, 0.01f, 0.0f, 1.0f);
 
+		ImGui::Separator(); // -----------------------------------------------
+
+		ImGui::Checkbox("Deferred Shading", &s_DeferredShading);
+		ImGui::Checkbox("Depth Pre-pass", &s_DepthPrepass);
+		ImGui::SliderInt("Shadow Updates", &s_ShadowUpdateBudget, 1, 16);
+		ImGui::Text("Shadow Views: %u / %u updated", static_cast<uint32_t>(mUpdatedShadowViews.size()), static_cast<uint32_t>(mShadowViews.size()));
+		if (mTimestampQueryPool != VK_NULL_HANDLE)
+		{
+			ImGui::Text("GPU Cull: %.3f ms", mGpuTimes[GpuTimer_Cull]);
+			ImGui::Text("GPU Shadows: %.3f ms", mGpuTimes[GpuTimer_Shadows]);
+			ImGui::Text("GPU Depth Pre-pass: %.3f ms", mGpuTimes[GpuTimer_DepthPrepass]);
+			ImGui::Text("GPU Geometry: %.3f ms", mGpuTimes[GpuTimer_Geometry]);
+			ImGui::Text("GPU Lighting: %.3f ms", mGpuTimes[GpuTimer_Lighting]);
+		}
+
+		ImGui::Separator(); // -----------------------------------------------
+
+		static std::vector<W::VK::MemoryPoolStatistics> s_memoryStatistics;
+		mMemoryAllocator.GetStatistics(s_memoryStatistics);
+
+		const float megaByte = 1024.0f * 1024.0f;
+		ImGui::Text("Device Memory Allocations: %u / %u", mMemoryAllocator.GetDeviceMemoryCount(), mMemoryAllocator.GetMaxDeviceMemoryCount());
+		for (const W::VK::MemoryPoolStatistics& pool : s_memoryStatistics)
+		{
+			const W::Memory::AllocatorStatistics& statistics = pool.Statistics;
+			ImGui::Text("Type %u %s: %u blocks, %u allocations", pool.MemoryTypeIndex, (pool.Tiling == W::VK::ResourceTiling::Linear) ? "Linear" : "Optimal", pool.BlockCount, statistics.AllocationCount);
+			ImGui::Text("  used %.2f MB, free %.2f MB, fragmentation %.2f", statistics.UsedSize / megaByte, statistics.FreeSize / megaByte, statistics.GetFragmentation());
+		}
+
 		ImGui::PopItemWidth();
 	}
 	ImGui::End();
@@ -251,17 +378,24 @@ void Renderer::FrameRender()
 	FrameData& frameData = mFrameData[mCurrentFrame];
 
 	vkWaitForFences(mDevice, 1, &frameData.Fence, VK_TRUE, std::numeric_limits<uint64_t>::max());
-	vkResetFences(mDevice, 1, &frameData.Fence);
 
+	DestroyRetiredSwapChains();
+	mFrameConstants.Release(frameData.ConstantsHead);
+	ReadTimestamps(frameData);
+	mUploadQueue.ReleaseSemaphores(frameData.UploadSemaphores);
+	mUploadQueue.Update();
+
+	// the semaphore is not signaled when the swap chain is out of date, acquire again from the new one
 	VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, std::numeric_limits<uint64_t>::max(), frameData.ImageAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
-	if (result == VK_ERROR_OUT_OF_DATE_KHR)
+	while (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		RecreateSwapChain();
+		result = vkAcquireNextImageKHR(mDevice, mSwapChain, std::numeric_limits<uint64_t>::max(), frameData.ImageAcquiredSemaphore, VK_NULL_HANDLE, &imageIndex);
 	}
-	else
-	{
-		Debug_AssertMsg(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "failed to acquire swap chain image!");
-	}
+	Debug_AssertMsg(result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR, "failed to acquire swap chain image!");
+
+	// reset once a submission is certain to signal it again
+	vkResetFences(mDevice, 1, &frameData.Fence);
 
 	{
 		VkCommandBufferBeginInfo info = {};
@@ -270,74 +404,237 @@ void Renderer::FrameRender()
 		VK_CHECK(vkBeginCommandBuffer(frameData.CommandBuffer, &info));
 	}
 
-	UpdateUniformBuffer(frameData.CommandBuffer);
+	// Take ownership of the completed uploads, the frame only waits for copies that are already done
+	mUploadQueue.Acquire(frameData.CommandBuffer, frameData.UploadSemaphores);
+
+	for (auto texture = mPendingTextures.begin(); texture != mPendingTextures.end();)
+	{
+		if ((*texture)->UploadSerial <= mUploadQueue.GetAcquiredSerial())
+		{
+			//transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+			GenerateMipmaps(frameData.CommandBuffer, (*texture)->TextureImage, VK_FORMAT_R8G8B8A8_UNORM, (*texture)->TextureWidth, (*texture)->TextureHeight, (*texture)->MipLevels);
+			(*texture)->IsResident = true;
+			texture = mPendingTextures.erase(texture);
+		}
+		else
+		{
+			++texture;
+		}
+	}
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	uint32_t uniformBufferOffset = UpdateUniformBuffer(view, projection);
+	const glm::mat4 viewProjection = projection * view;
+	uint32_t objectTransformsOffset = UpdateObjectTransforms(viewProjection);
+
+	uint32_t lightsOffset;
+	uint32_t lightClustersOffset;
+	UpdateLightClusters(view, projection, lightsOffset, lightClustersOffset);
+
+	// The draws are built on the GPU once the scene buffers are resident
+	const bool isSceneResident = mInstanceModels.empty() == false && mSceneUploadSerial <= mUploadQueue.GetAcquiredSerial();
+	uint32_t shadowViewsOffset = UpdateShadowViews(view, projection, isSceneResident);
+
+	// dynamic offsets in binding order, the frame constants, the object transforms, the visible instances, the lights, their clusters and the shadow views
+	const uint32_t drawCommandsOffset = static_cast<uint32_t>(mCurrentFrame * mDrawCommandRegionSize);
+	const uint32_t visibleInstancesOffset = static_cast<uint32_t>(mCurrentFrame * mVisibleInstanceRegionSize);
+	std::array<uint32_t, 6> dynamicOffsets = { uniformBufferOffset, objectTransformsOffset, visibleInstancesOffset, lightsOffset, lightClustersOffset, shadowViewsOffset };
+
+	if (mTimestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkCmdResetQueryPool(frameData.CommandBuffer, mTimestampQueryPool, mCurrentFrame * (GpuTimer_Count + 1), GpuTimer_Count + 1);
+		frameData.HasTimestamps = true;
+	}
+
+	WriteTimestamp(frameData.CommandBuffer, 0);
+	if (isSceneResident)
+	{
+		CullInstances(frameData.CommandBuffer, viewProjection, objectTransformsOffset, drawCommandsOffset, visibleInstancesOffset);
+	}
+	WriteTimestamp(frameData.CommandBuffer, GpuTimer_Cull + 1);
+
+	// the shadow views left dirty by the frame budget keep their cached tiles
+	RenderShadowViews(frameData.CommandBuffer, dynamicOffsets.data(), static_cast<uint32_t>(dynamicOffsets.size()));
+	WriteTimestamp(frameData.CommandBuffer, GpuTimer_Shadows + 1);
+
+	// the deferred path draws the same scene into the G-buffer, then lights every pixel once in its second subpass
+	const bool isDeferred = s_DeferredShading;
+	const uint32_t pathFeatures = isDeferred ? ShaderFeature_GBuffer : 0;
 
 	{
 		VkRenderPassBeginInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		info.renderPass = mRenderPass;
-		info.framebuffer = mSwapChainFramebuffers[imageIndex];
+		info.renderPass = isDeferred ? mDeferredRenderPass : mRenderPass;
+		info.framebuffer = isDeferred ? mDeferredFramebuffers[imageIndex] : mSwapChainFramebuffers[imageIndex];
 		info.renderArea.offset = { 0, 0 };
 		info.renderArea.extent = mSwapChainExtent;
 
-		std::array<VkClearValue, 2> clearValues = {};
+		// the G-buffer is cleared to zero, the lighting skips the pixels without a surface
+		std::array<VkClearValue, 2 + GBuffer_Count> clearValues = {};
 		clearValues[0].color = s_BackgroundColor;
 		clearValues[1].depthStencil = { 1.0f, 0 };
 
-		info.clearValueCount = static_cast<uint32_t>(clearValues.size());
+		info.clearValueCount = isDeferred ? static_cast<uint32_t>(clearValues.size()) : 2;
 		info.pClearValues = clearValues.data();
 		vkCmdBeginRenderPass(frameData.CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
 	}
 
-	vkCmdBindPipeline(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
+	{
+		VkViewport viewport = {};
+		viewport.x = 0.0f;
+		viewport.y = 0.0f;
+		viewport.width = (float)mSwapChainExtent.width;
+		viewport.height = (float)mSwapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+		vkCmdSetViewport(frameData.CommandBuffer, 0, 1, &viewport);
+
+		VkRect2D scissor = {};
+		scissor.offset = { 0, 0 };
+		scissor.extent = mSwapChainExtent;
+		vkCmdSetScissor(frameData.CommandBuffer, 0, 1, &scissor);
+	}
+
+	// the materials are drawn once their descriptor set and texture are ready
+	auto isMaterialDrawn = [this](const MaterialDraws& materialDraws)
+	{
+		const Material* material = mScene->Materials[materialDraws.MaterialIndex].get();
+		const Texture* texture = (material->DiffuseTexture != nullptr) ? material->DiffuseTexture : mWhiteTexture.get();
+		return material->DescriptorSets != VK_NULL_HANDLE && texture->IsResident;
+	};
+
+	// draws the culling pass left without instances cost nothing
+	auto drawIndexedIndirect = [&](uint32_t firstDraw, uint32_t drawCount)
+	{
+		const VkDeviceSize commandOffset = drawCommandsOffset + firstDraw * sizeof(VkDrawIndexedIndirectCommand);
+		if (mMultiDrawIndirect)
+		{
+			vkCmdDrawIndexedIndirect(frameData.CommandBuffer, mDrawCommandBuffer, commandOffset, drawCount, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else
+		{
+			for (uint32_t i = 0; i < drawCount; ++i)
+			{
+				vkCmdDrawIndexedIndirect(frameData.CommandBuffer, mDrawCommandBuffer, commandOffset + i * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	};
 
-	for (std::unique_ptr<Model>& model : mScene->Models)
+	// the draws of the materials the geometry pass shades, in as few indirect draws as possible, the forward pass then only
+	// shades the fragments that are kept, a material still streaming in would otherwise hide what is behind it
+	const bool isDepthPrepass = isSceneResident && s_DepthPrepass;
+	if (isDepthPrepass)
 	{
-		VkBuffer vertexBuffers[] = { model->VertexBuffer };
-		VkDeviceSize offsets[] = { 0 };
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(frameData.CommandBuffer, 0, 1, &mScenePositionBuffer, &offset);
+		vkCmdBindIndexBuffer(frameData.CommandBuffer, mSceneIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+		vkCmdBindPipeline(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetGraphicsPipeline(ShaderFeature_DepthOnly | pathFeatures));
+		vkCmdBindDescriptorSets(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mSceneDescriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+
+		// the draws of a material follow the ones of the previous material
+		for (size_t i = 0; i < mMaterialDraws.size();)
+		{
+			if (isMaterialDrawn(mMaterialDraws[i]) == false)
+			{
+				++i;
+				continue;
+			}
 
-		vkCmdBindVertexBuffers(frameData.CommandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(frameData.CommandBuffer, model->IndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			const uint32_t firstDraw = mMaterialDraws[i].FirstDraw;
+			uint32_t drawCount = 0;
+			for (; i < mMaterialDraws.size() && isMaterialDrawn(mMaterialDraws[i]); ++i)
+			{
+				drawCount += mMaterialDraws[i].DrawCount;
+			}
+			drawIndexedIndirect(firstDraw, drawCount);
+		}
+	}
+	WriteTimestamp(frameData.CommandBuffer, GpuTimer_DepthPrepass + 1);
 
-		UniformPushConstant uniformPushConstant = {};
-		uniformPushConstant.Model = model->WorldTransform;
-		vkCmdPushConstants(frameData.CommandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UniformPushConstant), &uniformPushConstant);
+	if (isSceneResident)
+	{
+		VkDeviceSize offset = 0;
+		vkCmdBindVertexBuffers(frameData.CommandBuffer, 0, 1, &mSceneVertexBuffer, &offset);
+		vkCmdBindIndexBuffer(frameData.CommandBuffer, mSceneIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
 
-		for (const Mesh& mesh : model->Meshs)
+		const uint32_t depthFeatures = isDepthPrepass ? ShaderFeature_DepthEqual : 0;
+		VkPipeline boundPipeline = VK_NULL_HANDLE;
+		for (const MaterialDraws& materialDraws : mMaterialDraws)
 		{
-			Material* material = mScene->Materials[mesh.MaterialIndex].get();
-			if (material->DescriptorSets == VK_NULL_HANDLE)
+			if (isMaterialDrawn(materialDraws) == false)
 				continue;
 
-			// set the material for the mesh
-			vkCmdBindDescriptorSets(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &material->DescriptorSets, 0, nullptr);
+			Material* material = mScene->Materials[materialDraws.MaterialIndex].get();
+
+			VkPipeline pipeline = GetGraphicsPipeline(material->ShaderFeatures | depthFeatures | pathFeatures);
+			if (pipeline != boundPipeline)
+			{
+				vkCmdBindPipeline(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				boundPipeline = pipeline;
+			}
 
-			// draw the mesh's index buffer
-			vkCmdDrawIndexed(frameData.CommandBuffer, static_cast<uint32_t>(mesh.TriangleCount * 3), 1, static_cast<uint32_t>(mesh.IndexOffset), 0, 0);
+			vkCmdBindDescriptorSets(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &material->DescriptorSets, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+			drawIndexedIndirect(materialDraws.FirstDraw, materialDraws.DrawCount);
 		}
 	}
 
+	WriteTimestamp(frameData.CommandBuffer, GpuTimer_Geometry + 1);
+
+	if (isDeferred)
+	{
+		vkCmdNextSubpass(frameData.CommandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+
+		// the clustered lights are applied per pixel, their cost no longer depends on the overdraw
+		std::array<VkDescriptorSet, 2> descriptorSets = { mSceneDescriptorSet, mGBufferDescriptorSet };
+		vkCmdBindPipeline(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mLightingPipeline);
+		vkCmdBindDescriptorSets(frameData.CommandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mLightingPipelineLayout, 0, static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+		vkCmdDraw(frameData.CommandBuffer, 3, 1, 0, 0);
+
+		vkCmdEndRenderPass(frameData.CommandBuffer);
+
+		// the UI pipeline is built for the first subpass of mRenderPass, drawn in a compatible pass keeping the lit image
+		VkRenderPassBeginInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		info.renderPass = mOverlayRenderPass;
+		info.framebuffer = mSwapChainFramebuffers[imageIndex];
+		info.renderArea.offset = { 0, 0 };
+		info.renderArea.extent = mSwapChainExtent;
+		vkCmdBeginRenderPass(frameData.CommandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+	}
+
+	WriteTimestamp(frameData.CommandBuffer, GpuTimer_Lighting + 1);
+
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), frameData.CommandBuffer);
 
 	// Submit command buffer
 	vkCmdEndRenderPass(frameData.CommandBuffer);
 	VK_CHECK(vkEndCommandBuffer(frameData.CommandBuffer));
 
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	frameData.ConstantsHead = mFrameConstants.GetHead();
+
+	std::vector<VkSemaphore> waitSemaphores = { frameData.ImageAcquiredSemaphore };
+	std::vector<VkPipelineStageFlags> waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	for (VkSemaphore uploadSemaphore : frameData.UploadSemaphores)
+	{
+		waitSemaphores.push_back(uploadSemaphore);
+		waitStages.push_back(VK_PIPELINE_STAGE_TRANSFER_BIT);
+	}
 
 	{
 		VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		VkSubmitInfo info = {};
 		info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		info.waitSemaphoreCount = 1;
-		info.pWaitSemaphores = &frameData.ImageAcquiredSemaphore;
-		info.pWaitDstStageMask = waitStages;
+		info.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+		info.pWaitSemaphores = waitSemaphores.data();
+		info.pWaitDstStageMask = waitStages.data();
 		info.commandBufferCount = 1;
 		info.pCommandBuffers = &frameData.CommandBuffer;
 		info.signalSemaphoreCount = 1;
 		info.pSignalSemaphores = &frameData.RenderCompleteSemaphore;
 
 		VK_CHECK(vkQueueSubmit(mGraphicsQueue, 1, &info, frameData.Fence));
+		++mFrameCount;
 	}
 }
 
@@ -414,7 +711,7 @@ void Renderer::InitImGui()
 	init_info.Device = mDevice;
 	init_info.QueueFamily = FindQueueFamilies(mPhysicalDevice).GraphicsFamily;
 	init_info.Queue = mGraphicsQueue;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = mPipelineCache.GetHandle();
 	init_info.DescriptorPool = mDescriptorPool;
 	init_info.Allocator = nullptr;
 	init_info.MinImageCount = MAX_FRAMES_IN_FLIGHT;
@@ -461,40 +758,38 @@ void Renderer::InitVulkan()
 	CreateSurface();
 	PickPhysicalDevice();
 	CreateLogicalDevice();
+	CreateMemoryAllocator();
+	CreateUploadQueue();
+	CreatePipelineCache();
 	CreateSwapChain();
 	CreateImageViews();
 	CreateRenderPass();
+	CreateDeferredRenderPass();
 	CreateDescriptorSetLayout();
-	CreateGraphicsPipeline();
+	CreateGraphicsPipelineLayout();
+	CreateCullPipeline();
 	CreateCommandPool();
 	CreateDepthResources();
+	CreateGBufferResources();
+	CreateShadowResources();
 	CreateFramebuffers();
-	CreateUniformBuffers();
+	CreateFrameConstants();
 	CreateDescriptorPool();
 	CreateFrameData();
+	CreateTimestampQueries();
 }
 
 void Renderer::CleanupSwapChain()
 {
-	vkDestroyImageView(mDevice, mDepthImageView, nullptr);
-	vkDestroyImage(mDevice, mDepthImage, nullptr);
-	vkFreeMemory(mDevice, mDepthImageMemory, nullptr);
-
-	for (auto framebuffer : mSwapChainFramebuffers)
-	{
-		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
-	}
-
-	vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
-	vkDestroyPipelineLayout(mDevice, mPipelineLayout, nullptr);
-	vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+	RetireSwapChain();
 
-	for (auto imageView : mSwapChainImageViews)
+	for (RetiredSwapChain& swapChain : mRetiredSwapChains)
 	{
-		vkDestroyImageView(mDevice, imageView, nullptr);
+		DestroySwapChain(swapChain);
 	}
+	mRetiredSwapChains.clear();
 
-	vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
+	mSwapChain = VK_NULL_HANDLE;
 }
 
 void Renderer::RecreateSwapChain()
@@ -507,18 +802,98 @@ void Renderer::RecreateSwapChain()
 		glfwWaitEvents();
 	}
 
-	vkDeviceWaitIdle(mDevice);
-
-	CleanupSwapChain();
+	// The render pass and the pipelines do not depend on the extent, the frames in flight keep presenting
+	// the old swap chain, which is passed to the new one and destroyed once they are complete
+	RetireSwapChain();
 
 	CreateSwapChain();
 	CreateImageViews();
-	CreateRenderPass();
-	CreateGraphicsPipeline();
 	CreateDepthResources();
+	CreateGBufferResources();
 	CreateFramebuffers();
 }
 
+void Renderer::RetireSwapChain()
+{
+	RetiredSwapChain swapChain;
+	swapChain.FrameCount = mFrameCount;
+	swapChain.SwapChain = mSwapChain;
+	swapChain.ImageViews = std::move(mSwapChainImageViews);
+	swapChain.Framebuffers = std::move(mSwapChainFramebuffers);
+	swapChain.DepthImage = mDepthImage;
+	swapChain.DepthImageMemory = mDepthImageMemory;
+	swapChain.DepthImageView = mDepthImageView;
+	swapChain.GBufferImages = mGBufferImages;
+	swapChain.GBufferImageMemory = mGBufferImageMemory;
+	swapChain.GBufferImageViews = mGBufferImageViews;
+	swapChain.DeferredFramebuffers = std::move(mDeferredFramebuffers);
+	swapChain.GBufferDescriptorPool = mGBufferDescriptorPool;
+
+	mSwapChainImageViews.clear();
+	mSwapChainFramebuffers.clear();
+	mDepthImage = VK_NULL_HANDLE;
+	mDepthImageMemory = W::VK::MemoryAllocation();
+	mDepthImageView = VK_NULL_HANDLE;
+	mGBufferImages.fill(VK_NULL_HANDLE);
+	mGBufferImageMemory.fill(W::VK::MemoryAllocation());
+	mGBufferImageViews.fill(VK_NULL_HANDLE);
+	mDeferredFramebuffers.clear();
+	mGBufferDescriptorPool = VK_NULL_HANDLE;
+	mGBufferDescriptorSet = VK_NULL_HANDLE;
+
+	mRetiredSwapChains.push_back(std::move(swapChain));
+}
+
+void Renderer::DestroyRetiredSwapChains()
+{
+	// Called after waiting for the fence of the current frame, every frame submitted before the last MAX_FRAMES_IN_FLIGHT - 1 ones is complete
+	for (auto swapChain = mRetiredSwapChains.begin(); swapChain != mRetiredSwapChains.end();)
+	{
+		if (swapChain->FrameCount + MAX_FRAMES_IN_FLIGHT - 1 <= mFrameCount)
+		{
+			DestroySwapChain(*swapChain);
+			swapChain = mRetiredSwapChains.erase(swapChain);
+		}
+		else
+		{
+			++swapChain;
+		}
+	}
+}
+
+void Renderer::DestroySwapChain(RetiredSwapChain& swapChain)
+{
+	vkDestroyImageView(mDevice, swapChain.DepthImageView, nullptr);
+	vkDestroyImage(mDevice, swapChain.DepthImage, nullptr);
+	mMemoryAllocator.Free(swapChain.DepthImageMemory);
+
+	// the descriptor set reading the G-buffer is freed with its pool
+	vkDestroyDescriptorPool(mDevice, swapChain.GBufferDescriptorPool, nullptr);
+	for (uint32_t i = 0; i < GBuffer_Count; ++i)
+	{
+		vkDestroyImageView(mDevice, swapChain.GBufferImageViews[i], nullptr);
+		vkDestroyImage(mDevice, swapChain.GBufferImages[i], nullptr);
+		mMemoryAllocator.Free(swapChain.GBufferImageMemory[i]);
+	}
+
+	for (auto framebuffer : swapChain.Framebuffers)
+	{
+		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+	}
+
+	for (auto framebuffer : swapChain.DeferredFramebuffers)
+	{
+		vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+	}
+
+	for (auto imageView : swapChain.ImageViews)
+	{
+		vkDestroyImageView(mDevice, imageView, nullptr);
+	}
+
+	vkDestroySwapchainKHR(mDevice, swapChain.SwapChain, nullptr);
+}
+
 void Renderer::CreateInstance()
 {
 	if (s_enableValidationLayers && !CheckValidationLayerSupport())
@@ -587,16 +962,37 @@ void Renderer::PickPhysicalDevice()
 	std::vector<VkPhysicalDevice> devices(deviceCount);
 	vkEnumeratePhysicalDevices(mInstance, &deviceCount, devices.data());
 
+	// Prefer hardware GPUs, a software implementation such as lavapipe is picked when it is the only one
+	auto getDeviceRank = [](VkPhysicalDevice device)
+	{
+		VkPhysicalDeviceProperties deviceProperties;
+		vkGetPhysicalDeviceProperties(device, &deviceProperties);
+
+		switch (deviceProperties.deviceType)
+		{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+		case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+		default: return 0;
+		}
+	};
+
+	int bestRank = -1;
 	for (const auto& device : devices)
 	{
-		if (IsDeviceSuitable(device))
+		if (IsDeviceSuitable(device) && getDeviceRank(device) > bestRank)
 		{
 			mPhysicalDevice = device;
-			break;
+			bestRank = getDeviceRank(device);
 		}
 	}
 
 	Debug_AssertMsg(mPhysicalDevice != VK_NULL_HANDLE, "failed to find a suitable GPU!");
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &deviceProperties);
+	W::Logger::PrintFormat("[Renderer] %s\n", deviceProperties.deviceName);
 }
 
 void Renderer::CreateLogicalDevice()
@@ -604,7 +1000,7 @@ void Renderer::CreateLogicalDevice()
 	QueueFamilyIndices indices = FindQueueFamilies(mPhysicalDevice);
 
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<int> uniqueQueueFamilies = { indices.GraphicsFamily, indices.PresentFamily };
+	std::set<int> uniqueQueueFamilies = { indices.GraphicsFamily, indices.PresentFamily, indices.TransferFamily };
 
 	float queuePriority = 1.0f;
 	for (int queueFamily : uniqueQueueFamilies)
@@ -617,8 +1013,16 @@ void Renderer::CreateLogicalDevice()
 		queueCreateInfos.push_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(mPhysicalDevice, &supportedFeatures);
+
+	// without multi draw indirect every material issues its indirect draws one by one
+	mMultiDrawIndirect = supportedFeatures.multiDrawIndirect == VK_TRUE;
+
 	VkPhysicalDeviceFeatures deviceFeatures = {};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
 
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -641,6 +1045,27 @@ void Renderer::CreateLogicalDevice()
 
 	vkGetDeviceQueue(mDevice, indices.GraphicsFamily, 0, &mGraphicsQueue);
 	vkGetDeviceQueue(mDevice, indices.PresentFamily, 0, &mPresentQueue);
+	vkGetDeviceQueue(mDevice, indices.TransferFamily, 0, &mTransferQueue);
+
+	W::Logger::PrintFormat("[Renderer] uploads on the %s queue family %d\n", (indices.TransferFamily != indices.GraphicsFamily) ? "transfer" : "graphics", indices.TransferFamily);
+}
+
+void Renderer::CreateMemoryAllocator()
+{
+	mMemoryAllocator.Initialize(mPhysicalDevice, mDevice);
+}
+
+void Renderer::CreateUploadQueue()
+{
+	QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(mPhysicalDevice);
+
+	VK_CHECK(mUploadQueue.Initialize(mDevice, mMemoryAllocator, mTransferQueue, queueFamilyIndices.TransferFamily, queueFamilyIndices.GraphicsFamily, STAGING_BUFFER_SIZE));
+}
+
+void Renderer::CreatePipelineCache()
+{
+	VK_CHECK(mPipelineCache.Initialize(mPhysicalDevice, mDevice, PIPELINE_CACHE_PATH));
+	W::Logger::PrintFormat("[Renderer] pipeline cache %s: %llu bytes loaded\n", PIPELINE_CACHE_PATH, (unsigned long long)mPipelineCache.GetLoadedSize());
 }
 
 void Renderer::CreateSwapChain()
@@ -686,6 +1111,7 @@ void Renderer::CreateSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
+	createInfo.oldSwapchain = mSwapChain;
 
 	VK_CHECK(vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain));
 
@@ -746,13 +1172,14 @@ void Renderer::CreateRenderPass()
 	subpass.pColorAttachments = &colorAttachmentRef;
 	subpass.pDepthStencilAttachment = &depthAttachmentRef;
 
+	// the depth was last read as an input attachment when the previous frame was deferred
 	VkSubpassDependency dependency = {};
 	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
 	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependency.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
 
 	std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
 	VkRenderPassCreateInfo renderPassInfo = {};
@@ -765,6 +1192,112 @@ void Renderer::CreateRenderPass()
 	renderPassInfo.pDependencies = &dependency;
 
 	VK_CHECK(vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mRenderPass));
+
+	// Same attachments and subpass, the UI is drawn over the image the deferred pass lit
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+	dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VK_CHECK(vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mOverlayRenderPass));
+}
+
+void Renderer::CreateDeferredRenderPass()
+{
+	VkFormat depthFormat;
+	::W::VK::GetSupportedDepthFormat(mPhysicalDevice, depthFormat);
+
+	// the swap chain image, the depth then the G-buffer, as in mDeferredFramebuffers
+	std::array<VkAttachmentDescription, 2 + GBuffer_Count> attachments = {};
+	for (VkAttachmentDescription& attachment : attachments)
+	{
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	// kept for the overlay pass
+	attachments[0].format = mSwapChainImageFormat;
+	attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	attachments[1].format = depthFormat;
+	attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	// cleared, the alpha of the normal marks the pixels a surface was written to
+	attachments[2 + GBuffer_Albedo].format = GBUFFER_FORMATS[GBuffer_Albedo];
+	attachments[2 + GBuffer_Albedo].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[2 + GBuffer_Normal].format = GBUFFER_FORMATS[GBuffer_Normal];
+	attachments[2 + GBuffer_Normal].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+
+	std::array<VkAttachmentReference, GBuffer_Count> gbufferAttachmentRefs = {};
+	std::array<VkAttachmentReference, GBuffer_Count + 1> inputAttachmentRefs = {};
+	for (uint32_t i = 0; i < GBuffer_Count; ++i)
+	{
+		gbufferAttachmentRefs[i] = { 2 + i, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		inputAttachmentRefs[i] = { 2 + i, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+	}
+	inputAttachmentRefs[GBuffer_Count] = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+
+	VkAttachmentReference colorAttachmentRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+	VkAttachmentReference depthAttachmentRef = { 1, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL };
+
+	// the input attachment indices follow the bindings of deferred.frag
+	std::array<VkSubpassDescription, 2> subpasses = {};
+	subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[0].colorAttachmentCount = static_cast<uint32_t>(gbufferAttachmentRefs.size());
+	subpasses[0].pColorAttachments = gbufferAttachmentRefs.data();
+	subpasses[0].pDepthStencilAttachment = &depthAttachmentRef;
+
+	subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[1].inputAttachmentCount = static_cast<uint32_t>(inputAttachmentRefs.size());
+	subpasses[1].pInputAttachments = inputAttachmentRefs.data();
+	subpasses[1].colorAttachmentCount = 1;
+	subpasses[1].pColorAttachments = &colorAttachmentRef;
+
+	std::array<VkSubpassDependency, 3> dependencies = {};
+
+	// the previous frame read the G-buffer and the depth, and the presentation engine the swap chain image
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].dstSubpass = 1;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].srcAccessMask = 0;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	// each pixel is lit from the G-buffer texels it covers
+	dependencies[2].srcSubpass = 0;
+	dependencies[2].dstSubpass = 1;
+	dependencies[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+	dependencies[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+	renderPassInfo.pAttachments = attachments.data();
+	renderPassInfo.subpassCount = static_cast<uint32_t>(subpasses.size());
+	renderPassInfo.pSubpasses = subpasses.data();
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+
+	VK_CHECK(vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mDeferredRenderPass));
 }
 
 void Renderer::CreateDescriptorSetLayout()
@@ -772,7 +1305,7 @@ void Renderer::CreateDescriptorSetLayout()
 	VkDescriptorSetLayoutBinding uboLayoutBinding = {};
 	uboLayoutBinding.binding = 0;
 	uboLayoutBinding.descriptorCount = 1;
-	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
 
@@ -783,7 +1316,53 @@ void Renderer::CreateDescriptorSetLayout()
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+	VkDescriptorSetLayoutBinding objectLayoutBinding = {};
+	objectLayoutBinding.binding = 2;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	objectLayoutBinding.pImmutableSamplers = nullptr;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutBinding visibleInstanceLayoutBinding = {};
+	visibleInstanceLayoutBinding.binding = 3;
+	visibleInstanceLayoutBinding.descriptorCount = 1;
+	visibleInstanceLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	visibleInstanceLayoutBinding.pImmutableSamplers = nullptr;
+	visibleInstanceLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+	VkDescriptorSetLayoutBinding lightLayoutBinding = {};
+	lightLayoutBinding.binding = 4;
+	lightLayoutBinding.descriptorCount = 1;
+	lightLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	lightLayoutBinding.pImmutableSamplers = nullptr;
+	lightLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding lightClusterLayoutBinding = {};
+	lightClusterLayoutBinding.binding = 5;
+	lightClusterLayoutBinding.descriptorCount = 1;
+	lightClusterLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	lightClusterLayoutBinding.pImmutableSamplers = nullptr;
+	lightClusterLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorSetLayoutBinding shadowViewLayoutBinding = {};
+	shadowViewLayoutBinding.binding = 6; // the last of the SCENE_DYNAMIC_STORAGE_BUFFER_COUNT buffers
+	shadowViewLayoutBinding.descriptorCount = 1;
+	shadowViewLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	shadowViewLayoutBinding.pImmutableSamplers = nullptr;
+	shadowViewLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// the cascades then the atlas
+	VkDescriptorSetLayoutBinding shadowMapLayoutBindings[ShadowMap_Count] = {};
+	for (uint32_t i = 0; i < ShadowMap_Count; ++i)
+	{
+		shadowMapLayoutBindings[i].binding = 7 + i;
+		shadowMapLayoutBindings[i].descriptorCount = 1;
+		shadowMapLayoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		shadowMapLayoutBindings[i].pImmutableSamplers = nullptr;
+		shadowMapLayoutBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	std::array<VkDescriptorSetLayoutBinding, 9> bindings = { uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding, visibleInstanceLayoutBinding, lightLayoutBinding, lightClusterLayoutBinding, shadowViewLayoutBinding, shadowMapLayoutBindings[ShadowMap_Cascades], shadowMapLayoutBindings[ShadowMap_Atlas] };
 	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
@@ -797,12 +1376,50 @@ void Renderer::CreateDescriptorSetLayout()
 	layoutInfo2.pBindings = &samplerLayoutBinding;
 
 	VK_CHECK(vkCreateDescriptorSetLayout(mDevice, &layoutInfo2, nullptr, &mDescriptorSetLayout2));
+
+	// culling pass, reads the object transforms and bounds, writes the draw commands and the visible instances
+	std::array<VkDescriptorSetLayoutBinding, 4> cullBindings = {};
+	for (uint32_t i = 0; i < cullBindings.size(); ++i)
+	{
+		cullBindings[i].binding = i;
+		cullBindings[i].descriptorCount = 1;
+		cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		cullBindings[i].pImmutableSamplers = nullptr;
+		cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+	cullBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+
+	VkDescriptorSetLayoutCreateInfo cullLayoutInfo = {};
+	cullLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	cullLayoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+	cullLayoutInfo.pBindings = cullBindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(mDevice, &cullLayoutInfo, nullptr, &mCullDescriptorSetLayout));
+
+	// deferred lighting, reads the G-buffer then the depth at the pixel it lights
+	std::array<VkDescriptorSetLayoutBinding, GBuffer_Count + 1> gbufferBindings = {};
+	for (uint32_t i = 0; i < gbufferBindings.size(); ++i)
+	{
+		gbufferBindings[i].binding = i;
+		gbufferBindings[i].descriptorCount = 1;
+		gbufferBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		gbufferBindings[i].pImmutableSamplers = nullptr;
+		gbufferBindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo gbufferLayoutInfo = {};
+	gbufferLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	gbufferLayoutInfo.bindingCount = static_cast<uint32_t>(gbufferBindings.size());
+	gbufferLayoutInfo.pBindings = gbufferBindings.data();
+
+	VK_CHECK(vkCreateDescriptorSetLayout(mDevice, &gbufferLayoutInfo, nullptr, &mGBufferDescriptorSetLayout));
 }
 
 void Renderer::CreateMaterial(Material * material)
 {
-	if (material->DiffuseTexture == nullptr)
-		return;
+	Texture* texture = (material->DiffuseTexture != nullptr) ? material->DiffuseTexture : mWhiteTexture.get();
+	material->ShaderFeatures = mSceneShaderFeatures | ((material->DiffuseTexture != nullptr) ? ShaderFeature_Textured : 0);
+	GetGraphicsPipeline(material->ShaderFeatures | (s_DepthPrepass ? ShaderFeature_DepthEqual : 0) | (s_DeferredShading ? ShaderFeature_GBuffer : 0));
 
 	std::vector<VkDescriptorSetLayout> layouts(mSwapChainImages.size(), mDescriptorSetLayout);
 	VkDescriptorSetAllocateInfo allocInfo = {};
@@ -813,57 +1430,232 @@ void Renderer::CreateMaterial(Material * material)
 
 	VK_CHECK(vkAllocateDescriptorSets(mDevice, &allocInfo, &material->DescriptorSets));
 
+	WriteDescriptorSet(material->DescriptorSets, texture);
+}
+
+void Renderer::CreateSceneDescriptorSet()
+{
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = mDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mDescriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(mDevice, &allocInfo, &mSceneDescriptorSet));
+
+	// the depth pre-pass reads the transforms and the deferred lighting the lights, the texture keeps the set complete
+	WriteDescriptorSet(mSceneDescriptorSet, mWhiteTexture.get());
+}
+
+void Renderer::WriteDescriptorSet(VkDescriptorSet descriptorSet, const Texture* texture)
+{
 	VkDescriptorBufferInfo bufferInfo = {};
-	bufferInfo.buffer = mUniformBuffers;
+	bufferInfo.buffer = mFrameConstants.GetBuffer();
 	bufferInfo.offset = 0;
 	bufferInfo.range = sizeof(UniformBufferObject);
 
+	VkDescriptorBufferInfo objectBufferInfo = {};
+	objectBufferInfo.buffer = mFrameConstants.GetBuffer();
+	objectBufferInfo.offset = 0;
+	objectBufferInfo.range = std::max<size_t>(mInstanceModels.size(), 1) * sizeof(W::Math::ObjectTransform);
+
+	VkDescriptorBufferInfo visibleInstanceBufferInfo = {};
+	visibleInstanceBufferInfo.buffer = mVisibleInstanceBuffer;
+	visibleInstanceBufferInfo.offset = 0;
+	visibleInstanceBufferInfo.range = std::max<size_t>(mInstanceModels.size(), 1) * sizeof(uint32_t);
+
+	VkDescriptorBufferInfo lightBufferInfo = {};
+	lightBufferInfo.buffer = mFrameConstants.GetBuffer();
+	lightBufferInfo.offset = 0;
+	lightBufferInfo.range = std::max<size_t>(mLights.size(), 1) * sizeof(LightConstants);
+
+	VkDescriptorBufferInfo lightClusterBufferInfo = {};
+	lightClusterBufferInfo.buffer = mFrameConstants.GetBuffer();
+	lightClusterBufferInfo.offset = 0;
+	lightClusterBufferInfo.range = mLightClusters.size() * sizeof(uint32_t);
+
+	VkDescriptorBufferInfo shadowViewBufferInfo = {};
+	shadowViewBufferInfo.buffer = mFrameConstants.GetBuffer();
+	shadowViewBufferInfo.offset = 0;
+	shadowViewBufferInfo.range = mShadowViews.size() * sizeof(glm::mat4);
+
 	VkDescriptorImageInfo imageInfo = {};
 	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	imageInfo.imageView = material->DiffuseTexture->TextureImageView;
-	imageInfo.sampler = material->DiffuseTexture->TextureSampler;
+	imageInfo.imageView = texture->TextureImageView;
+	imageInfo.sampler = texture->TextureSampler;
+
+	std::array<VkDescriptorImageInfo, ShadowMap_Count> shadowMapInfos = {};
+	for (uint32_t i = 0; i < ShadowMap_Count; ++i)
+	{
+		shadowMapInfos[i].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		shadowMapInfos[i].imageView = mShadowMaps[i].ImageView;
+		shadowMapInfos[i].sampler = mShadowSampler;
+	}
 
-	std::array<VkWriteDescriptorSet, 2> descriptorWrites = {};
+	std::array<VkWriteDescriptorSet, 8> descriptorWrites = {};
 
 	descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrites[0].dstSet = material->DescriptorSets;
+	descriptorWrites[0].dstSet = descriptorSet;
 	descriptorWrites[0].dstBinding = 0;
 	descriptorWrites[0].dstArrayElement = 0;
-	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	descriptorWrites[0].descriptorCount = 1;
 	descriptorWrites[0].pBufferInfo = &bufferInfo;
 
 	descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-	descriptorWrites[1].dstSet = material->DescriptorSets;
+	descriptorWrites[1].dstSet = descriptorSet;
 	descriptorWrites[1].dstBinding = 1;
 	descriptorWrites[1].dstArrayElement = 0;
 	descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	descriptorWrites[1].descriptorCount = 1;
 	descriptorWrites[1].pImageInfo = &imageInfo;
 
+	descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[2].dstSet = descriptorSet;
+	descriptorWrites[2].dstBinding = 2;
+	descriptorWrites[2].dstArrayElement = 0;
+	descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorWrites[2].descriptorCount = 1;
+	descriptorWrites[2].pBufferInfo = &objectBufferInfo;
+
+	descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[3].dstSet = descriptorSet;
+	descriptorWrites[3].dstBinding = 3;
+	descriptorWrites[3].dstArrayElement = 0;
+	descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorWrites[3].descriptorCount = 1;
+	descriptorWrites[3].pBufferInfo = &visibleInstanceBufferInfo;
+
+	descriptorWrites[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[4].dstSet = descriptorSet;
+	descriptorWrites[4].dstBinding = 4;
+	descriptorWrites[4].dstArrayElement = 0;
+	descriptorWrites[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorWrites[4].descriptorCount = 1;
+	descriptorWrites[4].pBufferInfo = &lightBufferInfo;
+
+	descriptorWrites[5].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[5].dstSet = descriptorSet;
+	descriptorWrites[5].dstBinding = 5;
+	descriptorWrites[5].dstArrayElement = 0;
+	descriptorWrites[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorWrites[5].descriptorCount = 1;
+	descriptorWrites[5].pBufferInfo = &lightClusterBufferInfo;
+
+	descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[6].dstSet = descriptorSet;
+	descriptorWrites[6].dstBinding = 6;
+	descriptorWrites[6].dstArrayElement = 0;
+	descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	descriptorWrites[6].descriptorCount = 1;
+	descriptorWrites[6].pBufferInfo = &shadowViewBufferInfo;
+
+	// bindings 7 and 8 are consecutive, written from one array
+	descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrites[7].dstSet = descriptorSet;
+	descriptorWrites[7].dstBinding = 7;
+	descriptorWrites[7].dstArrayElement = 0;
+	descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptorWrites[7].descriptorCount = static_cast<uint32_t>(shadowMapInfos.size());
+	descriptorWrites[7].pImageInfo = shadowMapInfos.data();
+
 	vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
-void Renderer::CreateGraphicsPipeline() {
+void Renderer::CreateGraphicsPipelineLayout()
+{
 	auto vertShaderCode = ReadFile("Data/Shaders/shader.vert.spv");
 	auto fragShaderCode = ReadFile("Data/Shaders/shader.frag.spv");
 
-	VkShaderModule vertShaderModule = CreateShaderModule(vertShaderCode);
-	VkShaderModule fragShaderModule = CreateShaderModule(fragShaderCode);
+	// kept for the pipelines specialized once the materials need them
+	mVertShaderModule = CreateShaderModule(vertShaderCode);
+	mFragShaderModule = CreateShaderModule(fragShaderCode);
+	mDepthShaderModule = CreateShaderModule(ReadFile("Data/Shaders/depth.vert.spv"));
+	mGBufferShaderModule = CreateShaderModule(ReadFile("Data/Shaders/gbuffer.frag.spv"));
+	mShadowShaderModule = CreateShaderModule(ReadFile("Data/Shaders/shadow.vert.spv"));
+
+	std::array<VkDescriptorSetLayout*, 2> sets = { &mDescriptorSetLayout , &mDescriptorSetLayout2 };
+
+	// the light view projection of the shadow draws
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(glm::mat4);
+
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(sets.size());
+	pipelineLayoutInfo.pSetLayouts = sets.front();
+	pipelineLayoutInfo.pushConstantRangeCount = 1;
+	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	VK_CHECK(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout));
+}
+
+VkPipeline Renderer::GetGraphicsPipeline(uint32_t shaderFeatures)
+{
+	auto pipeline = mGraphicsPipelines.find(shaderFeatures);
+	if (pipeline != mGraphicsPipelines.end())
+		return pipeline->second;
+
+	VkPipeline graphicsPipeline = CreateGraphicsPipeline(shaderFeatures);
+	mGraphicsPipelines.emplace(shaderFeatures, graphicsPipeline);
+	return graphicsPipeline;
+}
+
+VkPipeline Renderer::CreateGraphicsPipeline(uint32_t shaderFeatures) {
+	// constant_id order of shader.frag
+	ShaderSpecialization specialization = {};
+	specialization.LightTypes = shaderFeatures & ShaderFeature_LightTypes;
+	specialization.Textured = (shaderFeatures & ShaderFeature_Textured) ? VK_TRUE : VK_FALSE;
+	specialization.MaxClusterLights = static_cast<uint32_t>(mLightSpheres.size());
+
+	std::array<VkSpecializationMapEntry, 3> specializationEntries = {};
+	specializationEntries[0] = { 0, offsetof(ShaderSpecialization, LightTypes), sizeof(uint32_t) };
+	specializationEntries[1] = { 1, offsetof(ShaderSpecialization, Textured), sizeof(VkBool32) };
+	specializationEntries[2] = { 2, offsetof(ShaderSpecialization, MaxClusterLights), sizeof(uint32_t) };
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(ShaderSpecialization);
+	specializationInfo.pData = &specialization;
 
 	VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertShaderStageInfo.module = vertShaderModule;
+	vertShaderStageInfo.module = mVertShaderModule;
 	vertShaderStageInfo.pName = "main";
 
 	VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
 	fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragShaderStageInfo.module = fragShaderModule;
+	fragShaderStageInfo.module = mFragShaderModule;
 	fragShaderStageInfo.pName = "main";
+	fragShaderStageInfo.pSpecializationInfo = &specializationInfo;
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+	// the depth pre-pass has no fragment shader and transforms the positions like shader.vert
+	const bool isDepthOnly = (shaderFeatures & ShaderFeature_DepthOnly) != 0;
+	if (isDepthOnly)
+	{
+		vertShaderStageInfo.module = mDepthShaderModule;
+	}
+
+	// the deferred path writes the surface to the G-buffer, lit later by deferred.frag
+	const bool isGBuffer = (shaderFeatures & ShaderFeature_GBuffer) != 0;
+	if (isGBuffer)
+	{
+		fragShaderStageInfo.module = mGBufferShaderModule;
+	}
+
+	// the casters are transformed by the light view pushed with each shadow view
+	const bool isShadow = (shaderFeatures & ShaderFeature_Shadow) != 0;
+	if (isShadow)
+	{
+		vertShaderStageInfo.module = mShadowShaderModule;
+	}
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -900,39 +1692,42 @@ void Renderer::CreateGraphicsPipeline() {
 	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
 	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
+	// the scene positions stream
+	if (isDepthOnly)
+	{
+		bindingDescription.stride = sizeof(glm::vec3);
+		attributeDescriptions[0].offset = 0;
+		vertexInputInfo.vertexAttributeDescriptionCount = 1;
+	}
+
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
 	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
 	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 	inputAssembly.primitiveRestartEnable = VK_FALSE;
 
-	VkViewport viewport = {};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = (float)mSwapChainExtent.width;
-	viewport.height = (float)mSwapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-
-	VkRect2D scissor = {};
-	scissor.offset = { 0, 0 };
-	scissor.extent = mSwapChainExtent;
-
+	// set when drawing, the pipeline does not depend on the swap chain extent
 	VkPipelineViewportStateCreateInfo viewportState = {};
 	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
 	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
 
+	std::array<VkDynamicState, 3> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR, VK_DYNAMIC_STATE_DEPTH_BIAS };
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = isShadow ? 3 : 2;
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	// the shadow views render both faces, the scenes are not closed meshes, and are biased against acne
 	VkPipelineRasterizationStateCreateInfo rasterizer = {};
 	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
 	rasterizer.depthClampEnable = VK_FALSE;
 	rasterizer.rasterizerDiscardEnable = VK_FALSE;
 	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
 	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
+	rasterizer.cullMode = isShadow ? VK_CULL_MODE_NONE : VK_CULL_MODE_BACK_BIT;
 	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
+	rasterizer.depthBiasEnable = isShadow ? VK_TRUE : VK_FALSE;
 
 	VkPipelineMultisampleStateCreateInfo multisampling = {};
 	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
@@ -944,60 +1739,203 @@ void Renderer::CreateGraphicsPipeline() {
 	depthStencil.depthTestEnable = VK_TRUE;
 	depthStencil.depthWriteEnable = VK_TRUE;
 	depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
+
+	// only the visible fragments are shaded after the pre-pass
+	if (shaderFeatures & ShaderFeature_DepthEqual)
+	{
+		depthStencil.depthWriteEnable = VK_FALSE;
+		depthStencil.depthCompareOp = VK_COMPARE_OP_EQUAL;
+	}
 	depthStencil.depthBoundsTestEnable = VK_FALSE;
 	depthStencil.stencilTestEnable = VK_FALSE;
 
-	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
-	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-	colorBlendAttachment.blendEnable = VK_FALSE;
+	// one per color attachment of the subpass, the swap chain image or the G-buffer
+	std::array<VkPipelineColorBlendAttachmentState, GBuffer_Count> colorBlendAttachments = {};
+	for (VkPipelineColorBlendAttachmentState& colorBlendAttachment : colorBlendAttachments)
+	{
+		colorBlendAttachment.colorWriteMask = isDepthOnly ? 0 : (VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT);
+		colorBlendAttachment.blendEnable = VK_FALSE;
+	}
 
 	VkPipelineColorBlendStateCreateInfo colorBlending = {};
 	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 	colorBlending.logicOpEnable = VK_FALSE;
 	colorBlending.logicOp = VK_LOGIC_OP_COPY;
-	colorBlending.attachmentCount = 1;
-	colorBlending.pAttachments = &colorBlendAttachment;
+	colorBlending.attachmentCount = isShadow ? 0 : (isGBuffer ? static_cast<uint32_t>(colorBlendAttachments.size()) : 1);
+	colorBlending.pAttachments = colorBlendAttachments.data();
 	colorBlending.blendConstants[0] = 0.0f;
 	colorBlending.blendConstants[1] = 0.0f;
 	colorBlending.blendConstants[2] = 0.0f;
 	colorBlending.blendConstants[3] = 0.0f;
 
-	VkPushConstantRange pushConstantRange{};
-	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
-	pushConstantRange.offset = 0;
-	pushConstantRange.size = sizeof(UniformPushConstant);
+	VkGraphicsPipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineInfo.stageCount = isDepthOnly ? 1 : 2;
+	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.pVertexInputState = &vertexInputInfo;
+	pipelineInfo.pInputAssemblyState = &inputAssembly;
+	pipelineInfo.pViewportState = &viewportState;
+	pipelineInfo.pRasterizationState = &rasterizer;
+	pipelineInfo.pMultisampleState = &multisampling;
+	pipelineInfo.pDepthStencilState = &depthStencil;
+	pipelineInfo.pColorBlendState = &colorBlending;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = mPipelineLayout;
+	pipelineInfo.renderPass = isShadow ? mShadowRenderPass : (isGBuffer ? mDeferredRenderPass : mRenderPass);
+	pipelineInfo.subpass = 0;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	std::array<VkDescriptorSetLayout*, 2> sets = { &mDescriptorSetLayout , &mDescriptorSetLayout2 };
+	using TimePoint = std::chrono::steady_clock::time_point;
+	const TimePoint startTime = std::chrono::steady_clock::now();
+
+	VkPipeline pipeline;
+	VK_CHECK(vkCreateGraphicsPipelines(mDevice, mPipelineCache.GetHandle(), 1, &pipelineInfo, nullptr, &pipeline));
+
+	const float createTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+	W::Logger::PrintFormat("[Renderer] graphics pipeline 0x%03x created in %.2f ms\n", shaderFeatures, createTime);
+
+	return pipeline;
+}
+
+void Renderer::CreateCullPipeline()
+{
+	auto compShaderCode = ReadFile("Data/Shaders/cull.comp.spv");
+
+	VkShaderModule compShaderModule = CreateShaderModule(compShaderCode);
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(CullConstants);
 
 	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
 	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(sets.size());
-	pipelineLayoutInfo.pSetLayouts = sets.front();
+	pipelineLayoutInfo.setLayoutCount = 1;
+	pipelineLayoutInfo.pSetLayouts = &mCullDescriptorSetLayout;
 	pipelineLayoutInfo.pushConstantRangeCount = 1;
 	pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-	VK_CHECK(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mPipelineLayout));
+	VK_CHECK(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mCullPipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = compShaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = mCullPipelineLayout;
+	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+
+	VK_CHECK(vkCreateComputePipelines(mDevice, mPipelineCache.GetHandle(), 1, &pipelineInfo, nullptr, &mCullPipeline));
+
+	vkDestroyShaderModule(mDevice, compShaderModule, nullptr);
+}
+
+void Renderer::CreateLightingPipeline()
+{
+	VkShaderModule vertShaderModule = CreateShaderModule(ReadFile("Data/Shaders/fullscreen.vert.spv"));
+	VkShaderModule fragShaderModule = CreateShaderModule(ReadFile("Data/Shaders/deferred.frag.spv"));
+
+	// the scene set of the materials, then the G-buffer
+	std::array<VkDescriptorSetLayout, 2> sets = { mDescriptorSetLayout, mGBufferDescriptorSetLayout };
 
+	VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+	pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(sets.size());
+	pipelineLayoutInfo.pSetLayouts = sets.data();
+
+	VK_CHECK(vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mLightingPipelineLayout));
+
+	// constant_id order of deferred.frag, the same lights as the forward pipelines
+	ShaderSpecialization specialization = {};
+	specialization.LightTypes = mSceneShaderFeatures & ShaderFeature_LightTypes;
+	specialization.MaxClusterLights = static_cast<uint32_t>(mLightSpheres.size());
+
+	std::array<VkSpecializationMapEntry, 2> specializationEntries = {};
+	specializationEntries[0] = { 0, offsetof(ShaderSpecialization, LightTypes), sizeof(uint32_t) };
+	specializationEntries[1] = { 2, offsetof(ShaderSpecialization, MaxClusterLights), sizeof(uint32_t) };
+
+	VkSpecializationInfo specializationInfo = {};
+	specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+	specializationInfo.pMapEntries = specializationEntries.data();
+	specializationInfo.dataSize = sizeof(ShaderSpecialization);
+	specializationInfo.pData = &specialization;
+
+	std::array<VkPipelineShaderStageCreateInfo, 2> shaderStages = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertShaderModule;
+	shaderStages[0].pName = "main";
+
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragShaderModule;
+	shaderStages[1].pName = "main";
+	shaderStages[1].pSpecializationInfo = &specializationInfo;
+
+	// one triangle covering the screen, built from gl_VertexIndex
+	VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+	inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	std::array<VkDynamicState, 2> dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
+	dynamicState.pDynamicStates = dynamicStates.data();
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = VK_FALSE;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOpEnable = VK_FALSE;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	// the lighting subpass has no depth attachment, the depth is an input
 	VkGraphicsPipelineCreateInfo pipelineInfo = {};
 	pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineInfo.stageCount = 2;
-	pipelineInfo.pStages = shaderStages;
+	pipelineInfo.stageCount = static_cast<uint32_t>(shaderStages.size());
+	pipelineInfo.pStages = shaderStages.data();
 	pipelineInfo.pVertexInputState = &vertexInputInfo;
 	pipelineInfo.pInputAssemblyState = &inputAssembly;
 	pipelineInfo.pViewportState = &viewportState;
 	pipelineInfo.pRasterizationState = &rasterizer;
 	pipelineInfo.pMultisampleState = &multisampling;
-	pipelineInfo.pDepthStencilState = &depthStencil;
 	pipelineInfo.pColorBlendState = &colorBlending;
-	pipelineInfo.layout = mPipelineLayout;
-	pipelineInfo.renderPass = mRenderPass;
-	pipelineInfo.subpass = 0;
+	pipelineInfo.pDynamicState = &dynamicState;
+	pipelineInfo.layout = mLightingPipelineLayout;
+	pipelineInfo.renderPass = mDeferredRenderPass;
+	pipelineInfo.subpass = 1;
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-	VK_CHECK(vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mGraphicsPipeline));
+	VK_CHECK(vkCreateGraphicsPipelines(mDevice, mPipelineCache.GetHandle(), 1, &pipelineInfo, nullptr, &mLightingPipeline));
 
-	vkDestroyShaderModule(mDevice, fragShaderModule, nullptr);
 	vkDestroyShaderModule(mDevice, vertShaderModule, nullptr);
+	vkDestroyShaderModule(mDevice, fragShaderModule, nullptr);
 }
 
 void Renderer::CreateFramebuffers()
@@ -1023,6 +1961,30 @@ void Renderer::CreateFramebuffers()
 
 		VK_CHECK(vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &mSwapChainFramebuffers[i]));
 	}
+
+	mDeferredFramebuffers.resize(mSwapChainImageViews.size());
+
+	for (size_t i = 0; i < mSwapChainImageViews.size(); i++)
+	{
+		std::array<VkImageView, 2 + GBuffer_Count> attachments =
+		{
+			mSwapChainImageViews[i],
+			mDepthImageView,
+			mGBufferImageViews[GBuffer_Albedo],
+			mGBufferImageViews[GBuffer_Normal]
+		};
+
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = mDeferredRenderPass;
+		framebufferInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebufferInfo.pAttachments = attachments.data();
+		framebufferInfo.width = mSwapChainExtent.width;
+		framebufferInfo.height = mSwapChainExtent.height;
+		framebufferInfo.layers = 1;
+
+		VK_CHECK(vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &mDeferredFramebuffers[i]));
+	}
 }
 
 void Renderer::CreateCommandPool()
@@ -1042,39 +2004,204 @@ void Renderer::CreateDepthResources()
 	VkFormat depthFormat;
 	VK_CHECK(W::VK::GetSupportedDepthFormat(mPhysicalDevice, depthFormat));
 
-	CreateImage(mSwapChainExtent.width, mSwapChainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mDepthImage, mDepthImageMemory);
+	// read back by the deferred lighting
+	CreateImage(mSwapChainExtent.width, mSwapChainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mDepthImage, mDepthImageMemory);
 	mDepthImageView = CreateImageView(mDepthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 
-	TransitionImageLayout(mDepthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
+	// transitioned by the render pass, its depth attachment starts in VK_IMAGE_LAYOUT_UNDEFINED
 }
 
-void Renderer::CreateTextureImage(Texture * texture)
+void Renderer::CreateGBufferResources()
 {
-	VkDeviceSize imageSize = texture->TextureWidth * texture->TextureHeight * 4;
-	texture->MipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texture->TextureWidth, texture->TextureHeight)))) + 1;
+	// only live within the deferred pass, cleared and never stored
+	for (uint32_t i = 0; i < GBuffer_Count; ++i)
+	{
+		CreateImage(mSwapChainExtent.width, mSwapChainExtent.height, 1, GBUFFER_FORMATS[i], VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mGBufferImages[i], mGBufferImageMemory[i]);
+		mGBufferImageViews[i] = CreateImageView(mGBufferImages[i], GBUFFER_FORMATS[i], VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	// a pool per swap chain, the frames in flight keep reading the set of the retired one
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	poolSize.descriptorCount = GBuffer_Count + 1;
 
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, texture->Pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(mDevice, stagingBufferMemory);
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+	poolInfo.maxSets = 1;
 
-	texture->DestroyPixelBuffer();
+	VK_CHECK(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mGBufferDescriptorPool));
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = mGBufferDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mGBufferDescriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(mDevice, &allocInfo, &mGBufferDescriptorSet));
+
+	std::array<VkDescriptorImageInfo, GBuffer_Count + 1> imageInfos = {};
+	for (uint32_t i = 0; i < GBuffer_Count; ++i)
+	{
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[i].imageView = mGBufferImageViews[i];
+	}
+	imageInfos[GBuffer_Count].imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	imageInfos[GBuffer_Count].imageView = mDepthImageView;
+
+	VkWriteDescriptorSet descriptorWrite = {};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = mGBufferDescriptorSet;
+	descriptorWrite.dstBinding = 0;
+	descriptorWrite.dstArrayElement = 0;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	descriptorWrite.descriptorCount = static_cast<uint32_t>(imageInfos.size());
+	descriptorWrite.pImageInfo = imageInfos.data();
+
+	vkUpdateDescriptorSets(mDevice, 1, &descriptorWrite, 0, nullptr);
+}
+
+void Renderer::CreateShadowResources()
+{
+	// without a format filtering the comparisons, the shadows are sampled from the nearest texel
+	VkFormat shadowMapFormat = SHADOW_MAP_FORMATS[0];
+	VkFilter shadowMapFilter = VK_FILTER_NEAREST;
+	for (VkFormat format : SHADOW_MAP_FORMATS)
+	{
+		VkFormatProperties formatProperties;
+		vkGetPhysicalDeviceFormatProperties(mPhysicalDevice, format, &formatProperties);
+
+		const VkFormatFeatureFlags features = VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+		if ((formatProperties.optimalTilingFeatures & features) == features)
+		{
+			shadowMapFormat = format;
+			shadowMapFilter = VK_FILTER_LINEAR;
+			break;
+		}
+	}
+
+	if (shadowMapFilter == VK_FILTER_NEAREST)
+	{
+		W::Logger::PrintFormat("[Renderer] no shadow map format filters its comparisons, nearest sampling\n");
+	}
+
+	// the tiles are rendered one at a time, the pass keeps the cached ones and leaves the map ready for sampling
+	VkAttachmentDescription depthAttachment = {};
+	depthAttachment.format = shadowMapFormat;
+	depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+	depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depthAttachment.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+	depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	VkAttachmentReference depthAttachmentRef = {};
+	depthAttachmentRef.attachment = 0;
+	depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpass = {};
+	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpass.colorAttachmentCount = 0;
+	subpass.pDepthStencilAttachment = &depthAttachmentRef;
+
+	// the previous frames sampled the map, the passes after this one sample it
+	std::array<VkSubpassDependency, 2> dependencies = {};
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+	dependencies[1].srcSubpass = 0;
+	dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	dependencies[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	dependencies[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	VkRenderPassCreateInfo renderPassInfo = {};
+	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	renderPassInfo.attachmentCount = 1;
+	renderPassInfo.pAttachments = &depthAttachment;
+	renderPassInfo.subpassCount = 1;
+	renderPassInfo.pSubpasses = &subpass;
+	renderPassInfo.dependencyCount = static_cast<uint32_t>(dependencies.size());
+	renderPassInfo.pDependencies = dependencies.data();
+
+	VK_CHECK(vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mShadowRenderPass));
+
+	// cleared to the far depth, nothing is in shadow until the views are rendered
+	const uint32_t mapSizes[ShadowMap_Count] = { SHADOW_CASCADE_SIZE * 2, SHADOW_ATLAS_SIZE };
+	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+	for (uint32_t i = 0; i < ShadowMap_Count; ++i)
+	{
+		ShadowMap& shadowMap = mShadowMaps[i];
+		shadowMap.Size = mapSizes[i];
+		CreateImage(shadowMap.Size, shadowMap.Size, 1, shadowMapFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, shadowMap.Image, shadowMap.ImageMemory);
+		shadowMap.ImageView = CreateImageView(shadowMap.Image, shadowMapFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+		VkFramebufferCreateInfo framebufferInfo = {};
+		framebufferInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebufferInfo.renderPass = mShadowRenderPass;
+		framebufferInfo.attachmentCount = 1;
+		framebufferInfo.pAttachments = &shadowMap.ImageView;
+		framebufferInfo.width = shadowMap.Size;
+		framebufferInfo.height = shadowMap.Size;
+		framebufferInfo.layers = 1;
+
+		VK_CHECK(vkCreateFramebuffer(mDevice, &framebufferInfo, nullptr, &shadowMap.Framebuffer));
+
+		TransitionImageLayout(commandBuffer, shadowMap.Image, shadowMapFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1);
+
+		VkClearDepthStencilValue clearValue = { 1.0f, 0 };
+		VkImageSubresourceRange range = {};
+		range.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+		range.levelCount = 1;
+		range.layerCount = 1;
+		vkCmdClearDepthStencilImage(commandBuffer, shadowMap.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearValue, 1, &range);
+
+		TransitionImageLayout(commandBuffer, shadowMap.Image, shadowMapFormat, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, 1);
+	}
+	EndSingleTimeCommands(commandBuffer);
+
+	// hardware comparison with bilinear filtering of the results where the format allows it
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = shadowMapFilter;
+	samplerInfo.minFilter = shadowMapFilter;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.anisotropyEnable = VK_FALSE;
+	samplerInfo.maxAnisotropy = 1;
+	samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+	samplerInfo.unnormalizedCoordinates = VK_FALSE;
+	samplerInfo.compareEnable = VK_TRUE;
+	samplerInfo.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.minLod = 0;
+	samplerInfo.maxLod = 0;
+	samplerInfo.mipLodBias = 0;
+
+	VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &mShadowSampler));
+}
+
+void Renderer::CreateTextureImage(Texture * texture)
+{
+	VkDeviceSize imageSize = texture->TextureWidth * texture->TextureHeight * 4;
+	texture->MipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texture->TextureWidth, texture->TextureHeight)))) + 1;
 
 	VkImageUsageFlags imageFlags = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
 	CreateImage(texture->TextureWidth, texture->TextureHeight, texture->MipLevels, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_TILING_OPTIMAL, imageFlags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture->TextureImage, texture->TextureImageMemory);
 
-	TransitionImageLayout(texture->TextureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture->MipLevels);
-	CopyBufferToImage(stagingBuffer, texture->TextureImage, static_cast<uint32_t>(texture->TextureWidth), static_cast<uint32_t>(texture->TextureHeight));
-	//transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+	// the pixels are copied to the staging memory right away, the mip levels are generated once the graphics queue acquires the image
+	texture->UploadSerial = mUploadQueue.UploadImage(texture->TextureImage, static_cast<uint32_t>(texture->TextureWidth), static_cast<uint32_t>(texture->TextureHeight), texture->MipLevels, texture->Pixels, imageSize);
+	mPendingTextures.push_back(texture);
 
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
-
-	GenerateMipmaps(texture->TextureImage, VK_FORMAT_R8G8B8A8_UNORM, texture->TextureWidth, texture->TextureHeight, texture->MipLevels);
+	texture->DestroyPixelBuffer();
 
 	texture->TextureImageView = CreateImageView(texture->TextureImage, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_ASPECT_COLOR_BIT, texture->MipLevels);
 
@@ -1099,7 +2226,16 @@ void Renderer::CreateTextureImage(Texture * texture)
 	VK_CHECK(vkCreateSampler(mDevice, &samplerInfo, nullptr, &texture->TextureSampler));
 }
 
-void Renderer::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+void Renderer::DestroyTexture(Texture * texture)
+{
+	vkDestroySampler(mDevice, texture->TextureSampler, nullptr);
+	vkDestroyImageView(mDevice, texture->TextureImageView, nullptr);
+
+	vkDestroyImage(mDevice, texture->TextureImage, nullptr);
+	mMemoryAllocator.Free(texture->TextureImageMemory);
+}
+
+void Renderer::GenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
 {
 	// Check if image format supports linear blitting
 	VkFormatProperties formatProperties;
@@ -1107,8 +2243,6 @@ void Renderer::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texW
 
 	Debug_AssertMsg(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT, "texture image format does not support linear blitting!");
 
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.image = image;
@@ -1182,8 +2316,6 @@ void Renderer::GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texW
 		0, nullptr,
 		0, nullptr,
 		1, &barrier);
-
-	EndSingleTimeCommands(commandBuffer);
 }
 
 VkImageView Renderer::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels)
@@ -1205,7 +2337,7 @@ VkImageView Renderer::CreateImageView(VkImage image, VkFormat format, VkImageAsp
 	return imageView;
 }
 
-void Renderer::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, VkDeviceMemory & imageMemory)
+void Renderer::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage & image, W::VK::MemoryAllocation & imageMemory)
 {
 	VkImageCreateInfo imageInfo = {};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1223,24 +2355,11 @@ void Renderer::CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels,
 	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 	VK_CHECK(vkCreateImage(mDevice, &imageInfo, nullptr, &image));
-
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(mDevice, image, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-	VK_CHECK(vkAllocateMemory(mDevice, &allocInfo, nullptr, &imageMemory));
-
-	vkBindImageMemory(mDevice, image, imageMemory, 0);
+	VK_CHECK(mMemoryAllocator.AllocateForImage(image, tiling, properties, imageMemory));
 }
 
-void Renderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
+void Renderer::TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels)
 {
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
 	VkImageMemoryBarrier barrier = {};
 	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 	barrier.oldLayout = oldLayout;
@@ -1249,7 +2368,9 @@ void Renderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayo
 	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
 	barrier.image = image;
 
-	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
+	const bool isDepthFormat = format == VK_FORMAT_D16_UNORM || format == VK_FORMAT_X8_D24_UNORM_PACK32 || format == VK_FORMAT_D32_SFLOAT
+		|| format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D16_UNORM_S8_UINT;
+	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL || isDepthFormat)
 	{
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
 
@@ -1296,6 +2417,14 @@ void Renderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayo
 		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
 		destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 	}
+	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL)
+	{
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+
+		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+	}
 	else
 	{
 		Debug_AssertMsg(false, "unsupported layout transition!");
@@ -1309,107 +2438,534 @@ void Renderer::TransitionImageLayout(VkImage image, VkFormat format, VkImageLayo
 		0, nullptr,
 		1, &barrier
 	);
-
-	EndSingleTimeCommands(commandBuffer);
 }
 
-void Renderer::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void Renderer::LoadScene()
 {
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
+	using TimePoint = std::chrono::steady_clock::time_point;
+	const TimePoint startTime = std::chrono::steady_clock::now();
 
-	VkBufferImageCopy region = {};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { width, height, 1 };
+	const char* scenePath = "Data/Scenes/StanfordDragon.fbx";
+	//const char* scenePath = "Data/Scenes/StudioLighting.fbx";
 
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+	W::JobSystem& jobSystem = Application::Current().Jobs();
+	mScene = Scene::Load(scenePath, jobSystem);
 
-	EndSingleTimeCommands(commandBuffer);
-}
+	const float loadTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+	W::Logger::PrintFormat("[Scene] %s loaded in %.2f ms\n", scenePath, loadTime);
 
-void Renderer::LoadScene()
-{
-	mScene = Scene::Load("Data/Scenes/StanfordDragon.fbx");
-	//mScene = Scene::Load("Data/Scenes/StudioLighting.fbx");
+	// The geometry is ready, upload it while the textures are still decoding
+	CreateGeometryBuffers();
+
+	// the instance count sizes the object transforms and visible instances descriptors of the materials
+	CreateInstancedDraws();
+	CreateCullResources();
+	CreateLightClusters();
+	CreateShadowViews();
 
+	// Upload the textures in the order they finish decoding, the main thread helps decoding while none is ready
+	std::vector<Texture*> pendingTextures;
 	for (auto& texture : mScene->Textures)
 	{
-		CreateTextureImage(texture.get());
+		pendingTextures.push_back(texture.get());
+	}
+
+	while (pendingTextures.empty() == false)
+	{
+		auto decodedTexture = std::find_if(pendingTextures.begin(), pendingTextures.end(), [](const Texture* texture) { return texture->Decoded.IsDone(); });
+		if (decodedTexture == pendingTextures.end())
+		{
+			decodedTexture = pendingTextures.begin();
+			jobSystem.Wait((*decodedTexture)->Decoded);
+		}
+
+		CreateTextureImage(*decodedTexture);
+		pendingTextures.erase(decodedTexture);
 	}
 
+	// released with DestroyPixelBuffer like the decoded pixels
+	mWhiteTexture = std::make_unique<Texture>();
+	mWhiteTexture->FilePath = "White";
+	mWhiteTexture->TextureWidth = 1;
+	mWhiteTexture->TextureHeight = 1;
+	mWhiteTexture->TextureChannels = 4;
+	mWhiteTexture->Pixels = malloc(4);
+	memset(mWhiteTexture->Pixels, 0xFF, 4);
+	CreateTextureImage(mWhiteTexture.get());
+
+	CreateSceneDescriptorSet();
+	CreateLightingPipeline();
 	for (auto& material : mScene->Materials)
 	{
 		CreateMaterial(material.get());
 	}
 
-	for (auto& model : mScene->Models)
+	// the models and textures are drawn as their batches complete
+	mUploadQueue.Submit();
+
+	const float megaByte = 1024.0f * 1024.0f;
+	W::Logger::PrintFormat("[Scene] %.2f MB uploaded in %u submits\n", mUploadQueue.GetUploadedSize() / megaByte, mUploadQueue.GetSubmitCount());
+
+	const float readyTime = std::chrono::duration<float, std::chrono::milliseconds::period>(std::chrono::steady_clock::now() - startTime).count();
+	W::Logger::PrintFormat("[Scene] %s ready in %.2f ms\n", scenePath, readyTime);
+}
+
+void Renderer::CreateGeometryBuffers()
+{
+	uint32_t vertexCount = 0;
+	uint32_t indexCount = 0;
+	for (auto& geometry : mScene->Geometries)
+	{
+		geometry->BaseVertex = vertexCount;
+		geometry->FirstIndex = indexCount;
+		vertexCount += static_cast<uint32_t>(geometry->VertexData.Count);
+		indexCount += static_cast<uint32_t>(geometry->IndexData.Count);
+	}
+
+	CreateBuffer(std::max<VkDeviceSize>(vertexCount, 1) * sizeof(Vertex), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mSceneVertexBuffer, mSceneVertexBufferMemory);
+	CreateBuffer(std::max<VkDeviceSize>(indexCount, 1) * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mSceneIndexBuffer, mSceneIndexBufferMemory);
+	// the depth pre-pass only fetches the positions
+	CreateBuffer(std::max<VkDeviceSize>(vertexCount, 1) * sizeof(glm::vec3), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mScenePositionBuffer, mScenePositionBufferMemory);
+
+	std::vector<glm::vec3> positions;
+	for (auto& geometry : mScene->Geometries)
+	{
+		if (geometry->VertexData.Count > 0)
+		{
+			uint64_t serial = mUploadQueue.UploadBuffer(mSceneVertexBuffer, geometry->BaseVertex * sizeof(Vertex), geometry->VertexData.Data, geometry->VertexData.SizeInBytes());
+			mSceneUploadSerial = std::max(mSceneUploadSerial, serial);
+
+			positions.resize(geometry->VertexData.Count);
+			for (size_t i = 0; i < geometry->VertexData.Count; ++i)
+			{
+				positions[i] = geometry->VertexData.Data[i].Position;
+			}
+			serial = mUploadQueue.UploadBuffer(mScenePositionBuffer, geometry->BaseVertex * sizeof(glm::vec3), positions.data(), positions.size() * sizeof(glm::vec3));
+			mSceneUploadSerial = std::max(mSceneUploadSerial, serial);
+		}
+
+		if (geometry->IndexData.Count > 0)
+		{
+			uint64_t serial = mUploadQueue.UploadBuffer(mSceneIndexBuffer, geometry->FirstIndex * sizeof(uint32_t), geometry->IndexData.Data, geometry->IndexData.SizeInBytes());
+			mSceneUploadSerial = std::max(mSceneUploadSerial, serial);
+		}
+	}
+}
+
+void Renderer::CreateInstancedDraws()
+{
+	// (material, geometry, index offset) of each draw, the draws of a material are contiguous
+	std::map<std::tuple<int, const Geometry*, int>, size_t> drawIndices;
+	for (const std::unique_ptr<Model>& model : mScene->Models)
+	{
+		for (const Mesh& mesh : model->Meshs)
+		{
+			if (mesh.TriangleCount == 0)
+				continue;
+
+			drawIndices.emplace(std::make_tuple(mesh.MaterialIndex, model->SharedGeometry, mesh.IndexOffset), 0);
+		}
+	}
+
+	for (auto& drawIndex : drawIndices)
+	{
+		const int materialIndex = std::get<0>(drawIndex.first);
+		if (mMaterialDraws.empty() || mMaterialDraws.back().MaterialIndex != materialIndex)
+		{
+			mMaterialDraws.push_back({ materialIndex, static_cast<uint32_t>(mInstancedDraws.size()), 0 });
+		}
+		mMaterialDraws.back().DrawCount += 1;
+
+		drawIndex.second = mInstancedDraws.size();
+		mInstancedDraws.push_back({ nullptr, Mesh(), 0, 0 });
+	}
+
+	for (const std::unique_ptr<Model>& model : mScene->Models)
+	{
+		for (const Mesh& mesh : model->Meshs)
+		{
+			if (mesh.TriangleCount == 0)
+				continue;
+
+			InstancedDraw& draw = mInstancedDraws[drawIndices[std::make_tuple(mesh.MaterialIndex, model->SharedGeometry, mesh.IndexOffset)]];
+			draw.SharedGeometry = model->SharedGeometry;
+			draw.DrawMesh = mesh;
+			draw.InstanceCount += 1;
+		}
+	}
+
+	uint32_t instanceCount = 0;
+	for (InstancedDraw& draw : mInstancedDraws)
+	{
+		draw.FirstInstance = instanceCount;
+		instanceCount += draw.InstanceCount;
+		draw.InstanceCount = 0; // counted again while filling the instances
+	}
+
+	mInstanceModels.resize(instanceCount);
+	for (const std::unique_ptr<Model>& model : mScene->Models)
+	{
+		for (const Mesh& mesh : model->Meshs)
+		{
+			if (mesh.TriangleCount == 0)
+				continue;
+
+			InstancedDraw& draw = mInstancedDraws[drawIndices[std::make_tuple(mesh.MaterialIndex, model->SharedGeometry, mesh.IndexOffset)]];
+			mInstanceModels[draw.FirstInstance + draw.InstanceCount] = model.get();
+			draw.InstanceCount += 1;
+		}
+	}
+
+	W::Logger::PrintFormat("[Renderer] %u instances in %u draws, %u materials\n", instanceCount, static_cast<uint32_t>(mInstancedDraws.size()), static_cast<uint32_t>(mMaterialDraws.size()));
+}
+
+// Center of the bounds and the farthest vertex from it, loose but cheap to test
+static glm::vec4 ComputeBoundingSphere(const ArrayView<Vertex>& vertices)
+{
+	if (vertices.Count == 0)
+		return glm::vec4(0.0f);
+
+	glm::vec3 boundsMin = vertices.Data[0].Position;
+	glm::vec3 boundsMax = vertices.Data[0].Position;
+	for (size_t i = 1; i < vertices.Count; ++i)
 	{
-		CreateVertexBuffer(model.get());
-		CreateIndexBuffer(model.get());
+		boundsMin = glm::min(boundsMin, vertices.Data[i].Position);
+		boundsMax = glm::max(boundsMax, vertices.Data[i].Position);
 	}
+
+	const glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+	float radiusSquared = 0.0f;
+	for (size_t i = 0; i < vertices.Count; ++i)
+	{
+		const glm::vec3 offset = vertices.Data[i].Position - center;
+		radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+	}
+
+	return glm::vec4(center, std::sqrt(radiusSquared));
 }
 
-void Renderer::CreateVertexBuffer(Model * model)
+void Renderer::CreateCullResources()
 {
-	VkDeviceSize bufferSize = sizeof(Vertex) * model->Vertices.size();
+	std::unordered_map<const Geometry*, glm::vec4> boundingSpheres;
+	for (auto& geometry : mScene->Geometries)
+	{
+		boundingSpheres[geometry.get()] = ComputeBoundingSphere(geometry->VertexData);
+	}
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	// The culling pass starts every frame from draw commands without instances
+	std::vector<CullInstance> cullInstances(mInstanceModels.size());
+	std::vector<VkDrawIndexedIndirectCommand> drawCommands(mInstancedDraws.size());
+	for (uint32_t drawIndex = 0; drawIndex < mInstancedDraws.size(); ++drawIndex)
+	{
+		const InstancedDraw& draw = mInstancedDraws[drawIndex];
 
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, model->Vertices.data(), (size_t)bufferSize);
-	vkUnmapMemory(mDevice, stagingBufferMemory);
+		VkDrawIndexedIndirectCommand& command = drawCommands[drawIndex];
+		command.indexCount = draw.DrawMesh.TriangleCount * 3;
+		command.instanceCount = 0;
+		command.firstIndex = draw.SharedGeometry->FirstIndex + draw.DrawMesh.IndexOffset;
+		command.vertexOffset = static_cast<int32_t>(draw.SharedGeometry->BaseVertex);
+		command.firstInstance = draw.FirstInstance;
+
+		for (uint32_t instance = draw.FirstInstance; instance < draw.FirstInstance + draw.InstanceCount; ++instance)
+		{
+			cullInstances[instance].BoundingSphere = boundingSpheres[draw.SharedGeometry];
+			cullInstances[instance].DrawIndex = drawIndex;
+		}
+	}
 
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, model->VertexBuffer, model->VertexBufferMemory);
+	const VkDeviceSize cullInstancesSize = std::max<size_t>(cullInstances.size(), 1) * sizeof(CullInstance);
+	const VkDeviceSize drawCommandsSize = std::max<size_t>(drawCommands.size(), 1) * sizeof(VkDrawIndexedIndirectCommand);
+	const VkDeviceSize visibleInstancesSize = std::max<size_t>(mInstanceModels.size(), 1) * sizeof(uint32_t);
 
-	CopyBuffer(stagingBuffer, model->VertexBuffer, bufferSize);
+	CreateBuffer(cullInstancesSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mCullInstanceBuffer, mCullInstanceBufferMemory);
+	CreateBuffer(drawCommandsSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mDrawCommandTemplateBuffer, mDrawCommandTemplateBufferMemory);
 
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+	if (cullInstances.empty() == false)
+	{
+		mSceneUploadSerial = std::max(mSceneUploadSerial, mUploadQueue.UploadBuffer(mCullInstanceBuffer, 0, cullInstances.data(), cullInstances.size() * sizeof(CullInstance)));
+		mSceneUploadSerial = std::max(mSceneUploadSerial, mUploadQueue.UploadBuffer(mDrawCommandTemplateBuffer, 0, drawCommands.data(), drawCommands.size() * sizeof(VkDrawIndexedIndirectCommand)));
+	}
+
+	// regions are bound with dynamic offsets, aligned like the frame constants
+	const VkDeviceSize alignmentMask = mFrameConstantsAlignment - 1;
+	mDrawCommandRegionSize = (drawCommandsSize + alignmentMask) & ~alignmentMask;
+	mVisibleInstanceRegionSize = (visibleInstancesSize + alignmentMask) & ~alignmentMask;
+
+	CreateBuffer(mDrawCommandRegionSize * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mDrawCommandBuffer, mDrawCommandBufferMemory);
+	CreateBuffer(mVisibleInstanceRegionSize * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mVisibleInstanceBuffer, mVisibleInstanceBufferMemory);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = mDescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &mCullDescriptorSetLayout;
+
+	VK_CHECK(vkAllocateDescriptorSets(mDevice, &allocInfo, &mCullDescriptorSet));
+
+	std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+	bufferInfos[0].buffer = mFrameConstants.GetBuffer();
+	bufferInfos[0].offset = 0;
+	bufferInfos[0].range = std::max<size_t>(mInstanceModels.size(), 1) * sizeof(W::Math::ObjectTransform);
+	bufferInfos[1].buffer = mCullInstanceBuffer;
+	bufferInfos[1].offset = 0;
+	bufferInfos[1].range = cullInstancesSize;
+	bufferInfos[2].buffer = mDrawCommandBuffer;
+	bufferInfos[2].offset = 0;
+	bufferInfos[2].range = drawCommandsSize;
+	bufferInfos[3].buffer = mVisibleInstanceBuffer;
+	bufferInfos[3].offset = 0;
+	bufferInfos[3].range = visibleInstancesSize;
+
+	std::array<VkWriteDescriptorSet, 4> descriptorWrites = {};
+	for (uint32_t i = 0; i < descriptorWrites.size(); ++i)
+	{
+		descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[i].dstSet = mCullDescriptorSet;
+		descriptorWrites[i].dstBinding = i;
+		descriptorWrites[i].dstArrayElement = 0;
+		descriptorWrites[i].descriptorType = (i == 1) ? VK_DESCRIPTOR_TYPE_STORAGE_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+		descriptorWrites[i].descriptorCount = 1;
+		descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
-void Renderer::CreateIndexBuffer(Model * model)
+// Distance at which the attenuation of shader.frag times the brightest channel falls under LIGHT_CUTOFF
+static float ComputeLightRange(const glm::vec3& color)
 {
-	VkDeviceSize bufferSize = sizeof(model->Indices[0]) * model->Indices.size();
+	const float lightConstant = 1.0f;
+	const float lightLinear = 0.09f;
+	const float lightQuadratic = 0.032f;
 
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
+	const float brightness = std::max(color.r, std::max(color.g, color.b));
+	const float constant = lightConstant - brightness / LIGHT_CUTOFF;
+	if (constant >= 0.0f)
+		return 0.0f;
 
-	void* data;
-	vkMapMemory(mDevice, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, model->Indices.data(), (size_t)bufferSize);
-	vkUnmapMemory(mDevice, stagingBufferMemory);
+	return (-lightLinear + std::sqrt(lightLinear * lightLinear - 4.0f * lightQuadratic * constant)) / (2.0f * lightQuadratic);
+}
+
+void Renderer::CreateLightClusters()
+{
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		// the directional lights first, they light every pixel
+		for (const std::unique_ptr<Light>& light : mScene->Lights)
+		{
+			if (light->LightType == LightType::Unknown || (light->LightType == LightType::Directional) != (pass == 0))
+				continue;
+
+			mSceneShaderFeatures |= 1u << static_cast<uint32_t>(light->LightType);
+
+			LightConstants constants = {};
+			constants.Type = static_cast<int>(light->LightType);
+			constants.Position = glm::vec3(light->WorldTransform[3]);
+			constants.Direction = glm::vec3(0.0f, 0.0f, -1.0f);
+			constants.Range = ComputeLightRange(light->Color);
+			constants.Color = light->Color;
+			constants.Intensity = light->Intensity;
+			constants.InnerAngle = glm::radians(light->InnerAngle);
+			constants.OuterAngle = glm::radians(light->OuterAngle);
+			constants.ShadowIndex = -1;
+			mLights.push_back(constants);
+		}
+
+		if (pass == 0)
+		{
+			mDirectionalLightCount = static_cast<uint32_t>(mLights.size());
+		}
+	}
+
+	mClusterGrid.NearZ = CAMERA_NEAR_PLANE;
+	mClusterGrid.FarZ = CAMERA_FAR_PLANE;
+
+	// the spheres only move with the view, the centers are updated every frame
+	mLightSpheres.resize(mLights.size() - mDirectionalLightCount);
+	for (size_t i = 0; i < mLightSpheres.size(); ++i)
+	{
+		const LightConstants& light = mLights[mDirectionalLightCount + i];
+
+		// the area lights are 2 by 2 rectangles around their position
+		mLightSpheres[i].Radius = (light.Type == static_cast<int>(LightType::Area)) ? light.Range + std::sqrt(2.0f) : light.Range;
+	}
+
+	mLightClusters.resize(mClusterGrid.GetClusterCount() * 2 + MAX_CLUSTER_LIGHT_INDICES);
+	mReportedDroppedLights = false;
+
+	W::Logger::PrintFormat("[Renderer] %u lights binned into %u clusters, %u directional\n", static_cast<uint32_t>(mLightSpheres.size()), mClusterGrid.GetClusterCount(), mDirectionalLightCount);
+}
+
+// Texture coordinates of a shadow map tile from the clip space of its view, the depth is kept
+static glm::mat4 ComputeTileTransform(const VkRect2D& tile, uint32_t mapSize)
+{
+	glm::mat4 transform(1.0f);
+	transform[0][0] = 0.5f * tile.extent.width / mapSize;
+	transform[1][1] = 0.5f * tile.extent.height / mapSize;
+	transform[3][0] = (tile.offset.x + 0.5f * tile.extent.width) / mapSize;
+	transform[3][1] = (tile.offset.y + 0.5f * tile.extent.height) / mapSize;
+	return transform;
+}
+
+void Renderer::CreateShadowViews()
+{
+	static_assert(SHADOW_CASCADE_COUNT == 4, "the cascades are laid out two by two, see CalcSunShadow in lighting.glsl");
+
+	// the cascades are sampled with their own texture coordinates, CalcSunShadow finds their tile
+	for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+	{
+		ShadowView view = {};
+		view.MapType = ShadowMap_Cascades;
+		view.Tile.offset = { static_cast<int32_t>((i & 1) * SHADOW_CASCADE_SIZE), static_cast<int32_t>((i >> 1) * SHADOW_CASCADE_SIZE) };
+		view.Tile.extent = { SHADOW_CASCADE_SIZE, SHADOW_CASCADE_SIZE };
+		view.TileTransform = ComputeTileTransform({ { 0, 0 }, view.Tile.extent }, SHADOW_CASCADE_SIZE);
+		view.ViewProjection = glm::mat4(1.0f);
+		view.TargetViewProjection = glm::mat4(1.0f);
+		view.IsDirty = true;
+		mShadowViews.push_back(view);
+	}
+
+	// the lights of the scene take the atlas tiles in order until it is full, the others have no shadows
+	const uint32_t tilesPerRow = SHADOW_ATLAS_SIZE / SHADOW_ATLAS_TILE_SIZE;
+	const uint32_t tileCount = tilesPerRow * tilesPerRow;
+	uint32_t usedTileCount = 0;
+	uint32_t unshadowedLightCount = 0;
+
+	// one texel wider than a quarter turn, the faces filter their edges without reading the next tile
+	const float cubeFaceFov = 2.0f * std::atan(SHADOW_ATLAS_TILE_SIZE / (SHADOW_ATLAS_TILE_SIZE - 2.0f));
+	const glm::vec3 cubeFaceDirections[6] = { { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+
+	for (LightConstants& light : mLights)
+	{
+		const bool isPoint = light.Type == static_cast<int>(LightType::Point);
+		const bool isSpot = light.Type == static_cast<int>(LightType::Spot);
+		if ((isPoint == false && isSpot == false) || light.Range <= SHADOW_NEAR_PLANE)
+			continue;
+
+		// a wider spot would light past its view, and sample the next tiles of the atlas there
+		const uint32_t faceCount = isPoint ? 6 : 1;
+		if (usedTileCount + faceCount > tileCount || (isSpot && light.OuterAngle > SHADOW_SPOT_MAX_ANGLE))
+		{
+			++unshadowedLightCount;
+			continue;
+		}
+
+		light.ShadowIndex = static_cast<int>(mShadowViews.size());
+		for (uint32_t face = 0; face < faceCount; ++face)
+		{
+			const uint32_t tileIndex = usedTileCount++;
+
+			ShadowView view = {};
+			view.MapType = ShadowMap_Atlas;
+			view.Tile.offset = { static_cast<int32_t>((tileIndex % tilesPerRow) * SHADOW_ATLAS_TILE_SIZE), static_cast<int32_t>((tileIndex / tilesPerRow) * SHADOW_ATLAS_TILE_SIZE) };
+			view.Tile.extent = { SHADOW_ATLAS_TILE_SIZE, SHADOW_ATLAS_TILE_SIZE };
+			view.TileTransform = ComputeTileTransform(view.Tile, SHADOW_ATLAS_SIZE);
+
+			const glm::vec3 direction = isPoint ? cubeFaceDirections[face] : light.Direction;
+			const glm::vec3 up = (std::abs(direction.z) > 0.99f) ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 1.0f);
+			const float fov = isPoint ? cubeFaceFov : std::max(light.OuterAngle, glm::radians(1.0f));
+
+			// the lights do not move, the views only need rendering again when a caster does
+			view.TargetViewProjection = glm::perspective(fov, 1.0f, SHADOW_NEAR_PLANE, light.Range) * glm::lookAt(light.Position, light.Position + direction, up);
+			view.ViewProjection = view.TargetViewProjection;
+			view.IsDirty = true;
+			mShadowViews.push_back(view);
+		}
+	}
+
+	W::Logger::PrintFormat("[Renderer] %u shadow views, %u of %u atlas tiles used, %u lights without shadows\n", static_cast<uint32_t>(mShadowViews.size()), usedTileCount, tileCount, unshadowedLightCount);
+
+	GetGraphicsPipeline(ShaderFeature_DepthOnly | ShaderFeature_Shadow);
+}
+
+void Renderer::CreateFrameConstants()
+{
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &deviceProperties);
+
+	// slices are bound as uniform or storage buffers with dynamic offsets, and written with aligned SSE stores
+	mFrameConstantsAlignment = std::max(deviceProperties.limits.minUniformBufferOffsetAlignment, deviceProperties.limits.minStorageBufferOffsetAlignment);
+	mFrameConstantsAlignment = std::max(mFrameConstantsAlignment, static_cast<VkDeviceSize>(16));
+
+	VK_CHECK(mFrameConstants.Initialize(mDevice, mMemoryAllocator, FRAME_CONSTANTS_SIZE * MAX_FRAMES_IN_FLIGHT, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT));
+}
+
+void Renderer::CreateTimestampQueries()
+{
+	uint32_t queueFamilyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, nullptr);
+
+	std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(mPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+
+	const uint32_t graphicsFamily = static_cast<uint32_t>(FindQueueFamilies(mPhysicalDevice).GraphicsFamily);
+	if (queueFamilies[graphicsFamily].timestampValidBits == 0)
+	{
+		W::Logger::PrintFormat("[Renderer] timestamps not supported by the graphics queue, no GPU timings\n");
+		return;
+	}
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(mPhysicalDevice, &deviceProperties);
+	mTimestampPeriod = deviceProperties.limits.timestampPeriod;
+
+	// a start timestamp then one at the end of each pass, per frame in flight
+	VkQueryPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	poolInfo.queryCount = MAX_FRAMES_IN_FLIGHT * (GpuTimer_Count + 1);
+
+	VK_CHECK(vkCreateQueryPool(mDevice, &poolInfo, nullptr, &mTimestampQueryPool));
+}
+
+void Renderer::ReadTimestamps(FrameData& frameData)
+{
+	if (frameData.HasTimestamps == false)
+		return;
+
+	// the fence of the frame is signaled, the results are available
+	std::array<uint64_t, GpuTimer_Count + 1> timestamps;
+	VkResult result = vkGetQueryPoolResults(mDevice, mTimestampQueryPool, mCurrentFrame * (GpuTimer_Count + 1), GpuTimer_Count + 1, sizeof(timestamps), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	frameData.HasTimestamps = false;
+	if (result != VK_SUCCESS)
+		return;
 
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, model->IndexBuffer, model->IndexBufferMemory);
+	for (uint32_t i = 0; i < GpuTimer_Count; ++i)
+	{
+		mGpuTimes[i] = static_cast<float>(timestamps[i + 1] - timestamps[i]) * mTimestampPeriod / 1000000.0f;
+	}
+}
 
-	CopyBuffer(stagingBuffer, model->IndexBuffer, bufferSize);
+void Renderer::WriteTimestamp(VkCommandBuffer commandBuffer, uint32_t timestamp)
+{
+	if (mTimestampQueryPool == VK_NULL_HANDLE)
+		return;
 
-	vkDestroyBuffer(mDevice, stagingBuffer, nullptr);
-	vkFreeMemory(mDevice, stagingBufferMemory, nullptr);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestampQueryPool, mCurrentFrame * (GpuTimer_Count + 1) + timestamp);
 }
 
-void Renderer::CreateUniformBuffers()
+void* Renderer::AllocateFrameConstants(VkDeviceSize size, uint32_t& outOffset)
 {
-	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-	CreateBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mUniformBuffers, mUniformBuffersMemory);
+	VkDeviceSize offset;
+	void* data;
+	bool allocated = mFrameConstants.Allocate(size, mFrameConstantsAlignment, offset, data);
+	Debug_AssertMsg(allocated, "frame constants ring is full, FRAME_CONSTANTS_SIZE is too small");
+
+	outOffset = static_cast<uint32_t>(offset);
+	return data;
 }
 
 void Renderer::CreateDescriptorPool()
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes = {};
-	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+	std::array<VkDescriptorPoolSize, 4> poolSizes = {};
+	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 	poolSizes[0].descriptorCount = 1000;
 	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 	poolSizes[1].descriptorCount = 1000;
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC;
+	poolSizes[2].descriptorCount = 1000;
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[3].descriptorCount = 1000;
 
 	VkDescriptorPoolCreateInfo poolInfo = {};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1420,7 +2976,7 @@ void Renderer::CreateDescriptorPool()
 	VK_CHECK(vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool));
 }
 
-void Renderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer & buffer, VkDeviceMemory & bufferMemory)
+void Renderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer & buffer, W::VK::MemoryAllocation & bufferMemory)
 {
 	VkBufferCreateInfo bufferInfo = {};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1429,17 +2985,7 @@ void Renderer::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemor
 	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
 	VK_CHECK(vkCreateBuffer(mDevice, &bufferInfo, nullptr, &buffer));
-
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(mDevice, buffer, &memRequirements);
-
-	VkMemoryAllocateInfo allocInfo = {};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = FindMemoryType(memRequirements.memoryTypeBits, properties);
-
-	VK_CHECK(vkAllocateMemory(mDevice, &allocInfo, nullptr, &bufferMemory));
-	VK_CHECK(vkBindBufferMemory(mDevice, buffer, bufferMemory, 0));
+	VK_CHECK(mMemoryAllocator.AllocateForBuffer(buffer, properties, bufferMemory));
 }
 
 VkCommandBuffer Renderer::BeginSingleTimeCommands()
@@ -1477,35 +3023,15 @@ void Renderer::EndSingleTimeCommands(VkCommandBuffer commandBuffer)
 	vkFreeCommandBuffers(mDevice, mCommandPool, 1, &commandBuffer);
 }
 
-void Renderer::CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
-{
-	VkCommandBuffer commandBuffer = BeginSingleTimeCommands();
-
-	VkBufferCopy copyRegion = {};
-	copyRegion.size = size;
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	EndSingleTimeCommands(commandBuffer);
-}
-
-uint32_t Renderer::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+// Direction the sun travels, the cascades are fitted to it
+static glm::vec3 GetDirectionalLightDirection()
 {
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memProperties);
-
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-	{
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
-	}
-
-	Debug_AssertMsg(false, "failed to find suitable memory type!");
-	return VK_MAX_MEMORY_TYPES;
+	const glm::vec3 direction = (glm::vec3&)s_DirectionalLightDirection;
+	const float length = glm::length(direction);
+	return (length > 0.0001f) ? direction / length : glm::vec3(0.0f, 0.0f, -1.0f);
 }
 
-void Renderer::UpdateUniformBuffer(VkCommandBuffer commandBuffer)
+uint32_t Renderer::UpdateUniformBuffer(glm::mat4& outView, glm::mat4& outProjection)
 {
 	glm::vec3 eyePosition(5.0f, 5.0f, 5.0f);
 	glm::vec3 lookAtPosition(0.0f, 0.0f, 0.0f);
@@ -1524,8 +3050,11 @@ void Renderer::UpdateUniformBuffer(VkCommandBuffer commandBuffer)
 
 	UniformBufferObject ubo = {};
 	ubo.View = glm::lookAt(eyePosition, lookAtPosition, glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.Projection = glm::perspective(glm::radians(fieldOfView), mSwapChainExtent.width / (float)mSwapChainExtent.height, 0.01f, 1000.0f);
+	ubo.Projection = glm::perspective(glm::radians(fieldOfView), mSwapChainExtent.width / (float)mSwapChainExtent.height, CAMERA_NEAR_PLANE, CAMERA_FAR_PLANE);
 	ubo.Projection[1][1] *= -1.0f;
+	ubo.InverseViewProjection = glm::inverse(ubo.Projection * ubo.View);
+	outView = ubo.View;
+	outProjection = ubo.Projection;
 
 	ubo.CameraPosition = eyePosition;
 
@@ -1534,27 +3063,310 @@ void Renderer::UpdateUniformBuffer(VkCommandBuffer commandBuffer)
 
 	ubo.DirectionalLightColor = (glm::vec3&)s_DirectionalLightColor;
 	ubo.DirectionalLightIntensity = s_DirectionalLightIntensity;
-	ubo.DirectionalLightDirection = cameraDirection;
+	ubo.DirectionalLightDirection = GetDirectionalLightDirection();
 
 	ubo.MaterialColor = (glm::vec3&)s_MaterialColor;
 	ubo.MaterialSpecularColor = (glm::vec3&)s_MaterialSpecularColor;
 	ubo.MaterialRoughness = s_MaterialRoughness;
 
-	ubo.LightCount = (int)mScene->Lights.size();
-	for (int i = 0; i < ubo.LightCount; ++i)
+	// cluster of a fragment from gl_FragCoord and its view depth, see W::Math::BinLights
+	const float sliceScale = mClusterGrid.CountZ / std::log(mClusterGrid.FarZ / mClusterGrid.NearZ);
+	ubo.DirectionalLightCount = static_cast<int>(mDirectionalLightCount);
+	ubo.ClusterCount = glm::uvec4(mClusterGrid.CountX, mClusterGrid.CountY, mClusterGrid.CountZ, mClusterGrid.GetClusterCount());
+	ubo.ClusterScale.x = mClusterGrid.CountX / static_cast<float>(mSwapChainExtent.width);
+	ubo.ClusterScale.y = mClusterGrid.CountY / static_cast<float>(mSwapChainExtent.height);
+	ubo.ClusterScale.z = sliceScale;
+	ubo.ClusterScale.w = -std::log(mClusterGrid.NearZ) * sliceScale;
+
+	// built on the stack, the mapped memory is write combined and must not be read back
+	uint32_t offset;
+	memcpy(AllocateFrameConstants(sizeof(UniformBufferObject), offset), &ubo, sizeof(UniformBufferObject));
+	return offset;
+}
+
+uint32_t Renderer::UpdateObjectTransforms(const glm::mat4& viewProjection)
+{
+	static_assert(sizeof(glm::mat4) == sizeof(W::Math::Matrix4), "glm::mat4 is not a column major 4x4 float matrix");
+
+	if (mInstanceModels.empty())
+		return 0;
+
+	// glm matrices are not 16 bytes aligned, gather them for the aligned loads of the batch
+	mObjectMatrices.resize(mInstanceModels.size());
+	for (size_t i = 0; i < mInstanceModels.size(); ++i)
+	{
+		memcpy(&mObjectMatrices[i], &mInstanceModels[i]->WorldTransform, sizeof(W::Math::Matrix4));
+	}
+
+	W::Math::Matrix4 matrix;
+	memcpy(&matrix, &viewProjection, sizeof(W::Math::Matrix4));
+
+	uint32_t offset;
+	void* data = AllocateFrameConstants(mObjectMatrices.size() * sizeof(W::Math::ObjectTransform), offset);
+	W::Math::ComputeObjectTransforms(data, sizeof(W::Math::ObjectTransform), mObjectMatrices.data(), mObjectMatrices.size(), matrix);
+	return offset;
+}
+
+void Renderer::UpdateLightClusters(const glm::mat4& view, const glm::mat4& projection, uint32_t& outLightsOffset, uint32_t& outLightClustersOffset)
+{
+	const size_t lightsSize = std::max<size_t>(mLights.size(), 1) * sizeof(LightConstants);
+	void* lights = AllocateFrameConstants(lightsSize, outLightsOffset);
+	if (mLights.empty() == false)
+	{
+		memcpy(lights, mLights.data(), mLights.size() * sizeof(LightConstants));
+	}
+
+	mClusterGrid.ProjectionX = projection[0][0];
+	mClusterGrid.ProjectionY = projection[1][1];
+
+	for (size_t i = mDirectionalLightCount; i < mLights.size(); ++i)
 	{
-		Light* light = mScene->Lights[i].get();
+		const LightConstants& light = mLights[i];
+		const glm::vec3 center = glm::vec3(view * glm::vec4(light.Position, 1.0f));
 
-		ubo.Lights[i].Type = (int)light->LightType;
-		ubo.Lights[i].Position = glm::vec3(light->WorldTransform[3][0], light->WorldTransform[3][1], light->WorldTransform[3][2]);
-		ubo.Lights[i].Direction = glm::vec3(0.0f, 0.0f, -1.0f);
-		ubo.Lights[i].Color = light->Color;
-		ubo.Lights[i].Intensity = light->Intensity;
-		ubo.Lights[i].InnerAngle = glm::radians(light->InnerAngle);
-		ubo.Lights[i].OuterAngle = glm::radians(light->OuterAngle);
+		W::Math::LightSphere& sphere = mLightSpheres[i - mDirectionalLightCount];
+		sphere.Center[0] = center.x;
+		sphere.Center[1] = center.y;
+		sphere.Center[2] = center.z;
 	}
 
-	vkCmdUpdateBuffer(commandBuffer, mUniformBuffers, 0, sizeof(UniformBufferObject), &ubo);
+	// binned on the side, the lights of a cluster are written all over the ranges
+	const uint32_t clusterCount = mClusterGrid.GetClusterCount();
+	uint32_t* clusters = mLightClusters.data();
+	uint32_t* indices = clusters + clusterCount * 2;
+	const size_t indexCount = W::Math::BinLights(clusters, indices, MAX_CLUSTER_LIGHT_INDICES, mClusterGrid, mLightSpheres.data(), mLightSpheres.size());
+	if (indexCount > MAX_CLUSTER_LIGHT_INDICES && mReportedDroppedLights == false)
+	{
+		W::Logger::PrintFormat("[Renderer] %u light indices dropped from the clusters\n", static_cast<uint32_t>(indexCount - MAX_CLUSTER_LIGHT_INDICES));
+		mReportedDroppedLights = true;
+	}
+
+	// the light indices are relative to the scene lights, past the directional ones
+	const size_t writtenCount = std::min<size_t>(indexCount, MAX_CLUSTER_LIGHT_INDICES);
+	for (size_t i = 0; i < writtenCount; ++i)
+	{
+		indices[i] += mDirectionalLightCount;
+	}
+
+	void* lightClusters = AllocateFrameConstants(mLightClusters.size() * sizeof(uint32_t), outLightClustersOffset);
+	memcpy(lightClusters, clusters, (clusterCount * 2 + writtenCount) * sizeof(uint32_t));
+}
+
+uint32_t Renderer::UpdateShadowViews(const glm::mat4& view, const glm::mat4& projection, bool canRender)
+{
+	mUpdatedShadowViews.clear();
+	if (mShadowViews.empty())
+		return 0;
+
+	// the cascades follow the camera, they only move when its slice leaves the snapped bounds
+	const glm::mat4 cameraTransform = glm::inverse(view);
+	W::Math::CascadeCamera camera;
+	memcpy(camera.Position, &cameraTransform[3], sizeof(camera.Position));
+	const glm::vec3 forward = -glm::vec3(cameraTransform[2]);
+	memcpy(camera.Forward, &forward, sizeof(camera.Forward));
+	camera.TanHalfFovX = 1.0f / std::abs(projection[0][0]);
+	camera.TanHalfFovY = 1.0f / std::abs(projection[1][1]);
+
+	W::Math::CascadeSettings settings;
+	settings.Resolution = SHADOW_CASCADE_SIZE;
+	settings.CasterDistance = SHADOW_DISTANCE;
+
+	const glm::vec3 lightDirection = GetDirectionalLightDirection();
+	float splits[SHADOW_CASCADE_COUNT];
+	W::Math::ComputeCascadeSplits(splits, SHADOW_CASCADE_COUNT, CAMERA_NEAR_PLANE, SHADOW_DISTANCE, SHADOW_CASCADE_LOG_WEIGHT);
+	for (uint32_t i = 0; i < SHADOW_CASCADE_COUNT; ++i)
+	{
+		const float splitNear = (i == 0) ? CAMERA_NEAR_PLANE : splits[i - 1];
+		W::Math::Matrix4 matrix;
+		W::Math::FitCascade(matrix, camera, splitNear, splits[i], &lightDirection.x, settings);
+		memcpy(&mShadowViews[i].TargetViewProjection, &matrix, sizeof(W::Math::Matrix4));
+	}
+
+	// any caster moving dirties every view, the scenes are mostly static
+	const bool castersMoved = mShadowCasterMatrices.size() != mObjectMatrices.size()
+		|| memcmp(mShadowCasterMatrices.data(), mObjectMatrices.data(), mObjectMatrices.size() * sizeof(W::Math::Matrix4)) != 0;
+	if (castersMoved)
+	{
+		mShadowCasterMatrices = mObjectMatrices;
+	}
+
+	for (ShadowView& shadowView : mShadowViews)
+	{
+		if (castersMoved || shadowView.TargetViewProjection != shadowView.ViewProjection)
+		{
+			shadowView.IsDirty = true;
+		}
+	}
+
+	// the cascades first, they are seen every frame, then the atlas views that waited the longest
+	if (canRender)
+	{
+		for (uint32_t i = 0; i < mShadowViews.size(); ++i)
+		{
+			if (mShadowViews[i].IsDirty)
+			{
+				mUpdatedShadowViews.push_back(i);
+			}
+		}
+
+		std::stable_sort(mUpdatedShadowViews.begin(), mUpdatedShadowViews.end(), [this](uint32_t a, uint32_t b)
+		{
+			const ShadowView& viewA = mShadowViews[a];
+			const ShadowView& viewB = mShadowViews[b];
+			if (viewA.MapType != viewB.MapType)
+				return viewA.MapType < viewB.MapType;
+			return viewA.MapType == ShadowMap_Atlas && viewA.RenderedFrame < viewB.RenderedFrame;
+		});
+
+		if (mUpdatedShadowViews.size() > static_cast<size_t>(s_ShadowUpdateBudget))
+		{
+			mUpdatedShadowViews.resize(s_ShadowUpdateBudget);
+		}
+
+		for (uint32_t index : mUpdatedShadowViews)
+		{
+			ShadowView& shadowView = mShadowViews[index];
+			shadowView.ViewProjection = shadowView.TargetViewProjection;
+			shadowView.RenderedFrame = mFrameCount;
+			shadowView.IsDirty = false;
+		}
+	}
+
+	// the views over budget are sampled with the matrices their tiles were rendered with
+	uint32_t offset;
+	glm::mat4* shadowViewProjections = static_cast<glm::mat4*>(AllocateFrameConstants(mShadowViews.size() * sizeof(glm::mat4), offset));
+	for (size_t i = 0; i < mShadowViews.size(); ++i)
+	{
+		const glm::mat4 shadowViewProjection = mShadowViews[i].TileTransform * mShadowViews[i].ViewProjection;
+		memcpy(&shadowViewProjections[i], &shadowViewProjection, sizeof(glm::mat4));
+	}
+	return offset;
+}
+
+void Renderer::RenderShadowViews(VkCommandBuffer commandBuffer, const uint32_t* dynamicOffsets, uint32_t dynamicOffsetCount)
+{
+	if (mUpdatedShadowViews.empty())
+		return;
+
+	// every caster is drawn, the culling of the camera does not apply to the light views
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mScenePositionBuffer, &offset);
+	vkCmdBindIndexBuffer(commandBuffer, mSceneIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GetGraphicsPipeline(ShaderFeature_DepthOnly | ShaderFeature_Shadow));
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mPipelineLayout, 0, 1, &mSceneDescriptorSet, dynamicOffsetCount, dynamicOffsets);
+	vkCmdSetDepthBias(commandBuffer, SHADOW_DEPTH_BIAS_CONSTANT, 0.0f, SHADOW_DEPTH_BIAS_SLOPE);
+
+	for (uint32_t mapType = 0; mapType < ShadowMap_Count; ++mapType)
+	{
+		const ShadowMap& shadowMap = mShadowMaps[mapType];
+		if (std::none_of(mUpdatedShadowViews.begin(), mUpdatedShadowViews.end(), [&](uint32_t index) { return mShadowViews[index].MapType == mapType; }))
+			continue;
+
+		VkRenderPassBeginInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		info.renderPass = mShadowRenderPass;
+		info.framebuffer = shadowMap.Framebuffer;
+		info.renderArea.offset = { 0, 0 };
+		info.renderArea.extent = { shadowMap.Size, shadowMap.Size };
+		vkCmdBeginRenderPass(commandBuffer, &info, VK_SUBPASS_CONTENTS_INLINE);
+
+		for (uint32_t index : mUpdatedShadowViews)
+		{
+			const ShadowView& shadowView = mShadowViews[index];
+			if (shadowView.MapType != mapType)
+				continue;
+
+			VkViewport viewport = {};
+			viewport.x = static_cast<float>(shadowView.Tile.offset.x);
+			viewport.y = static_cast<float>(shadowView.Tile.offset.y);
+			viewport.width = static_cast<float>(shadowView.Tile.extent.width);
+			viewport.height = static_cast<float>(shadowView.Tile.extent.height);
+			viewport.minDepth = 0.0f;
+			viewport.maxDepth = 1.0f;
+			vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+			vkCmdSetScissor(commandBuffer, 0, 1, &shadowView.Tile);
+
+			VkClearAttachment clearAttachment = {};
+			clearAttachment.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+			clearAttachment.clearValue.depthStencil = { 1.0f, 0 };
+
+			VkClearRect clearRect = {};
+			clearRect.rect = shadowView.Tile;
+			clearRect.baseArrayLayer = 0;
+			clearRect.layerCount = 1;
+			vkCmdClearAttachments(commandBuffer, 1, &clearAttachment, 1, &clearRect);
+
+			vkCmdPushConstants(commandBuffer, mPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &shadowView.ViewProjection);
+
+			for (const InstancedDraw& draw : mInstancedDraws)
+			{
+				vkCmdDrawIndexed(commandBuffer, draw.DrawMesh.TriangleCount * 3, draw.InstanceCount, draw.SharedGeometry->FirstIndex + draw.DrawMesh.IndexOffset, static_cast<int32_t>(draw.SharedGeometry->BaseVertex), draw.FirstInstance);
+			}
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+	}
+}
+
+// Planes of the clip volume in world space, pointing inside, from the rows of the view projection matrix
+static void ExtractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 outPlanes[6])
+{
+	const glm::mat4 rows = glm::transpose(viewProjection);
+
+	outPlanes[0] = rows[3] + rows[0]; // left
+	outPlanes[1] = rows[3] - rows[0]; // right
+	outPlanes[2] = rows[3] + rows[1]; // bottom
+	outPlanes[3] = rows[3] - rows[1]; // top
+	outPlanes[4] = rows[2];           // near, the depth range is zero to one
+	outPlanes[5] = rows[3] - rows[2]; // far
+
+	for (int i = 0; i < 6; ++i)
+	{
+		outPlanes[i] /= glm::length(glm::vec3(outPlanes[i]));
+	}
+}
+
+void Renderer::CullInstances(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection, uint32_t objectTransformsOffset, uint32_t drawCommandsOffset, uint32_t visibleInstancesOffset)
+{
+	// the instance counts are built up from zero in the region of the frame
+	{
+		VkBufferCopy copyRegion = {};
+		copyRegion.srcOffset = 0;
+		copyRegion.dstOffset = drawCommandsOffset;
+		copyRegion.size = mInstancedDraws.size() * sizeof(VkDrawIndexedIndirectCommand);
+		vkCmdCopyBuffer(commandBuffer, mDrawCommandTemplateBuffer, mDrawCommandBuffer, 1, &copyRegion);
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = mDrawCommandBuffer;
+		barrier.offset = copyRegion.dstOffset;
+		barrier.size = copyRegion.size;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	}
+
+	CullConstants constants = {};
+	ExtractFrustumPlanes(viewProjection, constants.FrustumPlanes);
+	constants.InstanceCount = static_cast<uint32_t>(mInstanceModels.size());
+
+	std::array<uint32_t, 3> dynamicOffsets = { objectTransformsOffset, drawCommandsOffset, visibleInstancesOffset };
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullPipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mCullPipelineLayout, 0, 1, &mCullDescriptorSet, static_cast<uint32_t>(dynamicOffsets.size()), dynamicOffsets.data());
+	vkCmdPushConstants(commandBuffer, mCullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullConstants), &constants);
+	vkCmdDispatch(commandBuffer, (constants.InstanceCount + 63) / 64, 1, 1);
+
+	// the draw commands and the visible instances are read by the draws of the render pass
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
 }
 
 VkShaderModule Renderer::CreateShaderModule(const std::vector<char> &code)
@@ -1678,9 +3490,13 @@ bool Renderer::IsDeviceSuitable(VkPhysicalDevice device)
 
 	VkPhysicalDeviceProperties deviceProperties;
 	vkGetPhysicalDeviceProperties(device, &deviceProperties);
+	if (deviceProperties.limits.maxDescriptorSetStorageBuffersDynamic < SCENE_DYNAMIC_STORAGE_BUFFER_COUNT)
+	{
+		W::Logger::PrintFormat("[Renderer] %s: %u dynamic storage buffers per descriptor set, %u needed\n", deviceProperties.deviceName, deviceProperties.limits.maxDescriptorSetStorageBuffersDynamic, SCENE_DYNAMIC_STORAGE_BUFFER_COUNT);
+		return false;
+	}
 
-	VkPhysicalDeviceType desiredDeviceType = VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU; // works on my machine
-	return extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && deviceProperties.deviceType == desiredDeviceType;
+	return extensionsSupported && swapChainAdequate && supportedFeatures.samplerAnisotropy && supportedFeatures.drawIndirectFirstInstance;
 }
 
 bool Renderer::CheckDeviceExtensionSupport(VkPhysicalDevice device)
@@ -1714,7 +3530,8 @@ QueueFamilyIndices Renderer::FindQueueFamilies(VkPhysicalDevice device)
 	int i = 0;
 	for (const auto& queueFamily : queueFamilies)
 	{
-		if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+		// the culling pass is recorded into the graphics command buffer
+		if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT))
 		{
 			indices.GraphicsFamily = i;
 		}
@@ -1735,6 +3552,22 @@ QueueFamilyIndices Renderer::FindQueueFamilies(VkPhysicalDevice device)
 		i++;
 	}
 
+	// A transfer only family copies concurrently with the graphics queue
+	for (int family = 0; family < static_cast<int>(queueFamilyCount); family++)
+	{
+		const VkQueueFamilyProperties& queueFamily = queueFamilies[family];
+		if (queueFamily.queueCount > 0 && (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && (queueFamily.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) == 0)
+		{
+			indices.TransferFamily = family;
+			break;
+		}
+	}
+
+	if (indices.TransferFamily < 0)
+	{
+		indices.TransferFamily = indices.GraphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -4,6 +4,14 @@
 
 #include <vulkan/vulkan.h>
 
+#include <Framework.Graphics/Backend.Vulkan/MemoryAllocator.h>
+#include <Framework.Graphics/Backend.Vulkan/PipelineCache.h>
+#include <Framework.Graphics/Backend.Vulkan/UploadQueue.h>
+#include <Framework.Math/LightClusters.h>
+#include <Framework.Math/ShadowCascades.h>
+#include <Framework.Math/Transform.h>
+
+#include <array>
 #include <unordered_map>
 #include <memory>
 
@@ -19,6 +27,9 @@ struct QueueFamilyIndices
 	int GraphicsFamily = -1;
 	int PresentFamily = -1;
 
+	// A transfer only family when the device has one, the graphics family otherwise
+	int TransferFamily = -1;
+
 	bool IsComplete()
 	{
 		return GraphicsFamily >= 0 && PresentFamily >= 0;
@@ -34,21 +45,6 @@ struct SwapChainSupportDetails
 
 struct UniformBufferObject
 {
-	struct Light
-	{
-		alignas(16) glm::vec3	Position;
-		alignas(4)  int			Type;
-
-		alignas(16) glm::vec3	Direction;
-		alignas(4)  float		Range;
-
-		alignas(16) glm::vec3	Color;
-		alignas(4)  float		Intensity;
-
-		alignas(4)  float		InnerAngle;
-		alignas(4)  float		OuterAngle;
-	};
-
 	alignas(64) glm::mat4	View;
 	alignas(64) glm::mat4	Projection;
 	alignas(16) glm::vec3	CameraPosition;
@@ -64,13 +60,91 @@ struct UniformBufferObject
 	alignas(16) glm::vec3	MaterialSpecularColor;
 	alignas(4)  float		MaterialRoughness;
 
-	alignas(4)  int			LightCount;
-	alignas(16) Light		Lights[8];
+	alignas(4)  int			DirectionalLightCount; // the first lights, lit every pixel
+	alignas(16) glm::uvec4	ClusterCount;
+	alignas(16) glm::vec4	ClusterScale; // framebuffer to tile scales, depth slice scale and bias
+
+	alignas(16) glm::mat4	InverseViewProjection; // clip space to world space, for the deferred lighting
+};
+
+// Scene light read by the fragment shaders, std430 layout of lighting.glsl
+struct LightConstants
+{
+	alignas(16) glm::vec3	Position;
+	alignas(4)  int			Type;
+
+	alignas(16) glm::vec3	Direction;
+	alignas(4)  float		Range;
+
+	alignas(16) glm::vec3	Color;
+	alignas(4)  float		Intensity;
+
+	alignas(4)  float		InnerAngle;
+	alignas(4)  float		OuterAngle;
+	alignas(4)  int			ShadowIndex; // first shadow view of the light, one per cube face for a point light, -1 without shadows
+};
+
+// Scene instance data read by the culling pass, std430 layout of cull.comp
+struct CullInstance
+{
+	alignas(16) glm::vec4	BoundingSphere; // center and radius in model space
+	alignas(4)  uint32_t	DrawIndex;
+};
+
+struct CullConstants
+{
+	alignas(16) glm::vec4	FrustumPlanes[6];
+	alignas(4)  uint32_t	InstanceCount;
+};
+
+// Features a graphics pipeline is specialized for, the light type bits follow LightType
+enum ShaderFeature : uint32_t
+{
+	ShaderFeature_DirectionalLights	= 1 << 0,
+	ShaderFeature_PointLights		= 1 << 1,
+	ShaderFeature_SpotLights		= 1 << 2,
+	ShaderFeature_AreaLights		= 1 << 3,
+	ShaderFeature_LightTypes		= 0xF,
+	ShaderFeature_Textured			= 1 << 4,
+	ShaderFeature_DepthOnly			= 1 << 5, // depth pre-pass, positions only
+	ShaderFeature_DepthEqual		= 1 << 6, // shades the fragments left by the depth pre-pass, without depth writes
+	ShaderFeature_GBuffer			= 1 << 7, // fills the G-buffer of the deferred path instead of shading
+	ShaderFeature_Shadow			= 1 << 8, // renders the depth of the casters into a shadow map tile, with the depth only feature
+};
+
+// GPU time of the passes of a frame, measured between consecutive timestamps
+enum GpuTimer : uint32_t
+{
+	GpuTimer_Cull,
+	GpuTimer_Shadows, // the shadow views updated this frame
+	GpuTimer_DepthPrepass,
+	GpuTimer_Geometry, // forward shading or G-buffer fill
+	GpuTimer_Lighting, // deferred lighting, nothing on the forward path
+	GpuTimer_Count
+};
+
+// Color attachments of the deferred geometry subpass, after the swap chain image and the depth
+enum GBufferAttachment : uint32_t
+{
+	GBuffer_Albedo, // diffuse color and roughness
+	GBuffer_Normal,
+	GBuffer_Count
 };
 
-struct UniformPushConstant
+// Depth images the shadow views are rendered to, one square tile per view
+enum ShadowMapType : uint32_t
 {
-	alignas(64) glm::mat4	Model;
+	ShadowMap_Cascades, // the cascades of the sun, two by two
+	ShadowMap_Atlas, // the cube faces of the point lights and the spot lights
+	ShadowMap_Count
+};
+
+// Specialization constants of shader.frag, gbuffer.frag and deferred.frag
+struct ShaderSpecialization
+{
+	uint32_t	LightTypes;
+	VkBool32	Textured;
+	uint32_t	MaxClusterLights;
 };
 
 class Renderer
@@ -96,10 +170,15 @@ private:
 	VkPhysicalDevice mPhysicalDevice = VK_NULL_HANDLE;
 	VkDevice mDevice;
 
+	W::VK::MemoryAllocator mMemoryAllocator;
+	W::VK::UploadQueue mUploadQueue;
+	W::VK::PipelineCache mPipelineCache;
+
 	VkQueue mGraphicsQueue;
 	VkQueue mPresentQueue;
+	VkQueue mTransferQueue;
 
-	VkSwapchainKHR mSwapChain;
+	VkSwapchainKHR mSwapChain = VK_NULL_HANDLE;
 	std::vector<VkImage> mSwapChainImages;
 	VkFormat mSwapChainImageFormat;
 	VkExtent2D mSwapChainExtent;
@@ -107,21 +186,150 @@ private:
 	std::vector<VkFramebuffer> mSwapChainFramebuffers;
 
 	VkRenderPass mRenderPass;
+	// G-buffer subpass then lighting subpass, followed by the overlay pass drawing the UI on top
+	VkRenderPass mDeferredRenderPass;
+	VkRenderPass mOverlayRenderPass; // compatible with mRenderPass, keeps the color of the deferred pass
 	VkDescriptorSetLayout mDescriptorSetLayout;
 	VkDescriptorSetLayout mDescriptorSetLayout2;
 	VkPipelineLayout mPipelineLayout;
-	VkPipeline mGraphicsPipeline;
+	VkShaderModule mVertShaderModule;
+	VkShaderModule mFragShaderModule;
+	VkShaderModule mDepthShaderModule;
+	VkShaderModule mGBufferShaderModule;
+	VkShaderModule mShadowShaderModule;
+	// Specialized for the shader features of the materials, created the first time a material needs them
+	std::unordered_map<uint32_t, VkPipeline> mGraphicsPipelines;
+	// Light types of the scene, every pipeline is specialized for them
+	uint32_t mSceneShaderFeatures = 0;
+
+	VkDescriptorSetLayout mCullDescriptorSetLayout;
+	VkPipelineLayout mCullPipelineLayout;
+	VkPipeline mCullPipeline;
+	VkDescriptorSet mCullDescriptorSet = VK_NULL_HANDLE;
+	bool mMultiDrawIndirect = false;
+
+	// Material independent bindings, read by the depth pre-pass and the deferred lighting
+	VkDescriptorSet mSceneDescriptorSet = VK_NULL_HANDLE;
+
+	// Reads the G-buffer as input attachments, specialized for the light types of the scene
+	VkDescriptorSetLayout mGBufferDescriptorSetLayout;
+	VkPipelineLayout mLightingPipelineLayout;
+	VkPipeline mLightingPipeline = VK_NULL_HANDLE;
+
+	// Depth only pass rendering a shadow view into the tile of a shadow map, keeping the other tiles
+	VkRenderPass mShadowRenderPass;
+	VkSampler mShadowSampler;
+
+	struct ShadowMap
+	{
+		uint32_t Size;
+		VkImage Image;
+		W::VK::MemoryAllocation ImageMemory;
+		VkImageView ImageView;
+		VkFramebuffer Framebuffer;
+	};
+
+	// A light view cached in a shadow map tile, rendered again only once it is dirty and the frame has budget left
+	struct ShadowView
+	{
+		ShadowMapType MapType;
+		VkRect2D Tile;
+		glm::mat4 TileTransform; // clip space to the texture coordinates of the tile
+		glm::mat4 ViewProjection; // the tile was rendered with it, the shaders keep sampling with it until the next update
+		glm::mat4 TargetViewProjection;
+		uint64_t RenderedFrame;
+		bool IsDirty;
+	};
+
+	std::array<ShadowMap, ShadowMap_Count> mShadowMaps;
+	// The cascades of the sun first, then the views of the lights LightConstants::ShadowIndex refers to
+	std::vector<ShadowView> mShadowViews;
+	std::vector<uint32_t> mUpdatedShadowViews; // rendered by the current frame
+	// Model matrices the shadow views were rendered with, any caster moving dirties them all
+	std::vector<W::Math::Matrix4> mShadowCasterMatrices;
+
+	// GpuTimer_Count + 1 timestamps per frame in flight, none when the graphics queue has no timestamps
+	VkQueryPool mTimestampQueryPool = VK_NULL_HANDLE;
+	float mTimestampPeriod = 0.0f; // nanoseconds per tick
+	float mGpuTimes[GpuTimer_Count] = {}; // milliseconds
 
 	VkCommandPool mCommandPool;
 
 	VkImage mDepthImage;
-	VkDeviceMemory mDepthImageMemory;
+	W::VK::MemoryAllocation mDepthImageMemory;
 	VkImageView mDepthImageView;
 
+	// Transient attachments of the deferred pass, the set reading them is replaced with the swap chain
+	std::array<VkImage, GBuffer_Count> mGBufferImages;
+	std::array<W::VK::MemoryAllocation, GBuffer_Count> mGBufferImageMemory;
+	std::array<VkImageView, GBuffer_Count> mGBufferImageViews;
+	std::vector<VkFramebuffer> mDeferredFramebuffers;
+	VkDescriptorPool mGBufferDescriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet mGBufferDescriptorSet = VK_NULL_HANDLE;
+
 	std::unique_ptr<Scene> mScene;
 
-	VkBuffer mUniformBuffers;
-	VkDeviceMemory mUniformBuffersMemory;
+	// Constants written by the CPU every frame, each frame in flight owns the slices it allocated until its fence signals
+	W::VK::RingBuffer mFrameConstants;
+	VkDeviceSize mFrameConstantsAlignment = 0;
+
+	// Every geometry of the scene, at their BaseVertex and FirstIndex
+	VkBuffer mSceneVertexBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mSceneVertexBufferMemory;
+	VkBuffer mSceneIndexBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mSceneIndexBufferMemory;
+	// Positions of the scene vertices alone, read by the depth pre-pass
+	VkBuffer mScenePositionBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mScenePositionBufferMemory;
+	uint64_t mSceneUploadSerial = 0;
+
+	// Meshes of the models sharing a geometry and a material, drawn with one instanced draw
+	struct InstancedDraw
+	{
+		Geometry* SharedGeometry;
+		Mesh DrawMesh;
+		uint32_t FirstInstance;
+		uint32_t InstanceCount;
+	};
+
+	// The instanced draws of a material are contiguous and issued with one indirect draw
+	struct MaterialDraws
+	{
+		int MaterialIndex;
+		uint32_t FirstDraw;
+		uint32_t DrawCount;
+	};
+
+	std::vector<InstancedDraw> mInstancedDraws;
+	std::vector<MaterialDraws> mMaterialDraws;
+	// Model of each instance, the instances of a draw are contiguous
+	std::vector<const Model*> mInstanceModels;
+
+	// Static culling data of the instances, and the draw commands with no instance the culling pass starts from
+	VkBuffer mCullInstanceBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mCullInstanceBufferMemory;
+	VkBuffer mDrawCommandTemplateBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mDrawCommandTemplateBufferMemory;
+
+	// Written by the culling pass, one region per frame in flight
+	VkBuffer mDrawCommandBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mDrawCommandBufferMemory;
+	VkDeviceSize mDrawCommandRegionSize = 0;
+	VkBuffer mVisibleInstanceBuffer = VK_NULL_HANDLE;
+	W::VK::MemoryAllocation mVisibleInstanceBufferMemory;
+	VkDeviceSize mVisibleInstanceRegionSize = 0;
+
+	// Model matrices gathered in instance order for the object transforms batch
+	std::vector<W::Math::Matrix4> mObjectMatrices;
+
+	// Scene lights with the directional ones first, the others are binned into the view clusters every frame
+	std::vector<LightConstants> mLights;
+	uint32_t mDirectionalLightCount = 0;
+	W::Math::ClusterGrid mClusterGrid;
+	std::vector<W::Math::LightSphere> mLightSpheres;
+	// Offset and light count of every cluster followed by the light indices, as read by shader.frag
+	std::vector<uint32_t> mLightClusters;
+	bool mReportedDroppedLights = false; // the indices dropped from the clusters are logged once per scene
 
 	VkDescriptorPool mDescriptorPool;
 
@@ -134,9 +342,42 @@ private:
 		VkFence             Fence;
 		VkSemaphore         ImageAcquiredSemaphore;
 		VkSemaphore         RenderCompleteSemaphore;
+
+		// Upload semaphores waited by the frame submission
+		std::vector<VkSemaphore> UploadSemaphores;
+
+		// Frame constants ring head after the frame was recorded
+		uint64_t ConstantsHead = 0;
+
+		bool HasTimestamps = false;
 	};
 
 	std::vector<FrameData> mFrameData;
+	uint64_t mFrameCount = 0; // frames submitted
+
+	// Swap chain resources replaced by a resize, destroyed once the frames using them are complete
+	struct RetiredSwapChain
+	{
+		uint64_t FrameCount;
+		VkSwapchainKHR SwapChain;
+		std::vector<VkImageView> ImageViews;
+		std::vector<VkFramebuffer> Framebuffers;
+		VkImage DepthImage;
+		W::VK::MemoryAllocation DepthImageMemory;
+		VkImageView DepthImageView;
+		std::array<VkImage, GBuffer_Count> GBufferImages;
+		std::array<W::VK::MemoryAllocation, GBuffer_Count> GBufferImageMemory;
+		std::array<VkImageView, GBuffer_Count> GBufferImageViews;
+		std::vector<VkFramebuffer> DeferredFramebuffers;
+		VkDescriptorPool GBufferDescriptorPool;
+	};
+
+	std::vector<RetiredSwapChain> mRetiredSwapChains;
+
+	// Uploaded textures waiting for the graphics queue to generate their mip levels
+	std::vector<Texture*> mPendingTextures;
+	// Bound by the untextured materials, their pipelines do not sample it
+	std::unique_ptr<Texture> mWhiteTexture;
 
 	VkAllocationCallbacks mAllocationCallbacks;
 
@@ -154,48 +395,78 @@ private:
 
 	void CleanupSwapChain();
 	void RecreateSwapChain();
+	void RetireSwapChain();
+	void DestroyRetiredSwapChains();
+	void DestroySwapChain(RetiredSwapChain& swapChain);
 
 	void CreateInstance();
 	void CreateSurface();
 
 	void PickPhysicalDevice();
 	void CreateLogicalDevice();
+	void CreateMemoryAllocator();
+	void CreateUploadQueue();
+	void CreatePipelineCache();
 
 	void CreateSwapChain();
 	void CreateFrameData();
 	void CreateImageViews();
 	void CreateRenderPass();
+	void CreateDeferredRenderPass();
 	void CreateDescriptorSetLayout();
-	void CreateGraphicsPipeline();
+	void CreateGraphicsPipelineLayout();
+	VkPipeline GetGraphicsPipeline(uint32_t shaderFeatures);
+	VkPipeline CreateGraphicsPipeline(uint32_t shaderFeatures);
+	void CreateCullPipeline();
+	void CreateLightingPipeline();
 	void CreateFramebuffers();
 	void CreateCommandPool();
 	void CreateDepthResources();
+	void CreateGBufferResources();
+	void CreateShadowResources();
 
 	void CreateTextureImage(Texture* texture);
+	void DestroyTexture(Texture* texture);
 	void CreateMaterial(Material* material);
+	void WriteDescriptorSet(VkDescriptorSet descriptorSet, const Texture* texture);
 
-	void GenerateMipmaps(VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	void GenerateMipmaps(VkCommandBuffer commandBuffer, VkImage image, VkFormat imageFormat, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
 
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
-	void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-	void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-	void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+	void CreateImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, W::VK::MemoryAllocation& imageMemory);
+	void TransitionImageLayout(VkCommandBuffer commandBuffer, VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
 
 	void LoadScene();
 
-	void CreateVertexBuffer(Model* model);
-	void CreateIndexBuffer(Model* model);
-
-	void CreateUniformBuffers();
+	void CreateGeometryBuffers();
+	void CreateInstancedDraws();
+	void CreateCullResources();
+	void CreateLightClusters();
+	void CreateShadowViews();
+	void CreateSceneDescriptorSet();
+
+	void CreateFrameConstants();
+	void CreateTimestampQueries();
+	void ReadTimestamps(FrameData& frameData);
+	void WriteTimestamp(VkCommandBuffer commandBuffer, uint32_t timestamp);
 	void CreateDescriptorPool();
-	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, W::VK::MemoryAllocation& bufferMemory);
 
 	VkCommandBuffer BeginSingleTimeCommands();
 	void EndSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-	void CopyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
-
-	void UpdateUniformBuffer(VkCommandBuffer commandBuffer);
+	// Slice of the frame constants ring, bound with a dynamic offset
+	void* AllocateFrameConstants(VkDeviceSize size, uint32_t& outOffset);
+	uint32_t UpdateUniformBuffer(glm::mat4& outView, glm::mat4& outProjection);
+	// Model, normal and model view projection matrices of every instance, returns the offset of the first one
+	uint32_t UpdateObjectTransforms(const glm::mat4& viewProjection);
+	// Fills the instance counts of the draw commands and the visible instances of the frame regions
+	void CullInstances(VkCommandBuffer commandBuffer, const glm::mat4& viewProjection, uint32_t objectTransformsOffset, uint32_t drawCommandsOffset, uint32_t visibleInstancesOffset);
+	// Lights of the frame and the clusters they were binned into
+	void UpdateLightClusters(const glm::mat4& view, const glm::mat4& projection, uint32_t& outLightsOffset, uint32_t& outLightClustersOffset);
+	// Dirties the shadow views that moved and picks the ones rendered within the budget, returns the offset of their matrices
+	uint32_t UpdateShadowViews(const glm::mat4& view, const glm::mat4& projection, bool canRender);
+	void RenderShadowViews(VkCommandBuffer commandBuffer, const uint32_t* dynamicOffsets, uint32_t dynamicOffsetCount);
 
 	VkShaderModule CreateShaderModule(const std::vector<char>& code);
 	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
@@ -208,7 +479,6 @@ private:
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
 	std::vector<const char*> GetRequiredExtensions();
 	bool CheckValidationLayerSupport();
-	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
 };
 
 
@@ -1,9 +1,21 @@
 #include "Scene.h"
 
+#include <Framework/Hash.h>
 #include <Framework.Debug/Debug.h>
+#include <Framework.Geometry/VertexCache.h>
+#include <Framework.Geometry/VertexWeld.h>
+#include <Framework.IO/FileSystem.h>
+#include <Framework.IO/MappedFile.h>
+#include <Framework.Text/Text.h>
 
 #include <glm/glm.hpp>
 
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <unordered_map>
+
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -11,26 +23,71 @@
 
 static const int TRIANGLE_VERTEX_COUNT = 3;
 
+// Quantization grid used when welding vertices, zero only welds bitwise equal vertices
+static const float VERTEX_WELD_EPSILON = 0.0f;
+
+// Axis and unit system the FBX scenes are converted to (Blender)
+static const FbxAxisSystem::EPreDefinedAxisSystem IMPORT_AXIS_SYSTEM = FbxAxisSystem::eMayaZUp;
+static const FbxSystemUnit& IMPORT_SYSTEM_UNIT = FbxSystemUnit::m;
+
+// Bump whenever the conversion changes, to invalidate the cooked scenes in the cache
+static const uint32_t IMPORTER_VERSION = 3;
+
+static const char* SCENE_CACHE_DIRECTORY = "Build\\SceneCache";
+
 //////////////////////////////////////////////////////////////////////////
 //                                Texture                               //
 //////////////////////////////////////////////////////////////////////////
-std::unique_ptr<Texture> Texture::Load(const char* filePath)
+// A missing or corrupt image is replaced by a white pixel, released by DestroyPixelBuffer like the decoded ones
+static void DecodeTexture(Texture* texture)
 {
 	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(filePath, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	Debug_AssertMsg(pixels != nullptr, "failed to load texture image!");
+	stbi_uc* pixels = stbi_load(texture->FilePath.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (pixels == nullptr)
+	{
+		W::Logger::PrintFormat("[Scene] failed to load %s (%s), using a white texture\n", texture->FilePath.c_str(), stbi_failure_reason());
+
+		texWidth = 1;
+		texHeight = 1;
+		texChannels = 4;
+		pixels = static_cast<stbi_uc*>(malloc(4));
+		memset(pixels, 0xFF, 4);
+	}
 
-	std::unique_ptr<Texture> texture = std::make_unique<Texture>();
 	texture->TextureWidth = texWidth;
 	texture->TextureHeight = texHeight;
 	texture->TextureChannels = texChannels;
 	texture->Pixels = pixels;
+}
+
+std::unique_ptr<Texture> Texture::Load(const char* filePath)
+{
+	std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+	texture->FilePath = filePath;
+	DecodeTexture(texture.get());
+
+	return texture;
+}
+
+std::unique_ptr<Texture> Texture::LoadAsync(const char* filePath, W::JobSystem& jobSystem)
+{
+	std::unique_ptr<Texture> texture = std::make_unique<Texture>();
+	texture->FilePath = filePath;
+
+	Texture* decodedTexture = texture.get();
+	jobSystem.Run([decodedTexture]()
+	{
+		DecodeTexture(decodedTexture);
+	}, &texture->Decoded);
 
 	return texture;
 }
 
 void Texture::DestroyPixelBuffer()
 {
+	if (Pixels == nullptr)
+		return;
+
 	stbi_image_free(Pixels);
 	Pixels = nullptr;
 }
@@ -65,7 +122,7 @@ static glm::mat4x4 FbxToGlm(const FbxDouble4x4& in)
 
 static void UpdateSceneObject(SceneObject& obj, FbxObject* fbxObject)
 {
-	obj.Name = fbxObject->GetName();
+	obj.Name = W::Name(fbxObject->GetName());
 }
 
 static void UpdateSceneNode(SceneNode& obj, FbxNode* fbxNode)
@@ -79,8 +136,113 @@ static void UpdateSceneNode(SceneNode& obj, FbxNode* fbxNode)
 	obj.LocalTransform = FbxToGlm(localTransform);
 }
 
-static void BuildMaterials(Scene& scene, FbxScene* fbxScene)
+// Shares a texture between every material referencing the same image, so each image is decoded and uploaded once
+// Images are matched by normalized path first, then by content hash to catch copies of the same file
+class TextureRegistry
 {
+public:
+	TextureRegistry(Scene& scene, W::JobSystem& jobSystem)
+		: mScene(scene)
+		, mJobSystem(jobSystem)
+	{
+	}
+
+	Texture* Get(const char* filePath)
+	{
+		++mReferenceCount;
+
+		const std::string normalizedPath = NormalizePath(filePath);
+		auto pathEntry = mEntriesByPath.find(normalizedPath);
+		if (pathEntry != mEntriesByPath.end())
+			return Share(pathEntry->second);
+
+		// The file is read once to hash it, which is cheap next to decoding it
+		Entry entry = {};
+		uint64_t contentHash = 0;
+		W::IO::MappedFile imageFile;
+		const bool hasContent = imageFile.Open(filePath);
+		if (hasContent)
+		{
+			contentHash = W::Hash::BufferHash64(imageFile.Data(), imageFile.Size());
+			entry.FileSize = imageFile.Size();
+
+			// Only the header is parsed, the decoded size is what a duplicate costs in memory
+			int width, height, channels;
+			if (stbi_info_from_memory(static_cast<const stbi_uc*>(imageFile.Data()), static_cast<int>(imageFile.Size()), &width, &height, &channels))
+			{
+				entry.PixelSize = static_cast<uint64_t>(width) * height * STBI_rgb_alpha;
+			}
+
+			auto contentEntry = mEntriesByContent.find(contentHash);
+			if (contentEntry != mEntriesByContent.end())
+			{
+				mEntriesByPath.emplace(normalizedPath, contentEntry->second);
+				return Share(contentEntry->second);
+			}
+		}
+		imageFile.Close();
+
+		std::unique_ptr<Texture> texture = Texture::LoadAsync(filePath, mJobSystem);
+		entry.SharedTexture = texture.get();
+		mScene.Textures.push_back(std::move(texture));
+
+		mEntriesByPath.emplace(normalizedPath, entry);
+		if (hasContent)
+		{
+			mEntriesByContent.emplace(contentHash, entry);
+		}
+		return entry.SharedTexture;
+	}
+
+	void PrintStats() const
+	{
+		if (mReferenceCount == 0)
+			return;
+
+		W::Logger::PrintFormat("[Scene] %u texture references share %u textures, saved %llu file bytes and %llu pixel bytes\n",
+			mReferenceCount, static_cast<uint32_t>(mScene.Textures.size()), (unsigned long long)mFileBytesSaved, (unsigned long long)mPixelBytesSaved);
+	}
+
+private:
+	struct Entry
+	{
+		Texture* SharedTexture;
+		uint64_t FileSize;
+		uint64_t PixelSize;
+	};
+
+	// Absolute, lower case path as the file system is case insensitive
+	static std::string NormalizePath(const char* filePath)
+	{
+		char fullPath[_MAX_PATH];
+		std::string normalizedPath = (_fullpath(fullPath, filePath, _MAX_PATH) != nullptr) ? fullPath : filePath;
+		for (char& c : normalizedPath)
+		{
+			c = (c == '/') ? '\\' : static_cast<char>(tolower(static_cast<unsigned char>(c)));
+		}
+		return normalizedPath;
+	}
+
+	Texture* Share(const Entry& entry)
+	{
+		mFileBytesSaved += entry.FileSize;
+		mPixelBytesSaved += entry.PixelSize;
+		return entry.SharedTexture;
+	}
+
+	Scene& mScene;
+	W::JobSystem& mJobSystem;
+	std::unordered_map<std::string, Entry> mEntriesByPath;
+	std::unordered_map<uint64_t, Entry> mEntriesByContent;
+	uint32_t mReferenceCount = 0;
+	uint64_t mFileBytesSaved = 0;
+	uint64_t mPixelBytesSaved = 0;
+};
+
+static void BuildMaterials(Scene& scene, FbxScene* fbxScene, W::JobSystem& jobSystem)
+{
+	TextureRegistry textureRegistry(scene, jobSystem);
+
 	int materialCount = fbxScene->GetMaterialCount();
 	for (int i = 0; i < materialCount; ++i)
 	{
@@ -100,21 +262,68 @@ static void BuildMaterials(Scene& scene, FbxScene* fbxScene)
 				{
 					const char* filePath = fbxTexture->GetFileName();
 
-					std::unique_ptr<Texture> texture = Texture::Load(filePath);
-					material->DiffuseTexture = texture.get();
-					scene.Textures.push_back(std::move(texture));
+					// decoded by the workers while the meshes are converted
+					material->DiffuseTexture = textureRegistry.Get(filePath);
 				}
 			}
 		}
 
 		scene.Materials.push_back(std::move(material));
 	}
+
+	textureRegistry.PrintStats();
 }
 
-static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, FbxMesh* fbxMesh)
+static void WeldVertices(Geometry& geometry)
 {
-	std::unique_ptr<Model> model = std::make_unique<Model>();
-	UpdateSceneNode(*model, fbxNode);
+	static_assert(sizeof(Vertex) % sizeof(float) == 0, "vertex welding expects a vertex made of floats");
+
+	std::vector<uint32_t> remap(geometry.Vertices.size());
+	size_t uniqueVertexCount = W::Geometry::GenerateVertexRemap(remap.data(), geometry.Vertices.data(), geometry.Vertices.size(), sizeof(Vertex), VERTEX_WELD_EPSILON);
+
+	std::vector<Vertex> vertices(uniqueVertexCount);
+	W::Geometry::RemapVertexBuffer(vertices.data(), geometry.Vertices.data(), geometry.Vertices.size(), sizeof(Vertex), remap.data());
+	W::Geometry::RemapIndexBuffer(geometry.Indices.data(), geometry.Indices.data(), geometry.Indices.size(), remap.data());
+
+	geometry.Vertices = std::move(vertices);
+}
+
+static void OptimizeMesh(Geometry& geometry)
+{
+	const W::Geometry::VertexCacheStatistics before = W::Geometry::AnalyzeVertexCache(geometry.Indices.data(), geometry.Indices.size(), geometry.Vertices.size());
+
+	// Reorder the triangles of each mesh for the post-transform cache, then sort them from the outside in to reduce overdraw
+	std::vector<uint32_t> indices(geometry.Indices.size());
+	for (const Mesh& mesh : geometry.Meshs)
+	{
+		const size_t indexCount = mesh.TriangleCount * TRIANGLE_VERTEX_COUNT;
+		uint32_t* meshIndices = geometry.Indices.data() + mesh.IndexOffset;
+		uint32_t* optimizedIndices = indices.data() + mesh.IndexOffset;
+
+		W::Geometry::OptimizeVertexCache(optimizedIndices, meshIndices, indexCount, geometry.Vertices.size());
+		W::Geometry::OptimizeOverdraw(meshIndices, optimizedIndices, indexCount, &geometry.Vertices[0].Position.x, geometry.Vertices.size(), sizeof(Vertex));
+	}
+
+	// Reorder the vertices in the order the meshes fetch them
+	std::vector<Vertex> vertices(geometry.Vertices.size());
+	size_t vertexCount = W::Geometry::OptimizeVertexFetch(vertices.data(), geometry.Indices.data(), geometry.Indices.size(), geometry.Vertices.data(), geometry.Vertices.size(), sizeof(Vertex));
+	vertices.resize(vertexCount);
+	geometry.Vertices = std::move(vertices);
+
+	const W::Geometry::VertexCacheStatistics after = W::Geometry::AnalyzeVertexCache(geometry.Indices.data(), geometry.Indices.size(), geometry.Vertices.size());
+
+	W::Logger::PrintFormat("[Scene] %s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%d triangles, %d vertices)\n",
+		geometry.Name.GetText(),
+		before.ACMR, after.ACMR,
+		before.ATVR, after.ATVR,
+		(int)(geometry.Indices.size() / TRIANGLE_VERTEX_COUNT), (int)geometry.Vertices.size());
+}
+
+// Converted once per FBX mesh, the mesh materials are the material slots of the nodes
+static Geometry* BuildGeometry(Scene& scene, FbxMesh* fbxMesh)
+{
+	std::unique_ptr<Geometry> geometry = std::make_unique<Geometry>();
+	UpdateSceneObject(*geometry, fbxMesh);
 
 	fbxMesh->RemoveBadPolygons();
 	fbxMesh->GenerateNormals();
@@ -138,27 +347,29 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 		{
 			const size_t materialIndex = materialIndexArray->GetAt(polygonIndex);
 			const size_t requiredMeshSize = materialIndex + 1;
-			if (model->Meshs.size() < requiredMeshSize)
+			if (geometry->Meshs.size() < requiredMeshSize)
 			{
-				model->Meshs.resize(requiredMeshSize);
+				geometry->Meshs.resize(requiredMeshSize);
 			}
 
-			model->Meshs[materialIndex].TriangleCount += 1;
+			geometry->Meshs[materialIndex].TriangleCount += 1;
 		}
 	}
 	else if (materialMappingMode == FbxGeometryElement::eAllSame)
 	{
-		model->Meshs.resize(1);
-		model->Meshs[0].TriangleCount = polygonCount;
+		geometry->Meshs.resize(1);
+		geometry->Meshs[0].TriangleCount = polygonCount;
 	}
 
 	// Initialize the index offset values
 	{
 		int currentIndexOffset = 0;
-		for (Mesh& mesh : model->Meshs)
+		for (int i = 0; i < geometry->Meshs.size(); ++i)
 		{
+			Mesh& mesh = geometry->Meshs[i];
+			mesh.MaterialIndex = i;
 			mesh.IndexOffset = currentIndexOffset;
-			currentIndexOffset += mesh.TriangleCount;
+			currentIndexOffset += mesh.TriangleCount * TRIANGLE_VERTEX_COUNT;
 
 			// reset the triangle count to fill in the index buffer
 			mesh.TriangleCount = 0;
@@ -167,7 +378,7 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 
 	// Populate the index array
 	{
-		model->Indices.resize(polygonCount * TRIANGLE_VERTEX_COUNT);
+		geometry->Indices.resize(polygonCount * TRIANGLE_VERTEX_COUNT);
 
 		for (int polygonIndex = 0; polygonIndex < polygonCount; ++polygonIndex)
 		{
@@ -178,35 +389,19 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 				materiaindex = materialIndexArray->GetAt(polygonIndex);
 			}
 
-			Mesh& mesh = model->Meshs[materiaindex];
+			Mesh& mesh = geometry->Meshs[materiaindex];
 			const int polygonIndexOffset = mesh.IndexOffset + (mesh.TriangleCount * TRIANGLE_VERTEX_COUNT);
 
 			for (int vertexIndex = 0; vertexIndex < TRIANGLE_VERTEX_COUNT; ++vertexIndex)
 			{
 				int polygonVertexIndex = (polygonIndex * TRIANGLE_VERTEX_COUNT) + vertexIndex;
-				model->Indices[polygonIndexOffset + vertexIndex] = static_cast<uint32_t>(polygonVertexIndex);
+				geometry->Indices[polygonIndexOffset + vertexIndex] = static_cast<uint32_t>(polygonVertexIndex);
 			}
 
 			mesh.TriangleCount += 1;
 		}
 	}
 
-	// Populate the index array
-	{
-		for (int i = 0; i < model->Meshs.size(); ++i)
-		{
-			FbxSurfaceMaterial* fbxMaterial = fbxMesh->GetNode()->GetMaterial(i);
-			int materialCount = fbxScene->GetMaterialCount();
-			for (int materialIndex = 0; materialIndex < materialCount; ++materialIndex)
-			{
-				if (fbxMaterial == fbxScene->GetMaterial(materialIndex))
-				{
-					model->Meshs[i].MaterialIndex = materialIndex;
-				}
-			}
-		}
-	}
-
 	// Populate the vertex array
 	{
 		const FbxVector4* controlPoints = fbxMesh->GetControlPoints();
@@ -241,7 +436,7 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 			vertexColorSet = fbxMesh->GetLayer(0)->GetVertexColors();
 		}
 
-		model->Vertices.resize(vertexCount);
+		geometry->Vertices.resize(vertexCount);
 
 		for (int polygonIndex = 0; polygonIndex < polygonCount; ++polygonIndex)
 		{
@@ -250,7 +445,7 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 				int polygonVertexIndex = (polygonIndex * TRIANGLE_VERTEX_COUNT) + vertexIndex;
 				int index = fbxMesh->GetPolygonVertex(polygonIndex, vertexIndex);
 
-				Vertex& vertex = model->Vertices[polygonVertexIndex];
+				Vertex& vertex = geometry->Vertices[polygonVertexIndex];
 
 				// Save the vertex position
 				vertex.Position = glm::vec3(
@@ -289,6 +484,10 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 					vertex.UV = FbxToGlm(uv);
 					vertex.UV.y = 1.0f - vertex.UV.y; // inverted V
 				}
+				else
+				{
+					vertex.UV = glm::vec2(0.0f, 0.0f); // keep the vertex fully initialized for welding
+				}
 
 				// Save the vertex color
 				if (vertexColorSet != nullptr)
@@ -310,6 +509,48 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 		}
 	}
 
+	// Share the identical polygon corners between triangles
+	WeldVertices(*geometry);
+	OptimizeMesh(*geometry);
+
+	geometry->VertexData = { geometry->Vertices.data(), geometry->Vertices.size() };
+	geometry->IndexData = { geometry->Indices.data(), geometry->Indices.size() };
+
+	scene.Geometries.push_back(std::move(geometry));
+	return scene.Geometries.back().get();
+}
+
+using GeometryMap = std::unordered_map<const FbxMesh*, Geometry*>;
+
+static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, FbxMesh* fbxMesh, GeometryMap& geometries)
+{
+	// Nodes instancing the same mesh reference one geometry
+	Geometry*& geometry = geometries[fbxMesh];
+	if (geometry == nullptr)
+	{
+		geometry = BuildGeometry(scene, fbxMesh);
+	}
+
+	std::unique_ptr<Model> model = std::make_unique<Model>();
+	UpdateSceneNode(*model, fbxNode);
+	model->SharedGeometry = geometry;
+	model->Meshs = geometry->Meshs;
+
+	// Material slots of this node to scene materials
+	const int materialCount = fbxScene->GetMaterialCount();
+	for (Mesh& mesh : model->Meshs)
+	{
+		FbxSurfaceMaterial* fbxMaterial = fbxNode->GetMaterial(mesh.MaterialIndex);
+		mesh.MaterialIndex = 0;
+		for (int materialIndex = 0; materialIndex < materialCount; ++materialIndex)
+		{
+			if (fbxMaterial == fbxScene->GetMaterial(materialIndex))
+			{
+				mesh.MaterialIndex = materialIndex;
+			}
+		}
+	}
+
 	scene.Models.push_back(std::move(model));
 }
 
@@ -365,7 +606,7 @@ static void BuildResource(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, Fb
 	scene.Lights.push_back(std::move(light));
 }
 
-static void BuildResources(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode)
+static void BuildResources(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode, GeometryMap& geometries)
 {
 	FbxNodeAttribute* nodeAttribute = fbxNode->GetNodeAttribute();
 	if (nodeAttribute != nullptr)
@@ -375,7 +616,7 @@ static void BuildResources(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode)
 			FbxMesh* fbxMesh = fbxNode->GetMesh();
 			if (fbxMesh != nullptr)
 			{
-				BuildResource(scene, fbxScene, fbxNode, fbxMesh);
+				BuildResource(scene, fbxScene, fbxNode, fbxMesh, geometries);
 			}
 		}
 
@@ -401,14 +642,11 @@ static void BuildResources(Scene& scene, FbxScene* fbxScene, FbxNode* fbxNode)
 	const int childCount = fbxNode->GetChildCount();
 	for (int childIndex = 0; childIndex < childCount; ++childIndex)
 	{
-		BuildResources(scene, fbxScene, fbxNode->GetChild(childIndex));
+		BuildResources(scene, fbxScene, fbxNode->GetChild(childIndex), geometries);
 	}
 }
 
-//////////////////////////////////////////////////////////////////////////
-//                                Scene                                 //
-//////////////////////////////////////////////////////////////////////////
-std::unique_ptr<Scene> Scene::Load(const char* filePath)
+static std::unique_ptr<Scene> ImportScene(const char* filePath, W::JobSystem& jobSystem)
 {
 	// The first thing to do is to create the FBX Manager which is the object allocator for almost all the classes in the SDK
 	FbxManager* fbxManager = FbxManager::Create();
@@ -431,7 +669,7 @@ std::unique_ptr<Scene> Scene::Load(const char* filePath)
 		{
 			// Convert Axis System to desired (Blender), if needed
 			FbxAxisSystem sceneAxisSystem = fbxScene->GetGlobalSettings().GetAxisSystem();
-			FbxAxisSystem desiredAxisSystem(FbxAxisSystem::eMayaZUp);
+			FbxAxisSystem desiredAxisSystem(IMPORT_AXIS_SYSTEM);
 			if (sceneAxisSystem != desiredAxisSystem)
 			{
 				desiredAxisSystem.ConvertScene(fbxScene);
@@ -439,7 +677,7 @@ std::unique_ptr<Scene> Scene::Load(const char* filePath)
 
 			// Convert Unit System to desired, if needed
 			FbxSystemUnit sceneSystemUnit = fbxScene->GetGlobalSettings().GetSystemUnit();
-			FbxSystemUnit desiredSystemUnit = FbxSystemUnit::m;
+			FbxSystemUnit desiredSystemUnit = IMPORT_SYSTEM_UNIT;
 			if (sceneSystemUnit != desiredSystemUnit)
 			{
 				desiredSystemUnit.ConvertScene(fbxScene);
@@ -453,8 +691,11 @@ std::unique_ptr<Scene> Scene::Load(const char* filePath)
 			scene = std::make_unique<Scene>();
 
 			// Build the graphics resources
-			BuildMaterials(*scene, fbxScene);
-			BuildResources(*scene, fbxScene, fbxScene->GetRootNode());
+			BuildMaterials(*scene, fbxScene, jobSystem);
+			GeometryMap geometries;
+			BuildResources(*scene, fbxScene, fbxScene->GetRootNode(), geometries);
+
+			W::Logger::PrintFormat("[Scene] %u models share %u geometries\n", static_cast<uint32_t>(scene->Models.size()), static_cast<uint32_t>(scene->Geometries.size()));
 		}
 		else
 		{
@@ -474,5 +715,59 @@ std::unique_ptr<Scene> Scene::Load(const char* filePath)
 	fbxManager->Destroy();
 	fbxManager = nullptr;
 
+	return scene;
+}
+
+//////////////////////////////////////////////////////////////////////////
+//                                Scene                                 //
+//////////////////////////////////////////////////////////////////////////
+// The cache key covers every input of the conversion: the source bytes, the import settings and the importer version
+static bool GetSceneCacheKey(const char* filePath, uint64_t& outKey)
+{
+	W::IO::MappedFile sourceFile;
+	if (sourceFile.Open(filePath) == false)
+		return false;
+
+	uint64_t key = W::Hash::BufferHash64(sourceFile.Data(), sourceFile.Size());
+	key = W::Hash::BufferHash64(&IMPORT_AXIS_SYSTEM, sizeof(IMPORT_AXIS_SYSTEM), key);
+	const double unitScale = IMPORT_SYSTEM_UNIT.GetScaleFactor();
+	key = W::Hash::BufferHash64(&unitScale, sizeof(unitScale), key);
+	key = W::Hash::BufferHash64(&VERTEX_WELD_EPSILON, sizeof(VERTEX_WELD_EPSILON), key);
+	key = W::Hash::BufferHash64(&IMPORTER_VERSION, sizeof(IMPORTER_VERSION), key);
+
+	outKey = key;
+	return true;
+}
+
+std::unique_ptr<Scene> Scene::Load(const char* filePath, W::JobSystem& jobSystem)
+{
+	uint64_t cacheKey;
+	if (GetSceneCacheKey(filePath, cacheKey) == false)
+	{
+		Debug_AssertMsg(false, "failed to open scene");
+		return nullptr;
+	}
+
+	char cachePath[256];
+	W::Text::Format(cachePath, "%s\\%016llx.tbscene", SCENE_CACHE_DIRECTORY, (unsigned long long)cacheKey);
+
+	// Cache hit, the FBX SDK is not involved at all
+	std::unique_ptr<Scene> scene = Scene::LoadCooked(cachePath, jobSystem);
+	if (scene != nullptr)
+	{
+		W::Logger::PrintFormat("[Scene] %s: cache hit %s\n", filePath, cachePath);
+		return scene;
+	}
+
+	W::Logger::PrintFormat("[Scene] %s: cache miss, importing\n", filePath);
+	scene = ImportScene(filePath, jobSystem);
+	if (scene != nullptr)
+	{
+		if (W::IO::MakeDirectory(SCENE_CACHE_DIRECTORY) == false || scene->SaveCooked(cachePath) == false)
+		{
+			W::Logger::PrintFormat("[Scene] failed to write %s\n", cachePath);
+		}
+	}
+
 	return scene;
 }
\ No newline at end of file
@@ -10,9 +10,24 @@
 
 #include <vulkan\vulkan.h>
 
+#include <Framework/StringTable.h>
+#include <Framework.Graphics/Backend.Vulkan/MemoryAllocator.h>
+#include <Framework.IO/MappedFile.h>
+#include <Framework.Jobs/JobSystem.h>
+
+// Non-owning view of CPU data, owned by the scene object or mapped from a cooked scene file
+template <typename T>
+struct ArrayView
+{
+	const T* Data = nullptr;
+	size_t Count = 0;
+
+	size_t SizeInBytes() const { return Count * sizeof(T); }
+};
+
 struct SceneObject
 {
-	std::string	Name;
+	W::Name Name;
 };
 
 struct SceneNode : SceneObject
@@ -24,18 +39,26 @@ struct SceneNode : SceneObject
 struct Texture
 {
 	static std::unique_ptr<Texture> Load(const char* filePath);
+
+	// Decodes the image on the job system, the CPU DataBlock is valid once Decoded is done
+	static std::unique_ptr<Texture> LoadAsync(const char* filePath, W::JobSystem& jobSystem);
 	void DestroyPixelBuffer();
 
+	W::JobCounter Decoded;
+
 	// CPU DataBlock
+	std::string FilePath;
 	int TextureWidth;
 	int TextureHeight;
 	int TextureChannels;
-	void* Pixels;
+	void* Pixels = nullptr;
 
 	// GPU DataBlock
+	uint64_t UploadSerial = 0;
+	bool IsResident = false; // mip levels generated and readable by the shaders
 	uint32_t MipLevels;
 	VkImage TextureImage;
-	VkDeviceMemory TextureImageMemory;
+	W::VK::MemoryAllocation TextureImageMemory;
 	VkImageView TextureImageView;
 	VkSampler TextureSampler;
 };
@@ -47,6 +70,7 @@ struct Material : SceneObject
 
 	// GPU DataBlock
 	VkDescriptorSet DescriptorSets = VK_NULL_HANDLE;
+	uint32_t ShaderFeatures = 0; // the key of the graphics pipelines drawing the material
 };
 
 struct Vertex
@@ -61,10 +85,11 @@ struct Mesh
 {
 	int IndexOffset = 0;
 	int TriangleCount = 0;
-	int MaterialIndex = 0;
+	int MaterialIndex = 0; // scene material of a model mesh, material slot of the node for a geometry mesh
 };
 
-struct Model : SceneNode
+// Vertices and indices of an FBX mesh, shared by every model whose node references that mesh
+struct Geometry : SceneObject
 {
 	std::vector<Mesh> Meshs;
 
@@ -72,11 +97,20 @@ struct Model : SceneNode
 	std::vector<Vertex> Vertices;
 	std::vector<uint32_t> Indices;
 
-	// GPU DataBlock
-	VkBuffer VertexBuffer;
-	VkDeviceMemory VertexBufferMemory;
-	VkBuffer IndexBuffer;
-	VkDeviceMemory IndexBufferMemory;
+	// CPU DataBlock - uploaded to the GPU, views the arrays above or the mapped cooked scene
+	ArrayView<Vertex> VertexData;
+	ArrayView<uint32_t> IndexData;
+
+	// GPU DataBlock - offsets in the scene vertex and index buffers
+	uint32_t BaseVertex = 0;
+	uint32_t FirstIndex = 0;
+};
+
+struct Model : SceneNode
+{
+	// Index ranges of the shared geometry with the materials of this node
+	std::vector<Mesh> Meshs;
+	Geometry* SharedGeometry = nullptr;
 };
 
 struct Camera : SceneNode
@@ -109,11 +143,21 @@ struct Light : SceneNode
 
 struct Scene
 {
-	static std::unique_ptr<Scene> Load(const char* filePath);
+	// Imports the FBX scene, or maps its cooked copy from the scene cache when the source and importer are unchanged
+	// Textures keep decoding on the job system after the scene is returned
+	static std::unique_ptr<Scene> Load(const char* filePath, W::JobSystem& jobSystem);
 
+	// Cooked scenes (.tbscene) are converted scenes that load without the FBX SDK
+	static std::unique_ptr<Scene> LoadCooked(const char* filePath, W::JobSystem& jobSystem);
+	bool SaveCooked(const char* filePath) const;
+
+	std::vector<std::unique_ptr<Geometry>> Geometries;
 	std::vector<std::unique_ptr<Model>> Models;
 	std::vector<std::unique_ptr<Material>> Materials;
 	std::vector<std::unique_ptr<Texture>> Textures;
 	std::vector<std::unique_ptr<Camera>> Cameras;
 	std::vector<std::unique_ptr<Light>> Lights;
+
+	// Backing memory of the model data views when loaded from a cooked scene
+	W::IO::MappedFile CookedFile;
 };
\ No newline at end of file
@@ -0,0 +1,477 @@
+#include "Scene.h"
+
+#include <Framework.Debug/Debug.h>
+
+#include <string.h>
+
+#include <fstream>
+#include <type_traits>
+
+// Cooked scene layout
+// [CookedHeader][Blob]...[Blob], every blob starts on a COOKED_BLOB_ALIGNMENT boundary
+// Scene objects reference their strings, meshes, vertices and indices by offset and count in the blobs, models reference their geometry by index
+static const uint32_t COOKED_SCENE_MAGIC = 'T' | ('B' << 8) | ('S' << 16) | ('C' << 24);
+static const uint32_t COOKED_SCENE_VERSION = 2;
+static const uint64_t COOKED_BLOB_ALIGNMENT = 64;
+static const int32_t COOKED_INVALID_INDEX = -1;
+
+enum CookedBlobType
+{
+	CookedBlob_Strings,
+	CookedBlob_Textures,
+	CookedBlob_Materials,
+	CookedBlob_Geometries,
+	CookedBlob_Models,
+	CookedBlob_Meshs,
+	CookedBlob_Vertices,
+	CookedBlob_Indices,
+	CookedBlob_Cameras,
+	CookedBlob_Lights,
+	CookedBlob_Count
+};
+
+struct CookedBlob
+{
+	uint64_t Offset;
+	uint64_t Size;
+};
+
+struct CookedHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t FileSize;
+	CookedBlob Blobs[CookedBlob_Count];
+};
+
+struct CookedString
+{
+	uint32_t Offset;
+	uint32_t Length;
+};
+
+struct CookedNode
+{
+	CookedString Name;
+	glm::mat4x4 WorldTransform;
+	glm::mat4x4 LocalTransform;
+};
+
+struct CookedTexture
+{
+	CookedString FilePath;
+};
+
+struct CookedMaterial
+{
+	CookedString Name;
+	int32_t DiffuseTexture;
+};
+
+struct CookedGeometry
+{
+	CookedString Name;
+	uint32_t MeshOffset;
+	uint32_t MeshCount;
+	uint32_t VertexOffset;
+	uint32_t VertexCount;
+	uint32_t IndexOffset;
+	uint32_t IndexCount;
+};
+
+struct CookedModel
+{
+	CookedNode Node;
+	uint32_t MeshOffset;
+	uint32_t MeshCount;
+	uint32_t Geometry;
+};
+
+struct CookedCamera
+{
+	CookedNode Node;
+	float FieldOfView;
+};
+
+struct CookedLight
+{
+	CookedNode Node;
+	int32_t LightType;
+	glm::vec3 Color;
+	float Intensity;
+	float InnerAngle;
+	float OuterAngle;
+};
+
+static_assert(std::is_trivially_copyable<Mesh>::value, "meshes are cooked as raw memory");
+static_assert(std::is_trivially_copyable<Vertex>::value, "vertices are cooked as raw memory");
+
+//////////////////////////////////////////////////////////////////////////
+//                           Scene - Writer                             //
+//////////////////////////////////////////////////////////////////////////
+struct CookedWriter
+{
+	std::vector<char> Blobs[CookedBlob_Count];
+
+	template <typename T>
+	uint32_t Append(CookedBlobType type, const T* data, size_t count)
+	{
+		std::vector<char>& blob = Blobs[type];
+		const size_t offset = blob.size() / sizeof(T);
+		const char* bytes = reinterpret_cast<const char*>(data);
+		blob.insert(blob.end(), bytes, bytes + (count * sizeof(T)));
+		return static_cast<uint32_t>(offset);
+	}
+
+	CookedString AppendString(const char* text)
+	{
+		CookedString cookedString;
+		cookedString.Offset = static_cast<uint32_t>(Blobs[CookedBlob_Strings].size());
+		cookedString.Length = static_cast<uint32_t>(strlen(text));
+
+		// null terminated, so the loaded strings can be used in place
+		Append(CookedBlob_Strings, text, cookedString.Length + 1);
+		return cookedString;
+	}
+
+	CookedNode AppendNode(const SceneNode& node)
+	{
+		CookedNode cookedNode;
+		cookedNode.Name = AppendString(node.Name.GetText());
+		cookedNode.WorldTransform = node.WorldTransform;
+		cookedNode.LocalTransform = node.LocalTransform;
+		return cookedNode;
+	}
+};
+
+bool Scene::SaveCooked(const char* filePath) const
+{
+	CookedWriter writer;
+
+	for (const std::unique_ptr<Texture>& texture : Textures)
+	{
+		CookedTexture cookedTexture;
+		cookedTexture.FilePath = writer.AppendString(texture->FilePath.c_str());
+		writer.Append(CookedBlob_Textures, &cookedTexture, 1);
+	}
+
+	for (const std::unique_ptr<Material>& material : Materials)
+	{
+		CookedMaterial cookedMaterial;
+		cookedMaterial.Name = writer.AppendString(material->Name.GetText());
+		cookedMaterial.DiffuseTexture = COOKED_INVALID_INDEX;
+		for (size_t i = 0; i < Textures.size(); ++i)
+		{
+			if (Textures[i].get() == material->DiffuseTexture)
+			{
+				cookedMaterial.DiffuseTexture = static_cast<int32_t>(i);
+			}
+		}
+		writer.Append(CookedBlob_Materials, &cookedMaterial, 1);
+	}
+
+	for (const std::unique_ptr<Geometry>& geometry : Geometries)
+	{
+		CookedGeometry cookedGeometry;
+		cookedGeometry.Name = writer.AppendString(geometry->Name.GetText());
+		cookedGeometry.MeshOffset = writer.Append(CookedBlob_Meshs, geometry->Meshs.data(), geometry->Meshs.size());
+		cookedGeometry.MeshCount = static_cast<uint32_t>(geometry->Meshs.size());
+		cookedGeometry.VertexOffset = writer.Append(CookedBlob_Vertices, geometry->VertexData.Data, geometry->VertexData.Count);
+		cookedGeometry.VertexCount = static_cast<uint32_t>(geometry->VertexData.Count);
+		cookedGeometry.IndexOffset = writer.Append(CookedBlob_Indices, geometry->IndexData.Data, geometry->IndexData.Count);
+		cookedGeometry.IndexCount = static_cast<uint32_t>(geometry->IndexData.Count);
+		writer.Append(CookedBlob_Geometries, &cookedGeometry, 1);
+	}
+
+	for (const std::unique_ptr<Model>& model : Models)
+	{
+		CookedModel cookedModel;
+		cookedModel.Node = writer.AppendNode(*model);
+		cookedModel.MeshOffset = writer.Append(CookedBlob_Meshs, model->Meshs.data(), model->Meshs.size());
+		cookedModel.MeshCount = static_cast<uint32_t>(model->Meshs.size());
+		cookedModel.Geometry = 0;
+		for (size_t i = 0; i < Geometries.size(); ++i)
+		{
+			if (Geometries[i].get() == model->SharedGeometry)
+			{
+				cookedModel.Geometry = static_cast<uint32_t>(i);
+			}
+		}
+		writer.Append(CookedBlob_Models, &cookedModel, 1);
+	}
+
+	for (const std::unique_ptr<Camera>& camera : Cameras)
+	{
+		CookedCamera cookedCamera;
+		cookedCamera.Node = writer.AppendNode(*camera);
+		cookedCamera.FieldOfView = camera->FieldOfView;
+		writer.Append(CookedBlob_Cameras, &cookedCamera, 1);
+	}
+
+	for (const std::unique_ptr<Light>& light : Lights)
+	{
+		CookedLight cookedLight;
+		cookedLight.Node = writer.AppendNode(*light);
+		cookedLight.LightType = static_cast<int32_t>(light->LightType);
+		cookedLight.Color = light->Color;
+		cookedLight.Intensity = light->Intensity;
+		cookedLight.InnerAngle = light->InnerAngle;
+		cookedLight.OuterAngle = light->OuterAngle;
+		writer.Append(CookedBlob_Lights, &cookedLight, 1);
+	}
+
+	// Lay out the blobs after the header
+	CookedHeader header = {};
+	header.Magic = COOKED_SCENE_MAGIC;
+	header.Version = COOKED_SCENE_VERSION;
+
+	uint64_t offset = sizeof(CookedHeader);
+	for (int i = 0; i < CookedBlob_Count; ++i)
+	{
+		offset = (offset + COOKED_BLOB_ALIGNMENT - 1) & ~(COOKED_BLOB_ALIGNMENT - 1);
+		header.Blobs[i].Offset = offset;
+		header.Blobs[i].Size = writer.Blobs[i].size();
+		offset += header.Blobs[i].Size;
+	}
+	header.FileSize = offset;
+
+	std::ofstream file(filePath, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		W::Logger::PrintFormat("[Scene] failed to open %s for writing\n", filePath);
+		return false;
+	}
+
+	static const char padding[COOKED_BLOB_ALIGNMENT] = {};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(CookedHeader));
+	uint64_t written = sizeof(CookedHeader);
+	for (int i = 0; i < CookedBlob_Count; ++i)
+	{
+		file.write(padding, static_cast<std::streamsize>(header.Blobs[i].Offset - written));
+		file.write(writer.Blobs[i].data(), static_cast<std::streamsize>(header.Blobs[i].Size));
+		written = header.Blobs[i].Offset + header.Blobs[i].Size;
+	}
+
+	return file.good();
+}
+
+//////////////////////////////////////////////////////////////////////////
+//                           Scene - Loader                             //
+//////////////////////////////////////////////////////////////////////////
+struct CookedReader
+{
+	const char* Base;
+	const CookedHeader* Header;
+
+	template <typename T>
+	bool Get(CookedBlobType type, const T*& outData, size_t& outCount) const
+	{
+		const CookedBlob& blob = Header->Blobs[type];
+		if ((blob.Offset % COOKED_BLOB_ALIGNMENT) != 0 || (blob.Size % sizeof(T)) != 0)
+			return false;
+
+		outData = reinterpret_cast<const T*>(Base + blob.Offset);
+		outCount = static_cast<size_t>(blob.Size / sizeof(T));
+		return true;
+	}
+
+	const char* GetString(const CookedString& cookedString) const
+	{
+		const CookedBlob& blob = Header->Blobs[CookedBlob_Strings];
+		if (static_cast<uint64_t>(cookedString.Offset) + cookedString.Length >= blob.Size)
+			return nullptr;
+
+		const char* text = Base + blob.Offset + cookedString.Offset;
+		return (text[cookedString.Length] == '\0') ? text : nullptr;
+	}
+
+	bool GetName(const CookedString& cookedString, W::Name& outName) const
+	{
+		const char* text = GetString(cookedString);
+		if (text == nullptr)
+			return false;
+
+		outName = W::Name(text);
+		return true;
+	}
+
+	bool GetNode(const CookedNode& cookedNode, SceneNode& outNode) const
+	{
+		outNode.WorldTransform = cookedNode.WorldTransform;
+		outNode.LocalTransform = cookedNode.LocalTransform;
+		return GetName(cookedNode.Name, outNode.Name);
+	}
+};
+
+static bool IsValidRange(uint32_t offset, uint32_t count, size_t arraySize)
+{
+	return static_cast<uint64_t>(offset) + count <= arraySize;
+}
+
+std::unique_ptr<Scene> Scene::LoadCooked(const char* filePath, W::JobSystem& jobSystem)
+{
+	std::unique_ptr<Scene> scene = std::make_unique<Scene>();
+	if (scene->CookedFile.Open(filePath) == false)
+		return nullptr;
+
+	const size_t fileSize = scene->CookedFile.Size();
+	const CookedHeader* header = static_cast<const CookedHeader*>(scene->CookedFile.Data());
+	if (fileSize < sizeof(CookedHeader) || header->Magic != COOKED_SCENE_MAGIC)
+	{
+		W::Logger::PrintFormat("[Scene] %s is not a cooked scene\n", filePath);
+		return nullptr;
+	}
+
+	if (header->Version != COOKED_SCENE_VERSION || header->FileSize != fileSize)
+	{
+		W::Logger::PrintFormat("[Scene] %s is out of date (version %u, expected %u)\n", filePath, header->Version, COOKED_SCENE_VERSION);
+		return nullptr;
+	}
+
+	for (int i = 0; i < CookedBlob_Count; ++i)
+	{
+		const CookedBlob& blob = header->Blobs[i];
+		if (blob.Offset > fileSize || blob.Size > fileSize - blob.Offset)
+		{
+			W::Logger::PrintFormat("[Scene] %s is truncated\n", filePath);
+			return nullptr;
+		}
+	}
+
+	CookedReader reader;
+	reader.Base = static_cast<const char*>(scene->CookedFile.Data());
+	reader.Header = header;
+
+	const CookedTexture* cookedTextures; size_t textureCount;
+	const CookedMaterial* cookedMaterials; size_t materialCount;
+	const CookedGeometry* cookedGeometries; size_t geometryCount;
+	const CookedModel* cookedModels; size_t modelCount;
+	const Mesh* cookedMeshs; size_t meshCount;
+	const Vertex* cookedVertices; size_t vertexCount;
+	const uint32_t* cookedIndices; size_t indexCount;
+	const CookedCamera* cookedCameras; size_t cameraCount;
+	const CookedLight* cookedLights; size_t lightCount;
+
+	bool isValid = reader.Get(CookedBlob_Textures, cookedTextures, textureCount)
+		&& reader.Get(CookedBlob_Materials, cookedMaterials, materialCount)
+		&& reader.Get(CookedBlob_Geometries, cookedGeometries, geometryCount)
+		&& reader.Get(CookedBlob_Models, cookedModels, modelCount)
+		&& reader.Get(CookedBlob_Meshs, cookedMeshs, meshCount)
+		&& reader.Get(CookedBlob_Vertices, cookedVertices, vertexCount)
+		&& reader.Get(CookedBlob_Indices, cookedIndices, indexCount)
+		&& reader.Get(CookedBlob_Cameras, cookedCameras, cameraCount)
+		&& reader.Get(CookedBlob_Lights, cookedLights, lightCount);
+
+	for (size_t i = 0; isValid && i < textureCount; ++i)
+	{
+		const char* texturePath = reader.GetString(cookedTextures[i].FilePath);
+		isValid = (texturePath != nullptr);
+		if (isValid)
+		{
+			scene->Textures.push_back(Texture::LoadAsync(texturePath, jobSystem));
+		}
+	}
+
+	for (size_t i = 0; isValid && i < materialCount; ++i)
+	{
+		const CookedMaterial& cookedMaterial = cookedMaterials[i];
+
+		std::unique_ptr<Material> material = std::make_unique<Material>();
+		isValid = reader.GetName(cookedMaterial.Name, material->Name)
+			&& cookedMaterial.DiffuseTexture >= COOKED_INVALID_INDEX
+			&& cookedMaterial.DiffuseTexture < static_cast<int32_t>(textureCount);
+
+		if (isValid && cookedMaterial.DiffuseTexture != COOKED_INVALID_INDEX)
+		{
+			material->DiffuseTexture = scene->Textures[cookedMaterial.DiffuseTexture].get();
+		}
+
+		scene->Materials.push_back(std::move(material));
+	}
+
+	for (size_t i = 0; isValid && i < geometryCount; ++i)
+	{
+		const CookedGeometry& cookedGeometry = cookedGeometries[i];
+
+		std::unique_ptr<Geometry> geometry = std::make_unique<Geometry>();
+		isValid = reader.GetName(cookedGeometry.Name, geometry->Name)
+			&& IsValidRange(cookedGeometry.MeshOffset, cookedGeometry.MeshCount, meshCount)
+			&& IsValidRange(cookedGeometry.VertexOffset, cookedGeometry.VertexCount, vertexCount)
+			&& IsValidRange(cookedGeometry.IndexOffset, cookedGeometry.IndexCount, indexCount);
+
+		if (isValid)
+		{
+			geometry->Meshs.assign(cookedMeshs + cookedGeometry.MeshOffset, cookedMeshs + cookedGeometry.MeshOffset + cookedGeometry.MeshCount);
+
+			// The vertices and indices stay in the mapped file until they are copied to the GPU
+			geometry->VertexData = { cookedVertices + cookedGeometry.VertexOffset, cookedGeometry.VertexCount };
+			geometry->IndexData = { cookedIndices + cookedGeometry.IndexOffset, cookedGeometry.IndexCount };
+		}
+
+		scene->Geometries.push_back(std::move(geometry));
+	}
+
+	for (size_t i = 0; isValid && i < modelCount; ++i)
+	{
+		const CookedModel& cookedModel = cookedModels[i];
+
+		std::unique_ptr<Model> model = std::make_unique<Model>();
+		isValid = reader.GetNode(cookedModel.Node, *model)
+			&& IsValidRange(cookedModel.MeshOffset, cookedModel.MeshCount, meshCount)
+			&& cookedModel.Geometry < geometryCount;
+
+		if (isValid)
+		{
+			model->Meshs.assign(cookedMeshs + cookedModel.MeshOffset, cookedMeshs + cookedModel.MeshOffset + cookedModel.MeshCount);
+			model->SharedGeometry = scene->Geometries[cookedModel.Geometry].get();
+
+			for (const Mesh& mesh : model->Meshs)
+			{
+				isValid = isValid
+					&& mesh.IndexOffset >= 0 && mesh.TriangleCount >= 0
+					&& IsValidRange(static_cast<uint32_t>(mesh.IndexOffset), static_cast<uint32_t>(mesh.TriangleCount) * 3, cookedGeometries[cookedModel.Geometry].IndexCount)
+					&& mesh.MaterialIndex >= 0 && mesh.MaterialIndex < static_cast<int>(materialCount);
+			}
+		}
+
+		scene->Models.push_back(std::move(model));
+	}
+
+	for (size_t i = 0; isValid && i < cameraCount; ++i)
+	{
+		std::unique_ptr<Camera> camera = std::make_unique<Camera>();
+		isValid = reader.GetNode(cookedCameras[i].Node, *camera);
+		camera->FieldOfView = cookedCameras[i].FieldOfView;
+		scene->Cameras.push_back(std::move(camera));
+	}
+
+	for (size_t i = 0; isValid && i < lightCount; ++i)
+	{
+		const CookedLight& cookedLight = cookedLights[i];
+
+		std::unique_ptr<Light> light = std::make_unique<Light>();
+		isValid = reader.GetNode(cookedLight.Node, *light)
+			&& cookedLight.LightType >= 0 && cookedLight.LightType < static_cast<int32_t>(LightType::Unknown);
+		light->LightType = static_cast<LightType>(cookedLight.LightType);
+		light->Color = cookedLight.Color;
+		light->Intensity = cookedLight.Intensity;
+		light->InnerAngle = cookedLight.InnerAngle;
+		light->OuterAngle = cookedLight.OuterAngle;
+		scene->Lights.push_back(std::move(light));
+	}
+
+	if (isValid == false)
+	{
+		W::Logger::PrintFormat("[Scene] %s is corrupted\n", filePath);
+
+		// the decode jobs write into the textures, their pixels are not released by the texture
+		for (const std::unique_ptr<Texture>& texture : scene->Textures)
+		{
+			jobSystem.Wait(texture->Decoded);
+			texture->DestroyPixelBuffer();
+		}
+		return nullptr;
+	}
+
+	return scene;
+}
\ No newline at end of file
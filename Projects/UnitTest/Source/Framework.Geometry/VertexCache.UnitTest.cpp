@@ -0,0 +1,141 @@
+#include "pch.h"
+
+#include <Framework.Geometry/VertexCache.h>
+
+#include <algorithm>
+#include <array>
+#include <vector>
+
+namespace W
+{
+	struct CacheVertex
+	{
+		float Position[3];
+		float UV[2];
+	};
+
+	// Indexed grid of quads with the triangles in a scrambled order
+	static void BuildScrambledGrid(int gridSize, std::vector<CacheVertex>& outVertices, std::vector<uint32_t>& outIndices)
+	{
+		for (int y = 0; y <= gridSize; ++y)
+		{
+			for (int x = 0; x <= gridSize; ++x)
+			{
+				CacheVertex vertex = {};
+				vertex.Position[0] = static_cast<float>(x);
+				vertex.Position[1] = static_cast<float>(y);
+				vertex.Position[2] = static_cast<float>((x * y) % 3);
+				vertex.UV[0] = static_cast<float>(x) / gridSize;
+				vertex.UV[1] = static_cast<float>(y) / gridSize;
+				outVertices.push_back(vertex);
+			}
+		}
+
+		std::vector<std::array<uint32_t, 3>> triangles;
+		for (int y = 0; y < gridSize; ++y)
+		{
+			for (int x = 0; x < gridSize; ++x)
+			{
+				const uint32_t i0 = (y * (gridSize + 1)) + x;
+				const uint32_t i1 = i0 + 1;
+				const uint32_t i2 = i0 + (gridSize + 1);
+				const uint32_t i3 = i2 + 1;
+				triangles.push_back({ i0, i1, i3 });
+				triangles.push_back({ i0, i3, i2 });
+			}
+		}
+
+		// deterministic shuffle
+		uint32_t seed = 12345;
+		for (size_t i = triangles.size() - 1; i > 0; --i)
+		{
+			seed = (seed * 1664525u) + 1013904223u;
+			std::swap(triangles[i], triangles[seed % (i + 1)]);
+		}
+
+		for (const std::array<uint32_t, 3>& triangle : triangles)
+		{
+			outIndices.insert(outIndices.end(), triangle.begin(), triangle.end());
+		}
+	}
+
+	// Triangles as vertex positions, independent of triangle order, first corner and vertex numbering
+	static std::vector<std::array<float, 9>> GetTriangleSet(const std::vector<CacheVertex>& vertices, const std::vector<uint32_t>& indices)
+	{
+		std::vector<std::array<float, 9>> triangles;
+		for (size_t i = 0; i < indices.size(); i += 3)
+		{
+			std::array<float, 9> triangle;
+			for (size_t k = 0; k < 3; ++k)
+			{
+				const CacheVertex& vertex = vertices[indices[i + k]];
+				triangle[(k * 3) + 0] = vertex.Position[0];
+				triangle[(k * 3) + 1] = vertex.Position[1];
+				triangle[(k * 3) + 2] = vertex.Position[2];
+			}
+
+			// rotate the corners so the smallest position is first, keeping the winding order intact
+			std::array<float, 9> rotated = triangle;
+			for (size_t r = 1; r < 3; ++r)
+			{
+				std::array<float, 9> candidate;
+				for (size_t k = 0; k < 9; ++k)
+				{
+					candidate[k] = triangle[((r * 3) + k) % 9];
+				}
+				rotated = std::min(rotated, candidate);
+			}
+			triangle = rotated;
+
+			triangles.push_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	TEST(Framework, VertexCache)
+	{
+		std::vector<CacheVertex> vertices;
+		std::vector<uint32_t> indices;
+		BuildScrambledGrid(32, vertices, indices);
+
+		Geometry::VertexCacheStatistics before = Geometry::AnalyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		std::vector<uint32_t> cacheIndices(indices.size());
+		Geometry::OptimizeVertexCache(cacheIndices.data(), indices.data(), indices.size(), vertices.size());
+
+		Geometry::VertexCacheStatistics after = Geometry::AnalyzeVertexCache(cacheIndices.data(), cacheIndices.size(), vertices.size());
+		EXPECT_LT(after.ACMR, before.ACMR);
+		EXPECT_LT(after.ACMR, 1.0f);
+		EXPECT_GE(after.ATVR, 1.0f);
+		EXPECT_EQ(GetTriangleSet(vertices, indices), GetTriangleSet(vertices, cacheIndices));
+
+		std::vector<uint32_t> overdrawIndices(indices.size());
+		Geometry::OptimizeOverdraw(overdrawIndices.data(), cacheIndices.data(), cacheIndices.size(), vertices[0].Position, vertices.size(), sizeof(CacheVertex));
+		EXPECT_EQ(GetTriangleSet(vertices, indices), GetTriangleSet(vertices, overdrawIndices));
+
+		std::vector<CacheVertex> fetchVertices(vertices.size());
+		size_t fetchVertexCount = Geometry::OptimizeVertexFetch(fetchVertices.data(), overdrawIndices.data(), overdrawIndices.size(), vertices.data(), vertices.size(), sizeof(CacheVertex));
+		EXPECT_EQ(fetchVertexCount, vertices.size());
+		EXPECT_EQ(GetTriangleSet(vertices, indices), GetTriangleSet(fetchVertices, overdrawIndices));
+
+		// vertices are numbered in the order the triangles first reference them
+		uint32_t highestIndex = 0;
+		for (uint32_t index : overdrawIndices)
+		{
+			EXPECT_LE(index, highestIndex + 1);
+			highestIndex = std::max(highestIndex, index);
+		}
+	}
+
+	TEST(Framework, VertexCacheAnalysis)
+	{
+		// two triangles sharing an edge only transform 4 vertices
+		const uint32_t indices[] = { 0, 1, 2, 2, 1, 3 };
+		Geometry::VertexCacheStatistics statistics = Geometry::AnalyzeVertexCache(indices, 6, 4);
+		EXPECT_EQ(statistics.VerticesTransformed, 4u);
+		EXPECT_FLOAT_EQ(statistics.ACMR, 2.0f);
+		EXPECT_FLOAT_EQ(statistics.ATVR, 1.0f);
+	}
+}
\ No newline at end of file
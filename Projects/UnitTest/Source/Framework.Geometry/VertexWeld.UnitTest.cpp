@@ -0,0 +1,123 @@
+#include "pch.h"
+
+#include <Framework.Geometry/VertexWeld.h>
+
+#include <vector>
+
+namespace W
+{
+	struct WeldVertex
+	{
+		float Position[3];
+		float Color[3];
+		float UV[2];
+		float Normal[3];
+	};
+
+	// Unrolled triangle list of a grid of quads, every corner is its own vertex
+	static std::vector<WeldVertex> BuildUnrolledGrid(int gridSize)
+	{
+		std::vector<WeldVertex> vertices;
+
+		auto corner = [&](int x, int y)
+		{
+			WeldVertex vertex = {};
+			vertex.Position[0] = static_cast<float>(x);
+			vertex.Position[1] = static_cast<float>(y);
+			vertex.Color[0] = vertex.Color[1] = vertex.Color[2] = 1.0f;
+			vertex.UV[0] = static_cast<float>(x) / gridSize;
+			vertex.UV[1] = static_cast<float>(y) / gridSize;
+			vertex.Normal[2] = 1.0f;
+			vertices.push_back(vertex);
+		};
+
+		for (int y = 0; y < gridSize; ++y)
+		{
+			for (int x = 0; x < gridSize; ++x)
+			{
+				corner(x, y); corner(x + 1, y); corner(x + 1, y + 1);
+				corner(x, y); corner(x + 1, y + 1); corner(x, y + 1);
+			}
+		}
+
+		return vertices;
+	}
+
+	TEST(Framework, VertexWeld)
+	{
+		const int gridSize = 4;
+		std::vector<WeldVertex> vertices = BuildUnrolledGrid(gridSize);
+
+		std::vector<uint32_t> indices(vertices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			indices[i] = static_cast<uint32_t>(i);
+		}
+
+		std::vector<uint32_t> remap(vertices.size());
+		size_t uniqueVertexCount = Geometry::GenerateVertexRemap(remap.data(), vertices.data(), vertices.size(), sizeof(WeldVertex));
+		EXPECT_EQ(uniqueVertexCount, static_cast<size_t>((gridSize + 1) * (gridSize + 1)));
+
+		std::vector<WeldVertex> weldedVertices(uniqueVertexCount);
+		Geometry::RemapVertexBuffer(weldedVertices.data(), vertices.data(), vertices.size(), sizeof(WeldVertex), remap.data());
+
+		std::vector<uint32_t> weldedIndices(indices.size());
+		Geometry::RemapIndexBuffer(weldedIndices.data(), indices.data(), indices.size(), remap.data());
+
+		// the triangle topology must be unchanged, every corner resolves to the same vertex data in the same order
+		ASSERT_EQ(weldedIndices.size(), indices.size());
+		for (size_t i = 0; i < indices.size(); ++i)
+		{
+			ASSERT_LT(weldedIndices[i], uniqueVertexCount);
+
+			const WeldVertex& expected = vertices[indices[i]];
+			const WeldVertex& actual = weldedVertices[weldedIndices[i]];
+			EXPECT_EQ(memcmp(&expected, &actual, sizeof(WeldVertex)), 0);
+		}
+
+		// in-place index remapping
+		Geometry::RemapIndexBuffer(indices.data(), indices.data(), indices.size(), remap.data());
+		EXPECT_EQ(indices, weldedIndices);
+	}
+
+	TEST(Framework, VertexWeldEpsilon)
+	{
+		std::vector<WeldVertex> vertices = BuildUnrolledGrid(2);
+
+		// nudge every other vertex by less than the weld epsilon
+		for (size_t i = 1; i < vertices.size(); i += 2)
+		{
+			vertices[i].Position[0] += 0.00001f;
+			vertices[i].Normal[2] -= 0.00001f;
+		}
+
+		std::vector<uint32_t> remap(vertices.size());
+
+		size_t exactVertexCount = Geometry::GenerateVertexRemap(remap.data(), vertices.data(), vertices.size(), sizeof(WeldVertex));
+		EXPECT_GT(exactVertexCount, static_cast<size_t>(9));
+
+		size_t weldedVertexCount = Geometry::GenerateVertexRemap(remap.data(), vertices.data(), vertices.size(), sizeof(WeldVertex), 0.001f);
+		EXPECT_EQ(weldedVertexCount, static_cast<size_t>(9));
+
+		// negative and positive zero are the same vertex
+		WeldVertex zeros[2] = {};
+		zeros[1].Position[0] = -0.0f;
+		EXPECT_EQ(Geometry::GenerateVertexRemap(remap.data(), zeros, 2, sizeof(WeldVertex)), static_cast<size_t>(1));
+	}
+
+	TEST(Framework, VertexWeldFarVertices)
+	{
+		// grid indices far past 32 bits, a unit apart at this distance
+		WeldVertex far[4] = {};
+		far[0].Position[0] = 1.0e7f;
+		far[1].Position[0] = 1.0e7f;
+		far[2].Position[0] = 1.0e7f + 1.0f;
+		far[3].Position[0] = -1.0e7f;
+
+		std::vector<uint32_t> remap(4);
+		EXPECT_EQ(Geometry::GenerateVertexRemap(remap.data(), far, 4, sizeof(WeldVertex), 0.0001f), static_cast<size_t>(3));
+		EXPECT_EQ(remap[0], remap[1]);
+		EXPECT_NE(remap[0], remap[2]);
+		EXPECT_NE(remap[0], remap[3]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#include "pch.h"
+
+#include <Framework.Jobs/JobSystem.h>
+
+#include <math.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+namespace W
+{
+	// Scaling of ParallelFor from 1 to N threads, run with --gtest_also_run_disabled_tests --gtest_filter=*JobSystemBenchmark
+	TEST(Framework, DISABLED_JobSystemBenchmark)
+	{
+		const size_t itemCount = 4 * 1024 * 1024;
+		std::vector<float> input(itemCount);
+		std::vector<float> output(itemCount);
+		for (size_t i = 0; i < itemCount; ++i)
+		{
+			input[i] = static_cast<float>(i % 1000) * 0.001f;
+		}
+
+		const uint32_t hardwareThreadCount = std::max(std::thread::hardware_concurrency(), 2u);
+
+		double singleThreadSeconds = 0.0;
+		printf("%8s %12s %10s\n", "threads", "ms", "speedup");
+		for (uint32_t threadCount = 1; threadCount <= hardwareThreadCount; ++threadCount)
+		{
+			// the calling thread takes part, one thread runs the workers alone
+			JobSystem jobSystem(std::max(threadCount - 1, 1u));
+			const size_t grainSize = (threadCount == 1) ? itemCount : 1024;
+
+			const int runCount = 8;
+			const auto startTime = std::chrono::steady_clock::now();
+			for (int run = 0; run < runCount; ++run)
+			{
+				jobSystem.ParallelFor(itemCount, grainSize, [&](size_t begin, size_t end)
+				{
+					for (size_t i = begin; i < end; ++i)
+					{
+						const float x = input[i];
+						output[i] = sqrtf(x) * sinf(x) + cosf(x * 3.0f);
+					}
+				});
+			}
+			const auto endTime = std::chrono::steady_clock::now();
+
+			const double seconds = std::chrono::duration<double>(endTime - startTime).count() / runCount;
+			if (threadCount == 1)
+			{
+				singleThreadSeconds = seconds;
+			}
+
+			printf("%8u %12.3f %10.2f\n", threadCount, seconds * 1000.0, singleThreadSeconds / seconds);
+		}
+
+		EXPECT_GT(output[itemCount - 1], -2.0f);
+	}
+}
\ No newline at end of file
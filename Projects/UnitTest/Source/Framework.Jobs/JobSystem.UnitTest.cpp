@@ -0,0 +1,166 @@
+#include "pch.h"
+
+#include <Framework.Jobs/JobSystem.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace W
+{
+	TEST(Framework, JobSystem)
+	{
+		JobSystem jobSystem(3);
+		EXPECT_EQ(jobSystem.GetWorkerCount(), 3u);
+
+		// many tiny jobs, more than a queue holds
+		const int jobCount = 20000;
+		std::atomic<int> sum(0);
+
+		JobCounter counter;
+		for (int i = 0; i < jobCount; ++i)
+		{
+			jobSystem.Run([&sum, i]() { sum.fetch_add(i); }, &counter);
+		}
+		jobSystem.Wait(counter);
+
+		EXPECT_TRUE(counter.IsDone());
+		EXPECT_EQ(sum.load(), (jobCount * (jobCount - 1)) / 2);
+	}
+
+	// Binary tree of jobs, each job waits for its children while helping
+	static int64_t TreeSum(JobSystem& jobSystem, int64_t begin, int64_t end)
+	{
+		if (end - begin <= 16)
+		{
+			int64_t sum = 0;
+			for (int64_t i = begin; i < end; ++i)
+			{
+				sum += i;
+			}
+			return sum;
+		}
+
+		const int64_t middle = (begin + end) / 2;
+		int64_t left = 0;
+		int64_t right = 0;
+
+		JobCounter counter;
+		jobSystem.Run([&]() { left = TreeSum(jobSystem, begin, middle); }, &counter);
+		jobSystem.Run([&]() { right = TreeSum(jobSystem, middle, end); }, &counter);
+		jobSystem.Wait(counter);
+
+		return left + right;
+	}
+
+	TEST(Framework, JobSystemNested)
+	{
+		JobSystem jobSystem(3);
+
+		const int64_t count = 100000;
+		EXPECT_EQ(TreeSum(jobSystem, 0, count), (count * (count - 1)) / 2);
+	}
+
+	TEST(Framework, JobSystemDependencies)
+	{
+		JobSystem jobSystem(3);
+
+		for (int iteration = 0; iteration < 100; ++iteration)
+		{
+			// diamond: a -> (b, c) -> d
+			std::atomic<int> a(0);
+			std::atomic<int> b(0);
+			std::atomic<int> c(0);
+			std::atomic<int> d(0);
+
+			JobCounter aDone;
+			JobCounter bcDone;
+			JobCounter dDone;
+
+			// the jobs of a counter are queued before the ones depending on it, which may find it pending or already done
+			jobSystem.Run([&]() { a = 1; }, &aDone);
+			jobSystem.RunAfter(aDone, [&]() { b = a + 1; }, &bcDone);
+			jobSystem.RunAfter(aDone, [&]() { c = a + 2; }, &bcDone);
+			jobSystem.RunAfter(bcDone, [&]() { d = b + c; }, &dDone);
+
+			// every counter is waited on before the locals the jobs use go out of scope
+			jobSystem.Wait(aDone);
+			jobSystem.Wait(bcDone);
+			jobSystem.Wait(dDone);
+			EXPECT_EQ(d.load(), 5);
+		}
+
+		// dependency that is already done
+		JobCounter done;
+		JobCounter counter;
+		bool ran = false;
+		jobSystem.RunAfter(done, [&]() { ran = true; }, &counter);
+		jobSystem.Wait(counter);
+		EXPECT_TRUE(ran);
+	}
+
+	TEST(Framework, JobSystemParallelFor)
+	{
+		JobSystem jobSystem(3);
+
+		const size_t counts[] = { 0, 1, 7, 64, 1000, 100003 };
+		const size_t grainSizes[] = { 0, 1, 16, 5000 };
+		for (size_t count : counts)
+		{
+			for (size_t grainSize : grainSizes)
+			{
+				// every index is visited exactly once
+				std::vector<std::atomic<int>> visits(count);
+				for (std::atomic<int>& visit : visits)
+				{
+					visit = 0;
+				}
+
+				jobSystem.ParallelFor(count, grainSize, [&](size_t begin, size_t end)
+				{
+					EXPECT_LT(begin, end);
+					EXPECT_LE(end, count);
+					for (size_t i = begin; i < end; ++i)
+					{
+						visits[i].fetch_add(1);
+					}
+				});
+
+				int wrongVisits = 0;
+				for (const std::atomic<int>& visit : visits)
+				{
+					wrongVisits += (visit != 1) ? 1 : 0;
+				}
+				EXPECT_EQ(wrongVisits, 0) << "count " << count << ", grain size " << grainSize;
+			}
+		}
+	}
+
+	TEST(Framework, JobSystemExternalThreads)
+	{
+		JobSystem jobSystem(2);
+
+		// threads unknown to the job system submit through the shared queue
+		std::atomic<int> sum(0);
+		std::vector<std::thread> threads;
+		for (int t = 0; t < 4; ++t)
+		{
+			threads.emplace_back([&]()
+			{
+				JobCounter counter;
+				for (int i = 0; i < 1000; ++i)
+				{
+					jobSystem.Run([&sum]() { sum.fetch_add(1); }, &counter);
+				}
+				jobSystem.Wait(counter);
+			});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		EXPECT_EQ(sum.load(), 4000);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,115 @@
+#include "pch.h"
+
+#include <Framework.Jobs/WorkStealingDeque.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace W
+{
+	TEST(Framework, WorkStealingDeque)
+	{
+		WorkStealingDeque<int> deque(4);
+
+		int item = 0;
+		EXPECT_TRUE(deque.IsEmpty());
+		EXPECT_FALSE(deque.Pop(item));
+		EXPECT_FALSE(deque.Steal(item));
+
+		for (int i = 1; i <= 4; ++i)
+		{
+			EXPECT_TRUE(deque.Push(i));
+		}
+		EXPECT_FALSE(deque.Push(5));
+
+		// the owner pops the newest, thieves steal the oldest
+		EXPECT_TRUE(deque.Pop(item));
+		EXPECT_EQ(item, 4);
+		EXPECT_TRUE(deque.Steal(item));
+		EXPECT_EQ(item, 1);
+
+		// wraps around the ring
+		EXPECT_TRUE(deque.Push(5));
+		EXPECT_TRUE(deque.Push(6));
+		EXPECT_FALSE(deque.Push(7));
+
+		const int expected[] = { 6, 5, 3, 2 };
+		for (int value : expected)
+		{
+			EXPECT_TRUE(deque.Pop(item));
+			EXPECT_EQ(item, value);
+		}
+		EXPECT_TRUE(deque.IsEmpty());
+	}
+
+	TEST(Framework, WorkStealingDequeStress)
+	{
+		const int itemCount = 200000;
+		const int thiefCount = 3;
+
+		WorkStealingDeque<int> deque(256);
+		std::vector<std::atomic<int>> seen(itemCount);
+		for (std::atomic<int>& count : seen)
+		{
+			count = 0;
+		}
+
+		std::atomic<bool> done(false);
+		std::vector<std::thread> thieves;
+		for (int t = 0; t < thiefCount; ++t)
+		{
+			thieves.emplace_back([&]()
+			{
+				int item;
+				while (done == false || deque.IsEmpty() == false)
+				{
+					if (deque.Steal(item))
+					{
+						seen[item].fetch_add(1);
+					}
+				}
+			});
+		}
+
+		// the owner pushes everything and pops about half of it back
+		int item;
+		for (int i = 0; i < itemCount; ++i)
+		{
+			while (deque.Push(i) == false)
+			{
+				if (deque.Pop(item))
+				{
+					seen[item].fetch_add(1);
+				}
+			}
+
+			if ((i % 2) == 0 && deque.Pop(item))
+			{
+				seen[item].fetch_add(1);
+			}
+		}
+
+		while (deque.Pop(item))
+		{
+			seen[item].fetch_add(1);
+		}
+
+		done = true;
+		for (std::thread& thief : thieves)
+		{
+			thief.join();
+		}
+
+		// every item is taken exactly once
+		int missing = 0;
+		int duplicated = 0;
+		for (const std::atomic<int>& count : seen)
+		{
+			missing += (count == 0) ? 1 : 0;
+			duplicated += (count > 1) ? 1 : 0;
+		}
+		EXPECT_EQ(missing, 0);
+		EXPECT_EQ(duplicated, 0);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "pch.h"
+
+#include <Framework.Math/LightClusters.h>
+
+#include <math.h>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+namespace W
+{
+	static Math::ClusterGrid BuildClusterGrid()
+	{
+		Math::ClusterGrid grid;
+		grid.CountX = 16;
+		grid.CountY = 9;
+		grid.CountZ = 24;
+		grid.NearZ = 0.1f;
+		grid.FarZ = 100.0f;
+		grid.ProjectionX = 1.0f;
+		grid.ProjectionY = -1.6f; // flipped like a Vulkan projection
+		return grid;
+	}
+
+	// Cluster of a view space point the way the fragment shader finds it, false outside the frustum
+	static bool FindCluster(const Math::ClusterGrid& grid, float x, float y, float z, uint32_t& outCluster)
+	{
+		const float depth = -z;
+		const float ndcX = grid.ProjectionX * x / depth;
+		const float ndcY = grid.ProjectionY * y / depth;
+		if (depth < grid.NearZ || depth > grid.FarZ || fabsf(ndcX) >= 1.0f || fabsf(ndcY) >= 1.0f)
+			return false;
+
+		const uint32_t tileX = static_cast<uint32_t>((ndcX * 0.5f + 0.5f) * grid.CountX);
+		const uint32_t tileY = static_cast<uint32_t>((ndcY * 0.5f + 0.5f) * grid.CountY);
+		const uint32_t slice = std::min(static_cast<uint32_t>(logf(depth / grid.NearZ) * grid.CountZ / logf(grid.FarZ / grid.NearZ)), grid.CountZ - 1);
+		outCluster = tileX + grid.CountX * (tileY + grid.CountY * slice);
+		return true;
+	}
+
+	TEST(Framework, BinLights)
+	{
+		const Math::ClusterGrid grid = BuildClusterGrid();
+
+		std::mt19937 random(7);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		std::vector<Math::LightSphere> lights(1000);
+		for (Math::LightSphere& light : lights)
+		{
+			light.Center[0] = unit(random) * 40.0f;
+			light.Center[1] = unit(random) * 25.0f;
+			light.Center[2] = unit(random) * 55.0f - 45.0f;
+			light.Radius = 0.5f + (unit(random) + 1.0f) * 3.0f;
+		}
+
+		std::vector<uint32_t> clusters(grid.GetClusterCount() * 2);
+		std::vector<uint32_t> indices(1024 * 1024);
+		const size_t indexCount = Math::BinLights(clusters.data(), indices.data(), indices.size(), grid, lights.data(), lights.size());
+		ASSERT_LE(indexCount, indices.size());
+
+		// every point inside a light finds it in its cluster
+		size_t testedPoints = 0;
+		for (uint32_t light = 0; light < lights.size(); ++light)
+		{
+			for (int sample = 0; sample < 64; ++sample)
+			{
+				float offset[3] = { unit(random), unit(random), unit(random) };
+				const float length = sqrtf(offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2]);
+				const float distance = lights[light].Radius * (sample % 2 ? 0.999f : fabsf(unit(random))) / std::max(length, 1e-3f);
+
+				uint32_t cluster;
+				if (FindCluster(grid, lights[light].Center[0] + offset[0] * distance, lights[light].Center[1] + offset[1] * distance, lights[light].Center[2] + offset[2] * distance, cluster) == false)
+					continue;
+
+				const uint32_t* first = &indices[clusters[cluster * 2]];
+				const uint32_t* last = first + clusters[cluster * 2 + 1];
+				EXPECT_TRUE(std::binary_search(first, last, light));
+				++testedPoints;
+			}
+		}
+		EXPECT_GT(testedPoints, lights.size() * 8);
+
+		// the lights of a cluster are sorted and laid out one cluster after the other
+		size_t expectedOffset = 0;
+		for (uint32_t cluster = 0; cluster < grid.GetClusterCount(); ++cluster)
+		{
+			EXPECT_EQ(clusters[cluster * 2], expectedOffset);
+			const uint32_t* first = &indices[clusters[cluster * 2]];
+			EXPECT_TRUE(std::is_sorted(first, first + clusters[cluster * 2 + 1]));
+			expectedOffset += clusters[cluster * 2 + 1];
+		}
+		EXPECT_EQ(expectedOffset, indexCount);
+	}
+
+	TEST(Framework, BinLightsBounds)
+	{
+		const Math::ClusterGrid grid = BuildClusterGrid();
+
+		std::vector<Math::LightSphere> lights(3);
+		// behind the camera
+		lights[0].Center[0] = 0.0f;
+		lights[0].Center[1] = 0.0f;
+		lights[0].Center[2] = 5.0f;
+		lights[0].Radius = 1.0f;
+		// small and near the center of the screen
+		lights[1].Center[0] = 0.05f;
+		lights[1].Center[1] = 0.05f;
+		lights[1].Center[2] = -10.0f;
+		lights[1].Radius = 0.1f;
+		// past the far plane
+		lights[2].Center[0] = 0.0f;
+		lights[2].Center[1] = 0.0f;
+		lights[2].Center[2] = -120.0f;
+		lights[2].Radius = 10.0f;
+
+		std::vector<uint32_t> clusters(grid.GetClusterCount() * 2);
+		std::vector<uint32_t> indices(64);
+		const size_t indexCount = Math::BinLights(clusters.data(), indices.data(), indices.size(), grid, lights.data(), lights.size());
+
+		EXPECT_GE(indexCount, 1u);
+		EXPECT_LE(indexCount, 8u);
+		for (size_t i = 0; i < indexCount; ++i)
+		{
+			EXPECT_EQ(indices[i], 1u);
+		}
+
+		uint32_t cluster;
+		ASSERT_TRUE(FindCluster(grid, lights[1].Center[0], lights[1].Center[1], lights[1].Center[2], cluster));
+		EXPECT_EQ(clusters[cluster * 2 + 1], 1u);
+	}
+
+	TEST(Framework, BinLightsOverflow)
+	{
+		const Math::ClusterGrid grid = BuildClusterGrid();
+
+		// covers the whole frustum
+		Math::LightSphere light = {};
+		light.Center[2] = -50.0f;
+		light.Radius = 200.0f;
+		std::vector<Math::LightSphere> lights(4, light);
+
+		const size_t maxIndices = 1000;
+		std::vector<uint32_t> clusters(grid.GetClusterCount() * 2);
+		std::vector<uint32_t> indices(maxIndices);
+		const size_t indexCount = Math::BinLights(clusters.data(), indices.data(), maxIndices, grid, lights.data(), lights.size());
+		EXPECT_EQ(indexCount, lights.size() * grid.GetClusterCount());
+
+		size_t writtenCount = 0;
+		for (uint32_t cluster = 0; cluster < grid.GetClusterCount(); ++cluster)
+		{
+			EXPECT_LE(clusters[cluster * 2] + clusters[cluster * 2 + 1], std::max<size_t>(clusters[cluster * 2], maxIndices));
+			writtenCount += clusters[cluster * 2 + 1];
+		}
+		EXPECT_EQ(writtenCount, maxIndices);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,180 @@
+#include "pch.h"
+
+#include <Framework.Math/ShadowCascades.h>
+
+#include <math.h>
+#include <random>
+
+namespace W
+{
+	static void Normalize(float v[3])
+	{
+		const float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+		v[0] /= length;
+		v[1] /= length;
+		v[2] /= length;
+	}
+
+	// Light space of a point, the projection is orthographic
+	static void TransformPoint(float out[3], const Math::Matrix4& matrix, const float p[3])
+	{
+		for (int row = 0; row < 3; ++row)
+		{
+			out[row] = matrix.Columns[0][row] * p[0] + matrix.Columns[1][row] * p[1] + matrix.Columns[2][row] * p[2] + matrix.Columns[3][row];
+		}
+	}
+
+	static Math::CascadeCamera BuildCamera(float x, float y, float z, float forwardX, float forwardY, float forwardZ)
+	{
+		Math::CascadeCamera camera;
+		camera.Position[0] = x;
+		camera.Position[1] = y;
+		camera.Position[2] = z;
+		camera.Forward[0] = forwardX;
+		camera.Forward[1] = forwardY;
+		camera.Forward[2] = forwardZ;
+		Normalize(camera.Forward);
+		camera.TanHalfFovY = tanf(0.5f * 0.785f);
+		camera.TanHalfFovX = camera.TanHalfFovY * 16.0f / 9.0f;
+		return camera;
+	}
+
+	TEST(Framework, CascadeSplits)
+	{
+		float splits[4];
+		Math::ComputeCascadeSplits(splits, 4, 0.1f, 100.0f, 0.75f);
+
+		EXPECT_GT(splits[0], 0.1f);
+		for (int i = 1; i < 4; ++i)
+		{
+			EXPECT_GT(splits[i], splits[i - 1]);
+		}
+		EXPECT_EQ(splits[3], 100.0f);
+
+		// between the logarithmic and the uniform split
+		EXPECT_GT(splits[1], 0.1f * powf(1000.0f, 0.5f));
+		EXPECT_LT(splits[1], 0.1f + (100.0f - 0.1f) * 0.5f);
+	}
+
+	TEST(Framework, FitCascadeCoversSlice)
+	{
+		std::mt19937 random(11);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+
+		float lightDirection[3] = { -0.3f, -0.5f, -0.8f };
+		Normalize(lightDirection);
+
+		const Math::CascadeSettings settings;
+		const float slices[][2] = { { 0.01f, 5.0f }, { 5.0f, 15.0f }, { 15.0f, 40.0f }, { 40.0f, 100.0f } };
+		for (int test = 0; test < 200; ++test)
+		{
+			const Math::CascadeCamera camera = BuildCamera(unit(random) * 50.0f, unit(random) * 50.0f, unit(random) * 10.0f, unit(random), unit(random), unit(random) * 0.5f);
+			const float* slice = slices[test % 4];
+
+			Math::Matrix4 viewProjection;
+			Math::FitCascade(viewProjection, camera, slice[0], slice[1], lightDirection, settings);
+
+			// frustum axes of the camera
+			float up[3] = { 0.0f, 0.0f, 1.0f };
+			float right[3] = { camera.Forward[1] * up[2] - camera.Forward[2] * up[1], camera.Forward[2] * up[0] - camera.Forward[0] * up[2], camera.Forward[0] * up[1] - camera.Forward[1] * up[0] };
+			Normalize(right);
+			up[0] = right[1] * camera.Forward[2] - right[2] * camera.Forward[1];
+			up[1] = right[2] * camera.Forward[0] - right[0] * camera.Forward[2];
+			up[2] = right[0] * camera.Forward[1] - right[1] * camera.Forward[0];
+
+			for (int corner = 0; corner < 8; ++corner)
+			{
+				const float distance = slice[corner >> 2];
+				const float sideX = (corner & 1) ? 1.0f : -1.0f;
+				const float sideY = (corner & 2) ? 1.0f : -1.0f;
+
+				float point[3];
+				for (int i = 0; i < 3; ++i)
+				{
+					point[i] = camera.Position[i] + distance * (camera.Forward[i] + right[i] * sideX * camera.TanHalfFovX + up[i] * sideY * camera.TanHalfFovY);
+				}
+
+				float clip[3];
+				TransformPoint(clip, viewProjection, point);
+				EXPECT_LE(fabsf(clip[0]), 1.0f);
+				EXPECT_LE(fabsf(clip[1]), 1.0f);
+				EXPECT_GE(clip[2], 0.0f);
+				EXPECT_LE(clip[2], 1.0f);
+			}
+
+			// the casters between the slice and the light are in the depth range
+			float caster[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				caster[i] = camera.Position[i] + camera.Forward[i] * slice[1] - lightDirection[i] * settings.CasterDistance * 0.5f;
+			}
+			float clip[3];
+			TransformPoint(clip, viewProjection, caster);
+			EXPECT_GE(clip[2], 0.0f);
+		}
+	}
+
+	TEST(Framework, FitCascadeStable)
+	{
+		float lightDirection[3] = { 0.2f, -0.4f, -0.9f };
+		Normalize(lightDirection);
+
+		const Math::CascadeSettings settings;
+		const Math::CascadeCamera camera = BuildCamera(3.0f, -7.0f, 2.0f, 1.0f, 0.3f, -0.2f);
+
+		Math::Matrix4 reference;
+		Math::FitCascade(reference, camera, 5.0f, 15.0f, lightDirection, settings);
+
+		// turning the camera keeps the scale of the cascade and its texel grid
+		std::mt19937 random(5);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		const float steps = settings.Resolution / (2.0f * settings.SnapTexels);
+		for (int test = 0; test < 100; ++test)
+		{
+			const Math::CascadeCamera turned = BuildCamera(camera.Position[0], camera.Position[1], camera.Position[2], unit(random), unit(random), unit(random));
+
+			Math::Matrix4 viewProjection;
+			Math::FitCascade(viewProjection, turned, 5.0f, 15.0f, lightDirection, settings);
+			for (int column = 0; column < 3; ++column)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					EXPECT_EQ(viewProjection.Columns[column][row], reference.Columns[column][row]);
+				}
+			}
+
+			for (int row = 0; row < 2; ++row)
+			{
+				const float offset = (viewProjection.Columns[3][row] - reference.Columns[3][row]) * steps;
+				EXPECT_NEAR(offset, roundf(offset), 1e-2f);
+			}
+		}
+
+		// moving along the light space x axis by a tenth of a step changes the cascade every ten moves
+		float axisX[3] = { reference.Columns[0][0], reference.Columns[1][0], reference.Columns[2][0] };
+		const float radius = 1.0f / sqrtf(axisX[0] * axisX[0] + axisX[1] * axisX[1] + axisX[2] * axisX[2]);
+		Normalize(axisX);
+		const float move = 0.1f * radius / steps;
+
+		Math::CascadeCamera moved = camera;
+		Math::Matrix4 previous = reference;
+		int changeCount = 0;
+		for (int test = 0; test < 200; ++test)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				moved.Position[i] += axisX[i] * move;
+			}
+
+			Math::Matrix4 viewProjection;
+			Math::FitCascade(viewProjection, moved, 5.0f, 15.0f, lightDirection, settings);
+			if (memcmp(&viewProjection, &previous, sizeof(Math::Matrix4)) != 0)
+			{
+				++changeCount;
+			}
+			previous = viewProjection;
+		}
+		EXPECT_GE(changeCount, 19);
+		EXPECT_LE(changeCount, 21);
+	}
+}
\ No newline at end of file
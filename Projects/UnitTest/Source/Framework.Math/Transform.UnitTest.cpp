@@ -0,0 +1,84 @@
+#include "pch.h"
+
+#include <Framework.Math/Transform.h>
+
+#include <math.h>
+#include <vector>
+
+namespace W
+{
+	static Math::Matrix4 Multiply(const Math::Matrix4& a, const Math::Matrix4& b)
+	{
+		Math::Matrix4 result = {};
+		for (int column = 0; column < 4; ++column)
+			for (int row = 0; row < 4; ++row)
+				for (int k = 0; k < 4; ++k)
+					result.Columns[column][row] += a.Columns[k][row] * b.Columns[column][k];
+		return result;
+	}
+
+	// Rotation around z, non uniform scale and translation
+	static Math::Matrix4 BuildModel(float angle, float scaleX, float scaleY, float scaleZ, float x, float y, float z)
+	{
+		const float c = cosf(angle);
+		const float s = sinf(angle);
+
+		Math::Matrix4 model = {};
+		model.Columns[0][0] = c * scaleX;
+		model.Columns[0][1] = s * scaleX;
+		model.Columns[1][0] = -s * scaleY;
+		model.Columns[1][1] = c * scaleY;
+		model.Columns[2][2] = scaleZ;
+		model.Columns[3][0] = x;
+		model.Columns[3][1] = y;
+		model.Columns[3][2] = z;
+		model.Columns[3][3] = 1.0f;
+		return model;
+	}
+
+	TEST(Framework, ObjectTransforms)
+	{
+		Math::Matrix4 viewProjection = {};
+		for (int column = 0; column < 4; ++column)
+			for (int row = 0; row < 4; ++row)
+				viewProjection.Columns[column][row] = static_cast<float>((column * 7 + row * 3) % 5) - 2.0f + (column == row ? 4.0f : 0.0f);
+
+		std::vector<Math::Matrix4> models;
+		models.push_back(BuildModel(0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 0.0f));
+		models.push_back(BuildModel(0.5f, 2.0f, 0.5f, 3.0f, 1.0f, -2.0f, 4.0f));
+		models.push_back(BuildModel(-1.3f, 0.25f, 4.0f, 1.0f, -8.0f, 0.5f, 2.0f));
+
+		// padded like dynamic uniform buffer offsets
+		const size_t stride = 256;
+		std::vector<Math::Matrix4> output(models.size() * stride / sizeof(Math::Matrix4));
+		Math::ComputeObjectTransforms(output.data(), stride, models.data(), models.size(), viewProjection);
+
+		for (size_t i = 0; i < models.size(); ++i)
+		{
+			const Math::ObjectTransform& transform = *reinterpret_cast<const Math::ObjectTransform*>(reinterpret_cast<const char*>(output.data()) + i * stride);
+			const Math::Matrix4 modelViewProjection = Multiply(viewProjection, models[i]);
+
+			for (int column = 0; column < 4; ++column)
+			{
+				for (int row = 0; row < 4; ++row)
+				{
+					EXPECT_EQ(transform.Model.Columns[column][row], models[i].Columns[column][row]);
+					EXPECT_NEAR(transform.ModelViewProjection.Columns[column][row], modelViewProjection.Columns[column][row], 1e-4f);
+				}
+			}
+
+			// transpose(normal) * model is the identity on the upper 3x3
+			for (int column = 0; column < 3; ++column)
+			{
+				for (int row = 0; row < 3; ++row)
+				{
+					float value = 0.0f;
+					for (int k = 0; k < 3; ++k)
+						value += transform.Normal[row][k] * models[i].Columns[column][k];
+					EXPECT_NEAR(value, row == column ? 1.0f : 0.0f, 1e-5f);
+				}
+				EXPECT_EQ(transform.Normal[column][3], 0.0f);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include "pch.h"
+
+#include <Framework.Memory/RingAllocator.h>
+
+namespace W
+{
+	TEST(Framework, RingAllocator)
+	{
+		Memory::RingAllocator allocator(1024);
+
+		uint64_t offset = 0;
+		EXPECT_TRUE(allocator.Allocate(100, 1, offset));
+		EXPECT_EQ(offset, 0u);
+		EXPECT_TRUE(allocator.Allocate(100, 256, offset));
+		EXPECT_EQ(offset, 256u);
+		const uint64_t firstFrame = allocator.GetHead();
+
+		EXPECT_TRUE(allocator.Allocate(500, 1, offset));
+		EXPECT_EQ(offset, 356u);
+		const uint64_t secondFrame = allocator.GetHead();
+
+		// full until the first frame is released, the allocation skips the end of the ring
+		EXPECT_FALSE(allocator.Allocate(300, 1, offset));
+		allocator.Release(firstFrame);
+		EXPECT_TRUE(allocator.Allocate(300, 1, offset));
+		EXPECT_EQ(offset, 0u);
+		EXPECT_EQ(allocator.GetUsedSize(), 500u + 168u + 300u);
+
+		// larger than the ring
+		EXPECT_FALSE(allocator.Allocate(2048, 1, offset));
+
+		allocator.Release(secondFrame);
+		allocator.Release(allocator.GetHead());
+		EXPECT_EQ(allocator.GetUsedSize(), 0u);
+
+		// an empty ring holds its whole size
+		EXPECT_TRUE(allocator.Allocate(1024, 1, offset));
+		EXPECT_EQ(offset, 0u);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "pch.h"
+
+#include <Framework.Memory/TlsfAllocator.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+namespace W
+{
+	TEST(Framework, TlsfAllocator)
+	{
+		Memory::TlsfAllocator allocator(1024);
+
+		Memory::TlsfAllocator::Allocation a, b, c;
+		EXPECT_TRUE(allocator.Allocate(100, 1, a));
+		EXPECT_TRUE(allocator.Allocate(100, 256, b));
+		EXPECT_TRUE(allocator.Allocate(1, 64, c));
+		EXPECT_EQ(a.Offset, 0u);
+		EXPECT_EQ(b.Offset % 256, 0u);
+		EXPECT_EQ(c.Offset % 64, 0u);
+		EXPECT_EQ(allocator.GetAllocationCount(), 3u);
+		EXPECT_EQ(allocator.GetUsedSize(), 201u);
+
+		// too large for the remaining space
+		Memory::TlsfAllocator::Allocation d;
+		EXPECT_FALSE(allocator.Allocate(1024, 1, d));
+		EXPECT_FALSE(d.IsValid());
+
+		allocator.Free(b);
+		allocator.Free(a);
+		allocator.Free(c);
+		EXPECT_FALSE(a.IsValid());
+		EXPECT_TRUE(allocator.IsEmpty());
+
+		// the free blocks are coalesced back into the whole range
+		Memory::AllocatorStatistics statistics = allocator.GetStatistics();
+		EXPECT_EQ(statistics.FreeBlockCount, 1u);
+		EXPECT_EQ(statistics.LargestFreeSize, 1024u);
+		EXPECT_EQ(statistics.GetFragmentation(), 0.0f);
+
+		EXPECT_TRUE(allocator.Allocate(1024, 1, d));
+		EXPECT_EQ(d.Offset, 0u);
+		allocator.Free(d);
+	}
+
+	TEST(Framework, TlsfAllocatorStress)
+	{
+		const uint64_t size = 64 * 1024 * 1024;
+		Memory::TlsfAllocator allocator(size);
+
+		struct Range
+		{
+			Memory::TlsfAllocator::Allocation Allocation;
+			uint64_t Size;
+		};
+
+		std::mt19937 random(1234);
+		std::vector<Range> ranges;
+		for (int i = 0; i < 20000; ++i)
+		{
+			if (ranges.empty() == false && (random() % 3) == 0)
+			{
+				const size_t index = random() % ranges.size();
+				allocator.Free(ranges[index].Allocation);
+				ranges[index] = ranges.back();
+				ranges.pop_back();
+				continue;
+			}
+
+			Range range;
+			range.Size = 1 + (random() % (64 * 1024));
+			const uint64_t alignment = 1ull << (random() % 9);
+			if (allocator.Allocate(range.Size, alignment, range.Allocation))
+			{
+				EXPECT_EQ(range.Allocation.Offset % alignment, 0u);
+				ranges.push_back(range);
+			}
+		}
+
+		// no two live allocations overlap and all are in range
+		std::vector<Range> sortedRanges = ranges;
+		std::sort(sortedRanges.begin(), sortedRanges.end(), [](const Range& a, const Range& b) { return a.Allocation.Offset < b.Allocation.Offset; });
+
+		int overlapCount = 0;
+		uint64_t usedSize = 0;
+		for (size_t i = 0; i < sortedRanges.size(); ++i)
+		{
+			const uint64_t end = sortedRanges[i].Allocation.Offset + sortedRanges[i].Size;
+			overlapCount += (i + 1 < sortedRanges.size() && end > sortedRanges[i + 1].Allocation.Offset) ? 1 : 0;
+			EXPECT_LE(end, size);
+			usedSize += sortedRanges[i].Size;
+		}
+		EXPECT_EQ(overlapCount, 0);
+		EXPECT_EQ(allocator.GetUsedSize(), usedSize);
+		EXPECT_EQ(allocator.GetAllocationCount(), static_cast<uint32_t>(ranges.size()));
+
+		for (Range& range : ranges)
+		{
+			allocator.Free(range.Allocation);
+		}
+
+		Memory::AllocatorStatistics statistics = allocator.GetStatistics();
+		EXPECT_EQ(statistics.FreeBlockCount, 1u);
+		EXPECT_EQ(statistics.LargestFreeSize, size);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "pch.h"
+
+#include <Framework/Hash.h>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace W
+{
+	// Throughput of the hash engines, run with --gtest_also_run_disabled_tests --gtest_filter=*HashBenchmark
+	TEST(Framework, DISABLED_HashBenchmark)
+	{
+		const size_t inputSizes[] = { 16, 256, 4 * 1024, 1024 * 1024 };
+		const size_t bytesPerRun = 256 * 1024 * 1024;
+
+		std::vector<uint8_t> data(1024 * 1024);
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			data[i] = static_cast<uint8_t>((i * 31) + 7);
+		}
+
+		// NUL terminated copy for the string hashes, without embedded zeros
+		std::string text(data.size(), 'a');
+		for (size_t i = 0; i < text.size(); ++i)
+		{
+			text[i] = static_cast<char>('a' + (i % 26));
+		}
+
+		printf("Crc32C hardware support: %s\n", Hash::IsCrc32CHardwareSupported() ? "yes" : "no");
+		printf("%-24s %10s %10s %10s %10s (GB/s)\n", "", "16B", "256B", "4KB", "1MB");
+
+		auto run = [&](const char* name, auto hashFunction)
+		{
+			printf("%-24s", name);
+			for (size_t inputSize : inputSizes)
+			{
+				const size_t iterationCount = bytesPerRun / inputSize;
+
+				uint64_t result = 0;
+				const auto startTime = std::chrono::steady_clock::now();
+				for (size_t i = 0; i < iterationCount; ++i)
+				{
+					result += hashFunction(inputSize);
+				}
+				const auto endTime = std::chrono::steady_clock::now();
+
+				const double seconds = std::chrono::duration<double>(endTime - startTime).count();
+				printf(" %10.2f", (static_cast<double>(iterationCount * inputSize) / seconds) / 1e9);
+
+				// keep the result alive
+				EXPECT_NE(result, 1ull);
+			}
+			printf("\n");
+		};
+
+		// the string hashes walk a NUL terminated string, their input size is set with the terminator position
+		run("StringHash32 (CRC-32)", [&](size_t size)
+		{
+			const char saved = text[size];
+			text[size] = '\0';
+			const uint64_t hash = Hash::StringHash32(text.c_str());
+			text[size] = saved;
+			return hash;
+		});
+		run("StringHash64 (CRC-64)", [&](size_t size)
+		{
+			const char saved = text[size];
+			text[size] = '\0';
+			const uint64_t hash = Hash::StringHash64(text.c_str());
+			text[size] = saved;
+			return hash;
+		});
+		run("BufferHash64 (CRC-64)", [&](size_t size) { return Hash::BufferHash64(data.data(), size); });
+		run("Crc32CPortable", [&](size_t size) { return static_cast<uint64_t>(Hash::Crc32CPortable(data.data(), size)); });
+		run("Crc32C", [&](size_t size) { return static_cast<uint64_t>(Hash::Crc32C(data.data(), size)); });
+	}
+}
\ No newline at end of file
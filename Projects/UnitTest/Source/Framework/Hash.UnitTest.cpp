@@ -2,6 +2,10 @@
 
 #include <Framework/Hash.h>
 
+#include <string.h>
+
+#include <vector>
+
 namespace W
 {
 	TEST(Framework, Hash32)
@@ -30,5 +34,135 @@ namespace W
 		uint64_t helloWorldHash64 = Hash::StringHash64("HelloWorld");
 		uint64_t helloWorldHash64Combined = Hash::StringHash64("World", helloHash64);
 		EXPECT_EQ(helloWorldHash64, helloWorldHash64Combined);
+
+		// CRC-64 (ECMA-182 reflected polynomial 0x95AC9329AC4BC9B5), zero initial value
+		EXPECT_EQ(Hash::StringHash64("123456789"), 0xe9c6d914c4b8d9caull);
+		EXPECT_EQ(Hash::StringHash64("The quick brown fox jumps over the lazy dog"), 0xbf7ee596c3aa372bull);
+
+		// the upper 32 bits are used
+		EXPECT_NE(Hash::StringHash64("123456789") >> 32, 0ull);
+	}
+
+	TEST(Framework, BufferHash64)
+	{
+		uint64_t emptyHash64 = Hash::BufferHash64(nullptr, 0);
+		EXPECT_EQ(emptyHash64, Hash::EmptyHash64);
+
+		const uint8_t data[] = { 0x00, 0x01, 0xfe, 0xff, 0x00, 0x80 };
+		uint64_t dataHash64 = Hash::BufferHash64(data, sizeof(data));
+		EXPECT_NE(dataHash64, Hash::EmptyHash64);
+
+		// embedded zero bytes are hashed, unlike strings
+		EXPECT_NE(Hash::BufferHash64(data, 1), Hash::BufferHash64(data, 2));
+
+		uint64_t dataHash64Combined = Hash::BufferHash64(data + 2, sizeof(data) - 2, Hash::BufferHash64(data, 2));
+		EXPECT_EQ(dataHash64, dataHash64Combined);
+	}
+
+	// Bit at a time CRC-64 reference
+	static uint64_t BitwiseCrc64(const uint8_t* data, size_t size)
+	{
+		uint64_t crc = Hash::EmptyHash64;
+		for (size_t i = 0; i < size; ++i)
+		{
+			crc ^= data[i];
+			for (int bit = 0; bit < 8; ++bit)
+			{
+				crc = (crc & 1) ? ((crc >> 1) ^ 0x95ac9329ac4bc9b5ull) : (crc >> 1);
+			}
+		}
+		return crc;
+	}
+
+	TEST(Framework, BufferHash64Slices)
+	{
+		std::vector<uint8_t> data(1031);
+		uint32_t seed = 12345;
+		for (uint8_t& value : data)
+		{
+			seed = (seed * 1664525u) + 1013904223u;
+			value = static_cast<uint8_t>(seed >> 24);
+		}
+
+		// every length and alignment matches the bitwise reference
+		for (size_t offset = 0; offset < 8; ++offset)
+		{
+			for (size_t size = 0; size < 64; ++size)
+			{
+				EXPECT_EQ(Hash::BufferHash64(data.data() + offset, size), BitwiseCrc64(data.data() + offset, size));
+			}
+		}
+
+		const char* text = "123456789";
+		EXPECT_EQ(Hash::BufferHash64(text, strlen(text)), Hash::StringHash64(text));
+
+		// the incremental hasher matches the one-shot hash for any split
+		const uint64_t expected = Hash::BufferHash64(data.data(), data.size());
+		for (size_t split : { 0, 1, 7, 8, 9, 512, 1030, 1031 })
+		{
+			Hash::Hasher64 hasher;
+			hasher.Update(data.data(), split);
+			hasher.Update(data.data() + split, data.size() - split);
+			EXPECT_EQ(hasher.Digest(), expected);
+		}
+
+		Hash::Hasher64 seededHasher(Hash::StringHash64("seed"));
+		seededHasher.Update(text, strlen(text));
+		EXPECT_EQ(seededHasher.Digest(), Hash::StringHash64(text, Hash::StringHash64("seed")));
+	}
+
+	TEST(Framework, Crc32C)
+	{
+		EXPECT_EQ(Hash::Crc32C(nullptr, 0), Hash::EmptyHash32);
+
+		// CRC-32C (iSCSI) check value
+		const char* text = "123456789";
+		EXPECT_EQ(Hash::Crc32C(text, strlen(text)), 0xe3069283u);
+		EXPECT_EQ(Hash::Crc32CPortable(text, strlen(text)), 0xe3069283u);
+
+		std::vector<uint8_t> data(1031);
+		uint32_t seed = 6789;
+		for (uint8_t& value : data)
+		{
+			seed = (seed * 1664525u) + 1013904223u;
+			value = static_cast<uint8_t>(seed >> 24);
+		}
+
+		// the hardware and portable paths agree on every length and alignment
+		for (size_t offset = 0; offset < 8; ++offset)
+		{
+			for (size_t size = 0; size < 64; ++size)
+			{
+				EXPECT_EQ(Hash::Crc32C(data.data() + offset, size), Hash::Crc32CPortable(data.data() + offset, size));
+			}
+		}
+
+		const uint32_t expected = Hash::Crc32C(data.data(), data.size());
+		EXPECT_EQ(Hash::Crc32CPortable(data.data(), data.size()), expected);
+		EXPECT_EQ(Hash::Crc32C(data.data() + 100, data.size() - 100, Hash::Crc32C(data.data(), 100)), expected);
+		EXPECT_EQ(Hash::Crc32CPortable(data.data() + 100, data.size() - 100, Hash::Crc32CPortable(data.data(), 100)), expected);
+	}
+
+	// folded by the compiler, a mismatch fails the build
+	static_assert(Hash::ConstStringHash32("") == Hash::EmptyHash32, "compile-time CRC-32 of an empty string");
+	static_assert(Hash::ConstStringHash32("123456789") == 0x2dfd2d88u, "compile-time CRC-32 check value");
+	static_assert(Hash::ConstStringHash64("123456789") == 0xe9c6d914c4b8d9caull, "compile-time CRC-64 check value");
+	static_assert(Hash::ConstStringHash64("World", Hash::ConstStringHash64("Hello")) == Hash::ConstStringHash64("HelloWorld"), "compile-time CRC-64 chaining");
+
+	TEST(Framework, ConstHash)
+	{
+		using namespace Literals;
+
+		const char* texts[] = { "", "Hello", "HelloWorld", "Materials/Dragon", "\xe3\x81\x93\xff\x80" };
+		for (const char* text : texts)
+		{
+			EXPECT_EQ(Hash::ConstStringHash32(text), Hash::StringHash32(text));
+			EXPECT_EQ(Hash::ConstStringHash64(text), Hash::StringHash64(text));
+		}
+
+		constexpr uint32_t literalHash32 = "Materials/Dragon"_hash32;
+		constexpr uint64_t literalHash64 = "Materials/Dragon"_hash64;
+		EXPECT_EQ(literalHash32, Hash::StringHash32("Materials/Dragon"));
+		EXPECT_EQ(literalHash64, Hash::StringHash64("Materials/Dragon"));
 	}
 }
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include "pch.h"
+
+#include <Framework/HashedString.h>
+
+#include <unordered_map>
+
+namespace W
+{
+	using namespace Literals;
+
+	static_assert("Diffuse"_hs.GetHash() == Hash::ConstStringHash32("Diffuse"), "literal hashed at compile time");
+	static_assert("Diffuse"_hs == HashedString("Diffuse"), "hashed strings compare by hash");
+	static_assert("Diffuse"_hs != "Normal"_hs, "different strings, different hashes");
+	static_assert(HashedString().GetHash() == Hash::EmptyHash32, "default hashed string is empty");
+
+	TEST(Framework, HashedString)
+	{
+		constexpr HashedString diffuse = "Diffuse"_hs;
+		EXPECT_STREQ(diffuse.GetText(), "Diffuse");
+		EXPECT_EQ(diffuse.GetHash(), Hash::StringHash32("Diffuse"));
+
+		// lookups by literal hash the key at compile time
+		std::unordered_map<HashedString, int> passes;
+		passes[HashedString("Depth")] = 0;
+		passes[HashedString("Opaque")] = 1;
+		EXPECT_EQ(passes.at("Opaque"_hs), 1);
+		EXPECT_EQ(passes.count("Transparent"_hs), 0u);
+	}
+}
\ No newline at end of file
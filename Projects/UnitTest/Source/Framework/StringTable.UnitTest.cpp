@@ -0,0 +1,100 @@
+#include "pch.h"
+
+#include <Framework/StringTable.h>
+
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace W
+{
+	static_assert(std::is_trivially_copyable<Name>::value, "names are plain ids");
+	static_assert(sizeof(Name) == sizeof(uint32_t), "names are plain ids");
+
+	TEST(Framework, StringTable)
+	{
+		StringTable table;
+		EXPECT_EQ(table.Intern(""), StringTable::EmptyId);
+		EXPECT_EQ(table.Intern(nullptr), StringTable::EmptyId);
+		EXPECT_STREQ(table.GetText(StringTable::EmptyId), "");
+
+		const uint32_t dragonId = table.Intern("Dragon");
+		const uint32_t lightId = table.Intern("Light");
+		EXPECT_NE(dragonId, lightId);
+		EXPECT_EQ(table.Intern("Dragon"), dragonId);
+		EXPECT_EQ(table.Intern(std::string("Drag").append("on").c_str()), dragonId);
+		EXPECT_STREQ(table.GetText(dragonId), "Dragon");
+		EXPECT_EQ(table.GetCount(), 3u);
+
+		// longer than an arena page
+		const std::string longText(100 * 1024, 'x');
+		const uint32_t longId = table.Intern(longText.c_str());
+		EXPECT_EQ(table.GetText(longId), longText);
+
+		// grows past the initial buckets and entry chunk, earlier text pointers stay valid
+		const char* dragonText = table.GetText(dragonId);
+		std::vector<uint32_t> ids;
+		for (int i = 0; i < 10000; ++i)
+		{
+			ids.push_back(table.Intern(("Node" + std::to_string(i)).c_str()));
+		}
+		for (int i = 0; i < 10000; ++i)
+		{
+			EXPECT_EQ(table.Intern(("Node" + std::to_string(i)).c_str()), ids[i]);
+			EXPECT_EQ(table.GetText(ids[i]), "Node" + std::to_string(i));
+		}
+		EXPECT_EQ(table.GetText(dragonId), dragonText);
+		EXPECT_EQ(table.Intern("Dragon"), dragonId);
+	}
+
+	TEST(Framework, StringTableThreads)
+	{
+		StringTable table;
+
+		const int threadCount = 4;
+		const int nameCount = 5000;
+		std::vector<std::vector<uint32_t>> ids(threadCount);
+
+		// every thread interns the same names in a different order
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; ++t)
+		{
+			threads.emplace_back([&, t]()
+			{
+				ids[t].resize(nameCount);
+				for (int i = 0; i < nameCount; ++i)
+				{
+					const int nameIndex = (t % 2 == 0) ? i : (nameCount - 1 - i);
+					ids[t][nameIndex] = table.Intern(("Material" + std::to_string(nameIndex)).c_str());
+				}
+			});
+		}
+
+		for (std::thread& thread : threads)
+		{
+			thread.join();
+		}
+
+		EXPECT_EQ(table.GetCount(), static_cast<size_t>(nameCount + 1));
+		for (int t = 1; t < threadCount; ++t)
+		{
+			EXPECT_EQ(ids[t], ids[0]);
+		}
+	}
+
+	TEST(Framework, Name)
+	{
+		const Name empty;
+		EXPECT_TRUE(empty.IsEmpty());
+		EXPECT_STREQ(empty.GetText(), "");
+
+		const Name dragon("Dragon");
+		const Name dragonCopy = dragon;
+		EXPECT_FALSE(dragon.IsEmpty());
+		EXPECT_EQ(dragon, Name("Dragon"));
+		EXPECT_EQ(dragonCopy, dragon);
+		EXPECT_NE(dragon, Name("Light"));
+		EXPECT_STREQ(dragon.GetText(), "Dragon");
+	}
+}
\ No newline at end of file